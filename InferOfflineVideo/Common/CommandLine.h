@@ -26,6 +26,7 @@ struct CmdParams {
     std::string aclConfig;
     std::string Config;
     int debugLevel;
+    std::string processName; // the modules whose <module>.process names another process aren't run here
 };
 
 APP_ERROR ParseACommandLine(int argc, const char *argv[], CmdParams &cmdParams)
@@ -37,11 +38,13 @@ APP_ERROR ParseACommandLine(int argc, const char *argv[], CmdParams &cmdParams)
     option.AddOption("-acl_setup", "./data/config/acl.json", "the config file using for AscendCL init.");
     option.AddOption("-setup", "./data/config/setup.config", "the config file using for pipeline.");
     option.AddOption("-debug_level", "1", "debug level:0-debug, 1-info, 2-warn, 3-error, 4-fatal, 5-off.");
+    option.AddOption("-process", "", "name of this process, all the modules run in it if empty.");
 
     option.ParseArgs(argc, argv);
     cmdParams.aclConfig = option.GetStringOption("-acl_setup");
     cmdParams.Config = option.GetStringOption("-setup");
     cmdParams.debugLevel = option.GetIntOption("-debug_level");
+    cmdParams.processName = option.GetStringOption("-process");
 
     return ret;
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PacketCapture.h"
+
+#include <cstring>
+#include "Log/Log.h"
+
+namespace {
+const char CAPTURE_MAGIC[4] = {'A', 'V', 'P', 'C'};
+const char INDEX_MAGIC[4] = {'A', 'V', 'P', 'I'};
+const uint32_t CAPTURE_VERSION = 1;
+const uint32_t MAX_PACKET_SIZE = 64 * 1024 * 1024; // larger records are taken as a corrupted file
+
+struct PacketCaptureTrailer {
+    uint64_t indexOffset;
+    uint64_t packetCount;
+    char magic[4];
+    uint32_t reserved;
+};
+
+bool WriteBytes(FILE *file, const void *data, size_t size)
+{
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+bool ReadBytes(FILE *file, void *data, size_t size)
+{
+    return size == 0 || fread(data, 1, size, file) == size;
+}
+}
+
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+    Close();
+}
+
+APP_ERROR PacketCaptureWriter::Open(const std::string &filePath, const PacketCaptureHeader &header,
+    const uint8_t *extradata)
+{
+    Close();
+    file_ = fopen(filePath.c_str(), "wb");
+    if (file_ == nullptr) {
+        LogError << "Fail to create the capture file " << filePath;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    filePath_ = filePath;
+    PacketCaptureHeader fileHeader = header;
+    std::memcpy(fileHeader.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    fileHeader.version = CAPTURE_VERSION;
+    if (!WriteBytes(file_, &fileHeader, sizeof(fileHeader)) ||
+        !WriteBytes(file_, extradata, fileHeader.extradataSize)) {
+        LogError << "Fail to write the capture file " << filePath;
+        fclose(file_);
+        file_ = nullptr;
+        return APP_ERR_COMM_WRITE_FAIL;
+    }
+    offset_ = sizeof(fileHeader) + fileHeader.extradataSize;
+    index_.clear();
+    return APP_ERR_OK;
+}
+
+APP_ERROR PacketCaptureWriter::Write(uint64_t timestampUs, int64_t pts, int64_t dts, uint32_t flags,
+    const uint8_t *data, uint32_t size)
+{
+    if (file_ == nullptr) {
+        return APP_ERR_COMM_NOT_INIT;
+    }
+    if (index_.empty()) {
+        firstTimestampUs_ = timestampUs;
+    }
+    PacketCaptureRecord record = {timestampUs - firstTimestampUs_, pts, dts, flags, size};
+    if (!WriteBytes(file_, &record, sizeof(record)) || !WriteBytes(file_, data, size)) {
+        LogError << "Fail to write the capture file " << filePath_ << ", the capture stops";
+        Close();
+        return APP_ERR_COMM_WRITE_FAIL;
+    }
+    index_.push_back({offset_, record.timestampUs});
+    offset_ += sizeof(record) + size;
+    return APP_ERR_OK;
+}
+
+APP_ERROR PacketCaptureWriter::Close()
+{
+    if (file_ == nullptr) {
+        return APP_ERR_OK;
+    }
+    PacketCaptureTrailer trailer = {offset_, index_.size(), {}, 0};
+    std::memcpy(trailer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    bool isWritten = WriteBytes(file_, index_.data(), index_.size() * sizeof(PacketCaptureIndexEntry)) &&
+        WriteBytes(file_, &trailer, sizeof(trailer));
+    isWritten = (fclose(file_) == 0) && isWritten;
+    file_ = nullptr;
+    if (!isWritten) {
+        LogError << "Fail to write the index of the capture file " << filePath_;
+        return APP_ERR_COMM_WRITE_FAIL;
+    }
+    LogInfo << index_.size() << " packets captured in " << filePath_;
+    return APP_ERR_OK;
+}
+
+uint64_t PacketCaptureWriter::GetPacketCount() const
+{
+    return index_.size();
+}
+
+PacketCaptureReader::~PacketCaptureReader()
+{
+    Close();
+}
+
+APP_ERROR PacketCaptureReader::Open(const std::string &filePath)
+{
+    Close();
+    file_ = fopen(filePath.c_str(), "rb");
+    if (file_ == nullptr) {
+        LogError << "Fail to open the capture file " << filePath;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    filePath_ = filePath;
+    if (!ReadBytes(file_, &header_, sizeof(header_)) ||
+        std::memcmp(header_.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || header_.version != CAPTURE_VERSION ||
+        header_.extradataSize > MAX_PACKET_SIZE) {
+        LogError << filePath << " isn't a capture file of version " << CAPTURE_VERSION;
+        Close();
+        return APP_ERR_COMM_READ_FAIL;
+    }
+    extradata_.resize(header_.extradataSize);
+    if (!ReadBytes(file_, extradata_.data(), extradata_.size()) || fseeko(file_, 0, SEEK_END) != 0) {
+        LogError << "Fail to read the capture file " << filePath;
+        Close();
+        return APP_ERR_COMM_READ_FAIL;
+    }
+    dataOffset_ = sizeof(header_) + header_.extradataSize;
+    uint64_t fileSize = static_cast<uint64_t>(ftello(file_));
+    if (ReadIndex(fileSize) != APP_ERR_OK) {
+        LogWarn << "The capture file " << filePath << " has no index, it wasn't closed, its packets are scanned";
+        ScanRecords(fileSize);
+    }
+    readOffset_ = UINT64_MAX;
+    return APP_ERR_OK;
+}
+
+void PacketCaptureReader::Close()
+{
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    index_.clear();
+}
+
+APP_ERROR PacketCaptureReader::ReadIndex(uint64_t fileSize)
+{
+    PacketCaptureTrailer trailer = {};
+    if (fileSize < dataOffset_ + sizeof(trailer) ||
+        fseeko(file_, static_cast<off_t>(fileSize - sizeof(trailer)), SEEK_SET) != 0 ||
+        !ReadBytes(file_, &trailer, sizeof(trailer)) ||
+        std::memcmp(trailer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        trailer.indexOffset + trailer.packetCount * sizeof(PacketCaptureIndexEntry) + sizeof(trailer) != fileSize) {
+        return APP_ERR_COMM_NO_EXIST;
+    }
+    index_.resize(trailer.packetCount);
+    if (fseeko(file_, static_cast<off_t>(trailer.indexOffset), SEEK_SET) != 0 ||
+        !ReadBytes(file_, index_.data(), index_.size() * sizeof(PacketCaptureIndexEntry))) {
+        index_.clear();
+        return APP_ERR_COMM_READ_FAIL;
+    }
+    return APP_ERR_OK;
+}
+
+// the last record may be cut, the packets end before it
+void PacketCaptureReader::ScanRecords(uint64_t fileSize)
+{
+    index_.clear();
+    uint64_t offset = dataOffset_;
+    PacketCaptureRecord record = {};
+    while (offset + sizeof(record) <= fileSize && fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0 &&
+        ReadBytes(file_, &record, sizeof(record)) && record.size <= MAX_PACKET_SIZE &&
+        offset + sizeof(record) + record.size <= fileSize) {
+        index_.push_back({offset, record.timestampUs});
+        offset += sizeof(record) + record.size;
+    }
+}
+
+const PacketCaptureHeader &PacketCaptureReader::GetHeader() const
+{
+    return header_;
+}
+
+const std::vector<uint8_t> &PacketCaptureReader::GetExtradata() const
+{
+    return extradata_;
+}
+
+uint64_t PacketCaptureReader::GetPacketCount() const
+{
+    return index_.size();
+}
+
+uint64_t PacketCaptureReader::GetPacketTimestampUs(uint64_t packetIndex) const
+{
+    return (packetIndex < index_.size()) ? index_[packetIndex].timestampUs : 0;
+}
+
+APP_ERROR PacketCaptureReader::ReadPacket(uint64_t packetIndex, PacketCaptureRecord &record, std::vector<uint8_t> &data)
+{
+    if (file_ == nullptr) {
+        return APP_ERR_COMM_NOT_INIT;
+    }
+    if (packetIndex >= index_.size()) {
+        return APP_ERR_COMM_OUT_OF_RANGE;
+    }
+    // the packets are mostly read in order, a seek would drop the buffer of the file
+    uint64_t offset = index_[packetIndex].offset;
+    bool isRead = (offset == readOffset_ || fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0) &&
+        ReadBytes(file_, &record, sizeof(record)) && record.size <= MAX_PACKET_SIZE;
+    if (isRead) {
+        data.resize(record.size);
+        isRead = ReadBytes(file_, data.data(), data.size());
+    }
+    if (!isRead) {
+        readOffset_ = UINT64_MAX;
+        LogError << "Fail to read the packet " << packetIndex << " of the capture file " << filePath_;
+        return APP_ERR_COMM_READ_FAIL;
+    }
+    readOffset_ = offset + sizeof(record) + record.size;
+    return APP_ERR_OK;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+
+// Capture file of the demuxed packets of one channel, written by StreamPuller and read by StreamReplayer:
+//   header, codec extradata, packets (record then data)..., index of the packets, trailer
+// The index and the trailer are written when the capture is closed, the packets of a capture which wasn't closed
+// are found again by reading the records one after the other. The integers are in the byte order of the host.
+struct PacketCaptureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t channelId;
+    uint32_t codecId;     // AVCodecID of the stream
+    uint32_t videoFormat; // acldvppStreamFormat sent to VideoDecoder
+    uint32_t width;
+    uint32_t height;
+    int32_t timeBaseNum;  // time base of pts and dts
+    int32_t timeBaseDen;
+    uint32_t extradataSize;
+};
+
+struct PacketCaptureRecord {
+    uint64_t timestampUs; // time the packet was received, from the first packet of the capture
+    int64_t pts;
+    int64_t dts;
+    uint32_t flags;       // AV_PKT_FLAG_*
+    uint32_t size;
+};
+
+struct PacketCaptureIndexEntry {
+    uint64_t offset; // of the record in the file
+    uint64_t timestampUs;
+};
+
+class PacketCaptureWriter {
+public:
+    PacketCaptureWriter() {};
+    ~PacketCaptureWriter();
+    APP_ERROR Open(const std::string &filePath, const PacketCaptureHeader &header, const uint8_t *extradata);
+    // timestampUs is the time the packet was received, on any clock, the record keeps it from the first packet
+    APP_ERROR Write(uint64_t timestampUs, int64_t pts, int64_t dts, uint32_t flags, const uint8_t *data,
+        uint32_t size);
+    // writes the index, the file is then complete
+    APP_ERROR Close();
+    uint64_t GetPacketCount() const;
+
+private:
+    FILE *file_ = nullptr;
+    std::string filePath_ = {};
+    uint64_t offset_ = 0;
+    uint64_t firstTimestampUs_ = 0;
+    std::vector<PacketCaptureIndexEntry> index_ = {};
+};
+
+class PacketCaptureReader {
+public:
+    PacketCaptureReader() {};
+    ~PacketCaptureReader();
+    APP_ERROR Open(const std::string &filePath);
+    void Close();
+    const PacketCaptureHeader &GetHeader() const;
+    const std::vector<uint8_t> &GetExtradata() const;
+    uint64_t GetPacketCount() const;
+    // PacketCaptureRecord::timestampUs of the packet, from the index
+    uint64_t GetPacketTimestampUs(uint64_t packetIndex) const;
+    // record and data of the packet, data is resized to the packet
+    APP_ERROR ReadPacket(uint64_t packetIndex, PacketCaptureRecord &record, std::vector<uint8_t> &data);
+
+private:
+    APP_ERROR ReadIndex(uint64_t fileSize);
+    void ScanRecords(uint64_t fileSize);
+
+private:
+    FILE *file_ = nullptr;
+    std::string filePath_ = {};
+    uint64_t dataOffset_ = 0; // of the first record
+    uint64_t readOffset_ = UINT64_MAX; // position of the file after the last packet read, to skip the seek
+    PacketCaptureHeader header_ = {};
+    std::vector<uint8_t> extradata_ = {};
+    std::vector<PacketCaptureIndexEntry> index_ = {};
+};
+
+#endif
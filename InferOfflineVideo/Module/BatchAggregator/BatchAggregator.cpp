@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020.Huawei Technologies Co., Ltd. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "BatchAggregator.h"
+
+#include <algorithm>
+#include "Log/Log.h"
+#include "ModelInfer/ModelInfer.h"
+
+using namespace ascendBaseModule;
+
+BatchAggregator::BatchAggregator()
+{
+    isStop_ = false;
+    isSingleSendThread_ = true;
+}
+
+BatchAggregator::~BatchAggregator() {}
+
+APP_ERROR BatchAggregator::Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
+{
+    LogDebug << "Begin to init instance " << initArgs.instanceId;
+    AssignInitArgs(initArgs);
+    framePool_ = GetMessagePool<CommonData>(MESSAGE_POOL_MAX_FREE, ResetCommonData);
+    if (maxBatchSize_ == 1) {
+        LogWarn << "BatchAggregator[" << instanceId_ << "]: " << moduleName_ <<
+            ".maxBatchSize is 1, the frames are inferred one by one.";
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR BatchAggregator::DeInit(void)
+{
+    if (batchCount_ != 0) {
+        LogInfo << "BatchAggregator[" << instanceId_ << "]: " << frameCount_ << " frames sent in " << batchCount_ <<
+            " batches, " << static_cast<double>(frameCount_) / batchCount_ << " frames per batch.";
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR BatchAggregator::ProcessMessage(std::shared_ptr<CommonData> data)
+{
+    if (modelInferOutput_ == nullptr) {
+        modelInferOutput_ = GetOutputHandle(MT_ModelInfer);
+    }
+    if (!data->eof) {
+        frameCount_++;
+        batchCount_++;
+    }
+    SendToNextModule(modelInferOutput_, data, data->channelId);
+    return APP_ERR_OK;
+}
+
+// the end of stream marks are sent after the frames queued before them, so they still follow the frames of their
+// channel, which ModelInfer sends to PostProcess before handling the next message
+APP_ERROR BatchAggregator::ProcessBatch(std::vector<std::shared_ptr<void>> &inputDataVec)
+{
+    if (modelInferOutput_ == nullptr) {
+        modelInferOutput_ = GetOutputHandle(MT_ModelInfer);
+    }
+    std::vector<std::shared_ptr<CommonData>> frames;
+    frames.reserve(inputDataVec.size());
+    for (auto &inputData : inputDataVec) {
+        std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(inputData);
+        if (!data->eof) {
+            frames.push_back(data);
+            continue;
+        }
+        SendBatch(frames);
+        SendToNextModule(modelInferOutput_, data, data->channelId);
+    }
+    SendBatch(frames);
+    return APP_ERR_OK;
+}
+
+void BatchAggregator::SendBatch(std::vector<std::shared_ptr<CommonData>> &frames)
+{
+    if (frames.empty()) {
+        return;
+    }
+    frameCount_ += frames.size();
+    batchCount_++;
+    if (frames.size() == 1) {
+        SendToNextModule(modelInferOutput_, frames[0], frames[0]->channelId);
+        frames.clear();
+        return;
+    }
+    // the batch is identified as its first frame, and is due when its most urgent frame is
+    std::shared_ptr<CommonData> batch = framePool_->Acquire();
+    batch->channelId = frames[0]->channelId;
+    batch->frameId = frames[0]->frameId;
+    batch->timestampUs = frames[0]->timestampUs;
+    for (auto &frame : frames) {
+        batch->timestampUs = std::min(batch->timestampUs, frame->timestampUs);
+        if (frame->deadlineUs != 0 && (batch->deadlineUs == 0 || frame->deadlineUs < batch->deadlineUs)) {
+            batch->deadlineUs = frame->deadlineUs;
+        }
+    }
+    batch->batchFrames.swap(frames);
+    frames.clear();
+    SendToNextModule(modelInferOutput_, batch, batch->channelId);
+}
+
+bool BatchAggregator::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return IsCommonDataDroppable(outputData);
+}
+
+void BatchAggregator::OnDropped(const std::shared_ptr<void> &outputData)
+{
+    ReleaseCommonDataDvpp(*std::static_pointer_cast<CommonData>(outputData));
+}
+
+void BatchAggregator::OnInputDropped(const std::shared_ptr<void> &inputData)
+{
+    ReleaseCommonDataDvpp(*std::static_pointer_cast<CommonData>(inputData));
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2020.Huawei Technologies Co., Ltd. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BATCH_AGGREGATOR_H
+#define BATCH_AGGREGATOR_H
+
+#include "ModuleManager/ModuleManager.h"
+#include "ConfigParser/ConfigParser.h"
+#include "DataType/DataType.h"
+
+// Gathers the decoded frames of all the channels into batches for ModelInfer, which infers a batch at one time.
+// A batch holds up to BatchAggregator.maxBatchSize frames, taken as they are queued or, with
+// BatchAggregator.batchTimeoutMs, waiting at most that long from the first frame for the batch to fill up.
+class BatchAggregator : public ascendBaseModule::TypedModuleBase<CommonData> {
+public:
+    BatchAggregator();
+    ~BatchAggregator();
+    APP_ERROR Init(ConfigParser &configParser, ascendBaseModule::ModuleInitArgs &initArgs);
+    APP_ERROR DeInit(void);
+
+protected:
+    APP_ERROR ProcessMessage(std::shared_ptr<CommonData> data);
+    APP_ERROR ProcessBatch(std::vector<std::shared_ptr<void>> &inputDataVec);
+    bool IsDroppable(const std::shared_ptr<void> &outputData);
+    void OnDropped(const std::shared_ptr<void> &outputData);
+    void OnInputDropped(const std::shared_ptr<void> &inputData);
+
+private:
+    void SendBatch(std::vector<std::shared_ptr<CommonData>> &frames);
+
+private:
+    std::shared_ptr<ascendBaseModule::MessagePool<CommonData>> framePool_ = nullptr;
+    ascendBaseModule::ModuleOutputHandle modelInferOutput_ = nullptr; // resolved by the first Process call
+    uint64_t frameCount_ = 0;
+    uint64_t batchCount_ = 0;
+};
+
+MODULE_REGIST(BatchAggregator)
+
+#endif
@@ -24,6 +24,9 @@ struct CommonData {
     bool eof = {};
     uint32_t channelId = {};
     uint64_t frameId = {};
+    uint64_t sequenceId = {}; // consecutive number of the frames of the channel sent by VideoDecoder, eof included
+    uint64_t timestampUs = {}; // time the packet is received by StreamPuller, see GetModuleTimeUs
+    uint64_t deadlineUs = {};  // time after which the frame is not inferred anymore, 0 if no deadline
     uint32_t srcWidth = {};
     uint32_t srcHeight = {};
     acldvppStreamFormat videoFormat = {};
@@ -35,6 +38,57 @@ struct CommonData {
     uint32_t modelType = {};
     std::shared_ptr<DvppDataInfo> dvppData = {};
     std::vector<RawData> inferOutput = {};
+    std::shared_ptr<void> flowCredit = {}; // credit of the source, returned when the frame is released
+    // frames of a batch built by BatchAggregator, the other fields then describe the batch, empty for a frame
+    std::vector<std::shared_ptr<CommonData>> batchFrames = {};
 };
 
+// prepares a pooled CommonData for its next frame, the vectors keep their capacity
+inline void ResetCommonData(CommonData &data)
+{
+    std::vector<RawData> inferOutput;
+    inferOutput.swap(data.inferOutput);
+    inferOutput.clear();
+    std::vector<std::shared_ptr<CommonData>> batchFrames;
+    batchFrames.swap(data.batchFrames);
+    batchFrames.clear();
+    data = CommonData();
+    data.inferOutput.swap(inferOutput);
+    data.batchFrames.swap(batchFrames);
+}
+
+// the resized images are released by ModelInfer after inference, this releases them when a frame or batch is dropped
+inline void ReleaseCommonDataDvpp(CommonData &data)
+{
+    if (data.dvppData != nullptr && data.dvppData->data != nullptr) {
+        acldvppFree(data.dvppData->data);
+        data.dvppData->data = nullptr;
+    }
+    for (auto &frame : data.batchFrames) {
+        ReleaseCommonDataDvpp(*frame);
+    }
+}
+
+// the end of stream mark of a channel must reach PostProcess, so only the frames can be dropped on overflow
+inline bool IsCommonDataDroppable(const std::shared_ptr<void> &outputData)
+{
+    return !std::static_pointer_cast<CommonData>(outputData)->eof;
+}
+
+// memory held by the buffers of the data, host and device, for the byte budgeted queues
+inline uint64_t GetCommonDataBytes(const CommonData &data)
+{
+    uint64_t bytes = (data.streamData.data != nullptr) ? data.streamData.size : 0;
+    if (data.dvppData != nullptr && data.dvppData->data != nullptr) {
+        bytes += data.dvppData->dataSize;
+    }
+    for (auto &output : data.inferOutput) {
+        bytes += output.lenOfByte;
+    }
+    for (auto &frame : data.batchFrames) {
+        bytes += GetCommonDataBytes(*frame);
+    }
+    return bytes;
+}
+
 #endif
\ No newline at end of file
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 #include "ModelInfer.h"
+#include <algorithm>
 #include "PostProcess/PostProcess.h"
 #include "Singleton.h"
 
@@ -29,6 +30,7 @@ namespace {
 ModelInfer::ModelInfer()
 {
     isStop_ = false;
+    isSingleSendThread_ = true;
 }
 
 ModelInfer::~ModelInfer() {}
@@ -120,16 +122,102 @@ APP_ERROR ModelInfer::Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
         }
         buffers_.push(temp);
     }
+    return InitBatchInput(modelDesc);
+}
+
+/*
+ * @description: Prepare the batch inference if the model takes several frames, a model converted with a batch
+ *               size or with dynamic batch gears, whose first input holds the resized images one after the other
+ * @param modelDesc The description of the model
+ */
+APP_ERROR ModelInfer::InitBatchInput(aclmdlDesc *modelDesc)
+{
+    aclmdlBatch batchInfo = {};
+    APP_ERROR ret = aclmdlGetDynamicBatch(modelDesc, &batchInfo);
+    if (ret != APP_ERR_OK) {
+        LogError << "ModelInfer[" << instanceId_ << "]: Failed to get the dynamic batch of the model, ret = " << ret;
+        return ret;
+    }
+    for (size_t i = 0; i < batchInfo.batchCount; i++) {
+        batchGears_.push_back(static_cast<uint32_t>(batchInfo.batch[i]));
+    }
+    std::sort(batchGears_.begin(), batchGears_.end());
+    if (!batchGears_.empty()) {
+        maxBatch_ = batchGears_.back();
+    } else {
+        aclmdlIODims dims = {};
+        ret = aclmdlGetInputDims(modelDesc, 0, &dims);
+        if (ret != APP_ERR_OK) {
+            LogError << "ModelInfer[" << instanceId_ << "]: Failed to get the input dims of the model, ret = " << ret;
+            return ret;
+        }
+        maxBatch_ = (dims.dimCount > 0 && dims.dims[0] > 1) ? static_cast<uint32_t>(dims.dims[0]) : 1;
+    }
+    if (batchGears_.empty() && maxBatch_ == 1) {
+        return APP_ERR_OK;
+    }
+
+    size_t inputSize = aclmdlGetInputSizeByIndex(modelDesc, 0);
+    frameInputSize_ = inputSize / maxBatch_;
+    ret = aclrtMalloc(&batchInput_, inputSize, ACL_MEM_MALLOC_NORMAL_ONLY);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to malloc buffer, size is " << inputSize;
+        return ret;
+    }
+    if (!batchGears_.empty()) {
+        ret = aclmdlGetInputIndexByName(modelDesc, ACL_DYNAMIC_TENSOR_NAME, &dynamicInputIndex_);
+        if (ret != APP_ERR_OK) {
+            LogError << "ModelInfer[" << instanceId_ << "]: Failed to get the dynamic batch input, ret = " << ret;
+            return ret;
+        }
+        dynamicInputSize_ = aclmdlGetInputSizeByIndex(modelDesc, dynamicInputIndex_);
+        ret = aclrtMalloc(&dynamicInput_, dynamicInputSize_, ACL_MEM_MALLOC_NORMAL_ONLY);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to malloc buffer, size is " << dynamicInputSize_;
+            return ret;
+        }
+    }
+    LogInfo << "ModelInfer[" << instanceId_ << "]: the model infers up to " << maxBatch_ << " frames at one time.";
     return APP_ERR_OK;
 }
 
-APP_ERROR ModelInfer::Process(std::shared_ptr<void> commonData)
+APP_ERROR ModelInfer::ProcessMessage(std::shared_ptr<CommonData> data)
 {
-    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(commonData);
+    if (postProcessOutput_ == nullptr) {
+        postProcessOutput_ = GetOutputHandle(MT_PostProcess);
+    }
     if (data->eof) {
-        SendToNextModule(MT_PostProcess, data, data->channelId);
+        SendToNextModule(postProcessOutput_, data, data->channelId);
+        return APP_ERR_OK;
+    }
+    if (!data->batchFrames.empty()) {
+        return InferFrames(data->batchFrames);
+    }
+    if (batchInput_ != nullptr) {
+        std::vector<std::shared_ptr<CommonData>> frames = {data};
+        return InferFrames(frames);
+    }
+    if (DropLateFrame(data)) {
         return APP_ERR_OK;
     }
+    return InferFrame(data);
+}
+
+bool ModelInfer::DropLateFrame(const std::shared_ptr<CommonData> &data)
+{
+    // the result would come too late, don't spend NPU time on it
+    if (data->deadlineUs == 0 || GetModuleTimeUs() <= data->deadlineUs) {
+        return false;
+    }
+    LogDebug << "ModelInfer[" << instanceId_ << "]: drop frame " << data->frameId << " of channel " <<
+        data->channelId << " which missed its deadline";
+    ReleaseCommonDataDvpp(*data);
+    inputQueue_->AddDropCount(1);
+    return true;
+}
+
+APP_ERROR ModelInfer::InferFrame(std::shared_ptr<CommonData> &data)
+{
     srcImageWidth_ = data->srcWidth;
     srcImageHeight_ = data->srcHeight;
     std::vector<RawData> modelOutput;
@@ -145,10 +233,77 @@ APP_ERROR ModelInfer::Process(std::shared_ptr<void> commonData)
     data->modelWidth = modelWidth_;
     data->modelHeight = modelHeight_;
     data->modelType = modelType_;
-    SendToNextModule(MT_PostProcess, data, data->channelId);
+    SendToNextModule(postProcessOutput_, data, data->channelId);
     return APP_ERR_OK;
 }
 
+// drops the frames which missed their deadline and infers the others by batches of up to maxBatch_ frames
+APP_ERROR ModelInfer::InferFrames(std::vector<std::shared_ptr<CommonData>> &frames)
+{
+    APP_ERROR result = APP_ERR_OK;
+    std::vector<std::shared_ptr<CommonData>> batch;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (!DropLateFrame(frames[i])) {
+            batch.push_back(frames[i]);
+        }
+        if (batch.empty() || (batch.size() < maxBatch_ && i + 1 < frames.size())) {
+            continue;
+        }
+        APP_ERROR ret = (batchInput_ == nullptr) ? InferFrame(batch[0]) : InferBatch(batch);
+        if (ret != APP_ERR_OK) {
+            result = ret;
+        }
+        batch.clear();
+    }
+    return result;
+}
+
+bool ModelInfer::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return IsCommonDataDroppable(outputData);
+}
+
+// the frame or batch is older than ModelInfer.maxFrameAgeMs, release the resized images it won't infer
+void ModelInfer::OnInputDropped(const std::shared_ptr<void> &inputData)
+{
+    ReleaseCommonDataDvpp(*std::static_pointer_cast<CommonData>(inputData));
+}
+
+// a batch of BatchAggregator only drops its stale frames, it is timestamped with its oldest frame
+bool ModelInfer::DropStaleFrames(const std::shared_ptr<void> &inputData, const ModuleMessageInfo &info,
+    uint64_t staleBeforeUs, std::map<uint32_t, uint64_t> &droppedCountMap)
+{
+    std::shared_ptr<CommonData> batch = std::static_pointer_cast<CommonData>(inputData);
+    if (batch->batchFrames.empty()) {
+        return ModuleBase::DropStaleFrames(inputData, info, staleBeforeUs, droppedCountMap);
+    }
+    auto isStale = [staleBeforeUs](const std::shared_ptr<CommonData> &frame) {
+        return frame->timestampUs != 0 && frame->timestampUs < staleBeforeUs;
+    };
+    for (auto &frame : batch->batchFrames) {
+        if (isStale(frame)) {
+            ReleaseCommonDataDvpp(*frame);
+            droppedCountMap[frame->channelId]++;
+        }
+    }
+    auto &frames = batch->batchFrames;
+    frames.erase(std::remove_if(frames.begin(), frames.end(), isStale), frames.end());
+    if (frames.empty()) {
+        return true;
+    }
+    batch->channelId = frames[0]->channelId;
+    batch->frameId = frames[0]->frameId;
+    batch->timestampUs = frames[0]->timestampUs;
+    batch->deadlineUs = 0;
+    for (auto &frame : frames) {
+        batch->timestampUs = std::min(batch->timestampUs, frame->timestampUs);
+        if (frame->deadlineUs != 0 && (batch->deadlineUs == 0 || frame->deadlineUs < batch->deadlineUs)) {
+            batch->deadlineUs = frame->deadlineUs;
+        }
+    }
+    return false;
+}
+
 APP_ERROR ModelInfer::DeInit(void)
 {
     LogInfo << "ModelInfer[" << instanceId_ << "]: ModelInfer::begin to deinit.";
@@ -163,6 +318,14 @@ APP_ERROR ModelInfer::DeInit(void)
             aclrtFree(j);
         }
     }
+    if (batchInput_ != nullptr) {
+        aclrtFree(batchInput_);
+        batchInput_ = nullptr;
+    }
+    if (dynamicInput_ != nullptr) {
+        aclrtFree(dynamicInput_);
+        dynamicInput_ = nullptr;
+    }
     LogInfo << "ModelInfer[" << instanceId_ << "]: ModelInfer deinit success.";
     return APP_ERR_OK;
 }
@@ -204,6 +367,124 @@ APP_ERROR ModelInfer::YoloProcess(std::shared_ptr<DvppDataInfo> &vpcData, std::v
     return APP_ERR_OK;
 }
 
+/*
+ * @description: Infer a batch of frames at one time and send the result of each frame to PostProcess
+ * @param frames The frames of the batch, up to maxBatch_
+ */
+APP_ERROR ModelInfer::InferBatch(const std::vector<std::shared_ptr<CommonData>> &frames)
+{
+    // the smallest batch gear holding the frames, the rest of the input is left as it is and its result ignored
+    uint32_t batchSize = maxBatch_;
+    for (auto gear : batchGears_) {
+        if (gear >= frames.size()) {
+            batchSize = gear;
+            break;
+        }
+    }
+    std::vector<void *> inputDataBuffers;
+    std::vector<size_t> buffersSize;
+    std::shared_ptr<void> yoloInfo;
+    APP_ERROR ret = PackBatchInput(frames, batchSize, inputDataBuffers, buffersSize, yoloInfo);
+    for (auto &frame : frames) {
+        ReleaseCommonDataDvpp(*frame);
+    }
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to execute PackBatchInput, ret = " << ret;
+        return ret;
+    }
+
+    std::vector<void *> outBuf = buffers_.front();
+    buffers_.pop();
+    buffers_.push(outBuf);
+    std::vector<size_t> outSizes = ModelBufferSize::bufferSize_;
+
+    ret = modelProcess_->ModelInference(inputDataBuffers, buffersSize, outBuf, outSizes,
+        batchGears_.empty() ? 0 : batchSize);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to execute ModelInference, ret = " << ret;
+        return ret;
+    }
+    // each output holds the results of the frames one after the other
+    for (size_t i = 0; i < frames.size(); i++) {
+        std::shared_ptr<CommonData> data = frames[i];
+        data->inferOutput.clear();
+        for (size_t j = 0; j < outBuf.size(); j++) {
+            size_t frameOutputSize = outSizes[j] / maxBatch_;
+            RawData rawDevData = RawData();
+            rawDevData.data.reset(static_cast<uint8_t *>(outBuf[j]) + i * frameOutputSize, [](void*) {});
+            rawDevData.lenOfByte = frameOutputSize;
+            data->inferOutput.push_back(std::move(rawDevData));
+        }
+        data->modelWidth = modelWidth_;
+        data->modelHeight = modelHeight_;
+        data->modelType = modelType_;
+        SendToNextModule(postProcessOutput_, data, data->channelId);
+    }
+    return APP_ERR_OK;
+}
+
+/*
+ * @description: Copy the resized images of a batch into the model input, and fill the other inputs for batchSize
+ * @param: frames The frames of the batch
+ * @param: batchSize The batch size of the inference, at least the number of frames
+ * @param: inputDataBuffers Input buffer
+ * @param: buffersSize Input buffer sizes
+ * @param yoloInfo The second input of the model, the memory needs to be released
+ */
+APP_ERROR ModelInfer::PackBatchInput(const std::vector<std::shared_ptr<CommonData>> &frames, uint32_t batchSize,
+    std::vector<void *> &inputDataBuffers, std::vector<size_t> &buffersSize, std::shared_ptr<void> &yoloInfo)
+{
+    for (size_t i = 0; i < frames.size(); i++) {
+        const std::shared_ptr<DvppDataInfo> &vpcData = frames[i]->dvppData;
+        if (vpcData->dataSize != frameInputSize_) {
+            LogError << "The resized image size " << vpcData->dataSize << " is not the input size of a frame " <<
+                frameInputSize_;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        APP_ERROR ret = aclrtMemcpy(static_cast<uint8_t *>(batchInput_) + i * frameInputSize_, frameInputSize_,
+            vpcData->data, frameInputSize_, ACL_MEMCPY_DEVICE_TO_DEVICE);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to execute aclrtMemcpy, ret = " << ret;
+            return ret;
+        }
+    }
+    inputDataBuffers.push_back(batchInput_);
+    buffersSize.push_back(batchSize * frameInputSize_);
+    if (modelType_ == YOLOV3_CAFFE) {
+        // image info of each frame, the padding of the batch repeats the last frame
+        std::vector<float> imgInfo(batchSize * IMAGE_INFO_ARRAY_SIZE, 0);
+        for (size_t i = 0; i < batchSize; i++) {
+            const CommonData &frame = *frames[std::min(i, frames.size() - 1)];
+            imgInfo[i * IMAGE_INFO_ARRAY_SIZE + MODEL_HEIGHT_INDEX] = modelHeight_;
+            imgInfo[i * IMAGE_INFO_ARRAY_SIZE + MODEL_WIDTH_INDEX] = modelWidth_;
+            imgInfo[i * IMAGE_INFO_ARRAY_SIZE + IMAGE_HEIGHT_INDEX] = frame.srcHeight;
+            imgInfo[i * IMAGE_INFO_ARRAY_SIZE + IMAGE_WIDTH_INDEX] = frame.srcWidth;
+        }
+        void *yoloImgInfo = nullptr;
+        uint32_t imgInfoInputSize = sizeof(float) * imgInfo.size();
+        APP_ERROR ret = acldvppMalloc(&yoloImgInfo, imgInfoInputSize);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to malloc buffer, size is " << imgInfoInputSize << ", ret = " << ret;
+            return ret;
+        }
+        yoloInfo.reset(yoloImgInfo, acldvppFree);
+        ret = aclrtMemcpy(yoloImgInfo, imgInfoInputSize, imgInfo.data(), imgInfoInputSize, ACL_MEMCPY_HOST_TO_DEVICE);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to execute aclrtMemcpy, ret = " << ret;
+            return ret;
+        }
+        inputDataBuffers.push_back(yoloImgInfo);
+        buffersSize.push_back(imgInfoInputSize);
+    }
+    // ModelProcess writes the batch size into the dynamic batch input
+    if (dynamicInput_ != nullptr) {
+        size_t index = std::min(dynamicInputIndex_, inputDataBuffers.size());
+        inputDataBuffers.insert(inputDataBuffers.begin() + index, dynamicInput_);
+        buffersSize.insert(buffersSize.begin() + index, dynamicInputSize_);
+    }
+    return APP_ERR_OK;
+}
+
 /*
  * @description: Apply memory for model inference input Data
  * @param: vpcData The resize result to inference
@@ -40,7 +40,7 @@ struct ModelBufferSize {
     static std::vector<size_t> bufferSize_;
 };
 
-class ModelInfer : public ascendBaseModule::ModuleBase {
+class ModelInfer : public ascendBaseModule::TypedModuleBase<CommonData> {
 public:
     ModelInfer();
     ~ModelInfer();
@@ -48,7 +48,11 @@ public:
     APP_ERROR DeInit(void);
 
 protected:
-    APP_ERROR Process(std::shared_ptr<void> inputData);
+    APP_ERROR ProcessMessage(std::shared_ptr<CommonData> data);
+    bool IsDroppable(const std::shared_ptr<void> &outputData);
+    void OnInputDropped(const std::shared_ptr<void> &inputData);
+    bool DropStaleFrames(const std::shared_ptr<void> &inputData, const ascendBaseModule::ModuleMessageInfo &info,
+        uint64_t staleBeforeUs, std::map<uint32_t, uint64_t> &droppedCountMap);
 
 private:
     APP_ERROR InputBuffMalloc(std::shared_ptr<DvppDataInfo> &vpcData, std::vector<void *> &inputDataBuffers,
@@ -56,6 +60,13 @@ private:
     APP_ERROR ParseConfig(ConfigParser &configParser);
 
     APP_ERROR YoloProcess(std::shared_ptr<DvppDataInfo> &vpcData, std::vector<RawData> &modelOutput);
+    APP_ERROR InitBatchInput(aclmdlDesc *modelDesc);
+    bool DropLateFrame(const std::shared_ptr<CommonData> &data);
+    APP_ERROR InferFrame(std::shared_ptr<CommonData> &data);
+    APP_ERROR InferFrames(std::vector<std::shared_ptr<CommonData>> &frames);
+    APP_ERROR InferBatch(const std::vector<std::shared_ptr<CommonData>> &frames);
+    APP_ERROR PackBatchInput(const std::vector<std::shared_ptr<CommonData>> &frames, uint32_t batchSize,
+        std::vector<void *> &inputDataBuffers, std::vector<size_t> &buffersSize, std::shared_ptr<void> &yoloInfo);
 private:
     int deviceId_ = 0;
     uint32_t modelWidth_ = 0;
@@ -69,6 +80,15 @@ private:
     std::unique_ptr<ModelProcess> modelProcess_ = nullptr;
 
     std::queue<std::vector<void *>> buffers_ = {};
+    // batch inference, used when the model takes several frames (static batch size or dynamic batch gears)
+    uint32_t maxBatch_ = 1;
+    std::vector<uint32_t> batchGears_ = {}; // dynamic batch sizes of the model in ascending order, empty if static
+    size_t frameInputSize_ = 0;
+    void *batchInput_ = nullptr; // the resized images of a batch one after the other
+    size_t dynamicInputIndex_ = 0;
+    void *dynamicInput_ = nullptr; // input holding the batch size of a dynamic batch model, set by ModelProcess
+    size_t dynamicInputSize_ = 0;
+    ascendBaseModule::ModuleOutputHandle postProcessOutput_ = nullptr; // resolved by the first Process call
 };
 
 MODULE_REGIST(ModelInfer)
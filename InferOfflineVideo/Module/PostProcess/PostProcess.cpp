@@ -219,9 +219,8 @@ APP_ERROR PostProcess::GetObjectInfoTensorflow(std::vector<RawData> &modelOutput
     return APP_ERR_OK;
 }
 
-APP_ERROR PostProcess::Process(std::shared_ptr<void> inputData)
+APP_ERROR PostProcess::ProcessMessage(std::shared_ptr<CommonData> data)
 {
-    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(inputData);
     if (data->eof) {
         Singleton::GetInstance().GetStopedStreamNum()++;
         if (Singleton::GetInstance().GetStopedStreamNum() == Singleton::GetInstance().GetStreamPullerNum()) {
@@ -245,6 +244,16 @@ APP_ERROR PostProcess::Process(std::shared_ptr<void> inputData)
     return APP_ERR_OK;
 }
 
+// with PostProcess.reorderWindow, the end of stream mark of a channel is processed after the frames of the
+// channel, which may still be inferred by another ModelInfer instance when it arrives
+bool PostProcess::GetSequenceInfo(const std::shared_ptr<void> &message, uint32_t &channelId, uint64_t &sequenceId)
+{
+    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(message);
+    channelId = data->channelId;
+    sequenceId = data->sequenceId;
+    return true;
+}
+
 APP_ERROR PostProcess::DeInit(void)
 {
     while (!buffers_.empty()) {
@@ -24,7 +24,7 @@
 #include "Yolov3Post.h"
 #include "ModelInfer/ModelInfer.h"
 
-class PostProcess : public ascendBaseModule::ModuleBase {
+class PostProcess : public ascendBaseModule::TypedModuleBase<CommonData> {
 public:
     PostProcess();
     ~PostProcess();
@@ -32,7 +32,8 @@ public:
     APP_ERROR DeInit(void);
 
 protected:
-    APP_ERROR Process(std::shared_ptr<void> inputData);
+    APP_ERROR ProcessMessage(std::shared_ptr<CommonData> data);
+    bool GetSequenceInfo(const std::shared_ptr<void> &message, uint32_t &channelId, uint64_t &sequenceId);
 
 private:
     APP_ERROR YoloPostProcess(std::vector<RawData> &modelOutput, std::shared_ptr<DeviceStreamData> &dataToSend,
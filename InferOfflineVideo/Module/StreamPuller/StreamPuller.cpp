@@ -19,7 +19,7 @@
 #include <chrono>
 #include <iostream>
 #include <atomic>
-#include <unistd.h>
+#include <poll.h>
 #include "Log/Log.h"
 #include "VideoDecoder/VideoDecoder.h"
 #include "Singleton.h"
@@ -29,11 +29,16 @@ using namespace ascendBaseModule;
 namespace {
 const int LOW_THRESHOLD = 128;
 const int MAX_THRESHOLD = 4096;
+const uint64_t MS_TO_US = 1000;
+const uint32_t FILE_PACKET_INTERVAL_MS = 35;
 }
 
 StreamPuller::StreamPuller()
 {
     withoutInputQueue_ = true;
+    runInSteps_ = true;
+    isSingleSendThread_ = true;
+    isChannelPerInstance_ = true;
 }
 
 StreamPuller::~StreamPuller() {}
@@ -42,7 +47,41 @@ APP_ERROR StreamPuller::ParseConfig(ConfigParser &configParser)
 {
     LogDebug << "StreamPuller [" << instanceId_ << "]: begin to parse config values.";
     std::string itemCfgStr = std::string("stream.ch") + std::to_string(instanceId_);
-    return configParser.GetStringValue(itemCfgStr, streamName_);
+    APP_ERROR ret = configParser.GetStringValue(itemCfgStr, streamName_);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
+    itemCfgStr = moduleName_ + std::string(".deadlineMs");
+    ret = configParser.GetUnsignedIntValue(itemCfgStr, deadlineMs_);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "StreamPuller[" << instanceId_ << "]: Fail to get config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = moduleName_ + std::string(".maxInflightFrames");
+    ret = configParser.GetUnsignedIntValue(itemCfgStr, maxInflightFrames_);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "StreamPuller[" << instanceId_ << "]: Fail to get config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = moduleName_ + std::string(".creditPolicy");
+    std::string creditPolicy = "wait";
+    ret = configParser.GetStringValue(itemCfgStr, creditPolicy);
+    if ((ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) || (creditPolicy != "wait" && creditPolicy != "drop")) {
+        LogError << "StreamPuller[" << instanceId_ << "]: Invalid config variable named " << itemCfgStr << ".";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    dropWithoutCredit_ = (creditPolicy == "drop");
+
+    itemCfgStr = moduleName_ + std::string(".captureDir");
+    ret = configParser.GetStringValue(itemCfgStr, captureDir_);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "StreamPuller[" << instanceId_ << "]: Fail to get config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
 }
 
 APP_ERROR StreamPuller::Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
@@ -50,12 +89,24 @@ APP_ERROR StreamPuller::Init(ConfigParser &configParser, ModuleInitArgs &initArg
     LogDebug << "Begin to init instance " << initArgs.instanceId;
 
     AssignInitArgs(initArgs);
+    framePool_ = GetMessagePool<CommonData>(ascendBaseModule::MESSAGE_POOL_MAX_FREE, ResetCommonData);
 
     int ret = ParseConfig(configParser);
     if (ret != APP_ERR_OK) {
         LogError << "StreamPuller[" << instanceId_ << "]: Fail to parse config params." << GetAppErrCodeInfo(ret);
         return ret;
     }
+    if (maxInflightFrames_ != 0) {
+        flowCredit_ = std::make_shared<FlowCredit>(maxInflightFrames_);
+    }
+    // Only the video files run on the event loop shared by the channels. FFmpeg waits in av_read_frame for the
+    // packets of a live stream and exposes neither the socket of the demuxer, to wait on it with MODULE_WAIT_FD, nor
+    // a read that stops without losing a packet read in part: its interrupt callback is checked every 100 ms and
+    // drops the bytes of an interleaved rtp packet already read. A rtsp stream keeps a thread of its own.
+    isFileStream_ = (streamName_.find("rtsp:") != 0);
+    if (!isFileStream_) {
+        eventLoop_ = nullptr;
+    }
 
     isStop_ = false;
     pFormatCtx_ = nullptr;
@@ -69,26 +120,46 @@ APP_ERROR StreamPuller::DeInit(void)
     LogDebug << "StreamPuller [" << instanceId_ << "]: Deinit start.";
 
     // clear th cache of the queue
+    ReleasePacket();
+    captureWriter_.Close();
     avformat_close_input(&pFormatCtx_);
 
     isStop_ = true;
     pFormatCtx_ = nullptr;
+    if (creditDropCount_ != 0) {
+        LogInfo << "StreamPuller [" << instanceId_ << "]: " << creditDropCount_ << " packets dropped without credit.";
+    }
     LogDebug << "StreamPuller [" << instanceId_ << "]: Deinit success.";
     return APP_ERR_OK;
 }
 
+// StreamPuller runs in steps, see ProcessStep
 APP_ERROR StreamPuller::Process(std::shared_ptr<void> inputData)
 {
-    int failureNum = 0;
-    while (failureNum < 1) {
-        StartStream();
-        failureNum++;
+    return APP_ERR_OK;
+}
+
+// The first step opens the stream, each next one reads a packet and sends it to the decoder. Between the steps the
+// instance waits for the packets of a file to be due or for a credit, without holding a thread when the steps run on
+// the event loop. The steps of a live stream run on the thread of the instance, blocked in av_read_frame between the
+// packets.
+APP_ERROR StreamPuller::ProcessStep(ModuleWaitInfo &waitInfo)
+{
+    if (pFormatCtx_ == nullptr) {
+        APP_ERROR ret = StartStream();
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        waitInfo.type = MODULE_WAIT_NONE;
+        return APP_ERR_OK;
     }
+    ReadPacket(waitInfo);
     return APP_ERR_OK;
 }
 
 APP_ERROR StreamPuller::StartStream()
 {
+    videoDecoderOutput_ = GetOutputHandle(MT_VideoDecoder);
     avformat_network_init(); // init network
     pFormatCtx_ = CreateFormatContext(); // create context
     if (pFormatCtx_ == nullptr) {
@@ -104,10 +175,37 @@ APP_ERROR StreamPuller::StartStream()
         LogError << "Stream Info Check failed, ret = " << ret;
         return APP_ERR_COMM_FAILURE;
     }
+    if (!captureDir_.empty()) {
+        ret = StartCapture();
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
 
     LogInfo << "Start the stream......";
-    PullStreamDataLoop(); // Cyclic stream pull
+    return APP_ERR_OK;
+}
 
+// StreamReplayer feeds the pipeline with the captured packets, see PacketCapture.h for the file
+APP_ERROR StreamPuller::StartCapture()
+{
+    AVCodecParameters *codecpar = pFormatCtx_->streams[videoStream_]->codecpar;
+    PacketCaptureHeader header = {};
+    header.channelId = channelId_;
+    header.codecId = static_cast<uint32_t>(codecpar->codec_id);
+    header.videoFormat = static_cast<uint32_t>(videoFormat_);
+    header.width = videoWidth_;
+    header.height = videoHeight_;
+    header.timeBaseNum = pFormatCtx_->streams[videoStream_]->time_base.num;
+    header.timeBaseDen = pFormatCtx_->streams[videoStream_]->time_base.den;
+    header.extradataSize = (codecpar->extradata == nullptr) ? 0 : static_cast<uint32_t>(codecpar->extradata_size);
+    std::string capturePath = captureDir_ + "/ch" + std::to_string(channelId_) + ".cap";
+    APP_ERROR ret = captureWriter_.Open(capturePath, header, codecpar->extradata);
+    if (ret != APP_ERR_OK) {
+        LogError << "StreamPuller [" << instanceId_ << "]: Fail to start the capture, ret = " << ret;
+        return ret;
+    }
+    LogInfo << "StreamPuller [" << instanceId_ << "]: capture the packets in " << capturePath;
     return APP_ERR_OK;
 }
 
@@ -173,49 +271,112 @@ AVFormatContext *StreamPuller::CreateFormatContext() const
     return formatContext;
 }
 
-void StreamPuller::PullStreamDataLoop()
+void StreamPuller::ReadPacket(ModuleWaitInfo &waitInfo)
 {
-    // Pull data cyclically
-    const uint16_t delayTime = 35000;
-    AVPacket pkt;
-    while (1) {
-        if (isStop_ || pFormatCtx_ == nullptr) {
-            break;
-        }
-        av_init_packet(&pkt);
-        int ret = av_read_frame(pFormatCtx_, &pkt);
-        if (ret != 0) {
-            if (ret == AVERROR_EOF) {
-                LogInfo << "StreamPuller [" << instanceId_ << "]: channel StreamPuller is EOF, exit";
-                std::shared_ptr<CommonData> frameData = std::make_shared<CommonData>();
-                frameData->eof = true;
-                SendToNextModule(MT_VideoDecoder, frameData, channelId_);
-                break;
-            }
+    waitInfo.type = MODULE_WAIT_NONE;
+    if (!hasPacket_) {
+        av_init_packet(&packet_);
+        int ret = av_read_frame(pFormatCtx_, &packet_);
+        if (ret == AVERROR_EOF) {
+            LogInfo << "StreamPuller [" << instanceId_ << "]: channel StreamPuller is EOF, exit";
+            std::shared_ptr<CommonData> frameData = framePool_->Acquire();
+            frameData->eof = true;
+            frameData->channelId = channelId_;
+            SendToNextModule(videoDecoderOutput_, frameData, channelId_);
+            waitInfo.type = MODULE_WAIT_DONE;
+            return;
+        } else if (ret != 0) {
             LogInfo << "StreamPuller [" << instanceId_ << "]: channel Read frame failed, continue";
-            av_packet_unref(&pkt);
-            continue;
-        } else if (pkt.stream_index == videoStream_) {
-            if (pkt.size <= 0) {
-                LogError << "Invalid pkt.size: " << pkt.size;
-                av_packet_unref(&pkt);
-                continue;
-            }
-
-            std::shared_ptr<CommonData> commonData = std::make_shared<CommonData>();
-            commonData->eof = false;
-            commonData->channelId = channelId_;
-            commonData->srcWidth = videoWidth_;
-            commonData->srcHeight = videoHeight_;
-            commonData->videoFormat = videoFormat_;
-            commonData->streamData.data.reset(new uint8_t[pkt.size], std::default_delete<uint8_t[]>());
-            std::copy(pkt.data, pkt.data + pkt.size, static_cast<uint8_t*>(commonData->streamData.data.get()));
-            commonData->streamData.size = pkt.size;
-            SendToNextModule(MT_VideoDecoder, commonData, commonData->channelId);
+            av_packet_unref(&packet_);
+            return;
+        } else if (packet_.stream_index != videoStream_) {
+            av_packet_unref(&packet_);
+            return;
+        } else if (packet_.size <= 0) {
+            LogError << "Invalid pkt.size: " << packet_.size;
+            av_packet_unref(&packet_);
+            return;
         }
-        av_packet_unref(&pkt);
-        if (streamName_.find("rtsp:") != 0) {
-            usleep(delayTime); // delay 35ms
+        hasPacket_ = true;
+        // the packets dropped without credit are captured too, the replay meets the same input
+        captureWriter_.Write(GetModuleTimeUs(), packet_.pts, packet_.dts, static_cast<uint32_t>(packet_.flags),
+            packet_.data, static_cast<uint32_t>(packet_.size));
+    }
+
+    std::shared_ptr<void> flowCredit = nullptr;
+    if (flowCredit_ != nullptr && !AcquireFlowCredit(packet_, flowCredit)) {
+        if (!dropWithoutCredit_ && !isStop_) {
+            // the packet is tried again once a frame releases its credit
+            waitInfo.type = MODULE_WAIT_FD;
+            waitInfo.fd = flowCredit_->GetReadyFd();
+            waitInfo.fdEvents = POLLIN;
+            return;
         }
+        ReleasePacket();
+        return;
+    }
+    SendPacket(packet_, flowCredit);
+    ReleasePacket();
+    if (isFileStream_) {
+        waitInfo.type = MODULE_WAIT_TIMER;
+        waitInfo.timeoutMs = FILE_PACKET_INTERVAL_MS;
+    }
+}
+
+void StreamPuller::SendPacket(const AVPacket &pkt, std::shared_ptr<void> flowCredit)
+{
+    std::shared_ptr<CommonData> commonData = framePool_->Acquire();
+    commonData->flowCredit = flowCredit;
+    commonData->eof = false;
+    commonData->channelId = channelId_;
+    commonData->srcWidth = videoWidth_;
+    commonData->srcHeight = videoHeight_;
+    commonData->videoFormat = videoFormat_;
+    commonData->timestampUs = GetModuleTimeUs();
+    commonData->deadlineUs = (deadlineMs_ == 0) ? 0 : (commonData->timestampUs + deadlineMs_ * MS_TO_US);
+    // with a shm connect the packet is written once, in a buffer which VideoDecoder reads from the other process
+    std::shared_ptr<uint8_t> buffer = nullptr;
+    if (videoDecoderOutput_->shmSegment != nullptr) {
+        buffer = videoDecoderOutput_->shmSegment->AllocBuffer(static_cast<uint32_t>(pkt.size));
     }
+    if (buffer != nullptr) {
+        commonData->streamData.data = buffer;
+    } else {
+        commonData->streamData.data.reset(new uint8_t[pkt.size], std::default_delete<uint8_t[]>());
+    }
+    std::copy(pkt.data, pkt.data + pkt.size, static_cast<uint8_t*>(commonData->streamData.data.get()));
+    commonData->streamData.size = pkt.size;
+    SendToNextModule(videoDecoderOutput_, commonData, commonData->channelId);
+}
+
+void StreamPuller::ReleasePacket()
+{
+    if (hasPacket_) {
+        av_packet_unref(&packet_);
+        hasPacket_ = false;
+    }
+}
+
+// Takes a credit without waiting, false if there is none: the step tries the packet again later, or with
+// creditPolicy = drop the packet is dropped. Once a packet is dropped, the next ones are dropped up to a key frame,
+// which the decoder can decode without them.
+bool StreamPuller::AcquireFlowCredit(const AVPacket &pkt, std::shared_ptr<void> &flowCredit)
+{
+    if (!dropWithoutCredit_) {
+        flowCredit = flowCredit_->Acquire(0);
+        return flowCredit != nullptr;
+    }
+    if (!waitKeyFrame_ || (pkt.flags & AV_PKT_FLAG_KEY) != 0) {
+        flowCredit = flowCredit_->Acquire(0);
+    }
+    waitKeyFrame_ = (flowCredit == nullptr);
+    if (flowCredit == nullptr) {
+        creditDropCount_++;
+    }
+    return flowCredit != nullptr;
+}
+
+bool StreamPuller::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return IsCommonDataDroppable(outputData);
 }
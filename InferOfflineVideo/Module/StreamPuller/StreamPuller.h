@@ -20,8 +20,10 @@
 #include "acl/acl.h"
 #include "ErrorCode/ErrorCode.h"
 #include "ModuleManager/ModuleManager.h"
+#include "ModuleManager/FlowCredit.h"
 #include "ConfigParser/ConfigParser.h"
 #include "DataType/DataType.h"
+#include "PacketCapture.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -36,13 +38,19 @@ public:
 
 protected:
     APP_ERROR Process(std::shared_ptr<void> inputData);
+    APP_ERROR ProcessStep(ascendBaseModule::ModuleWaitInfo &waitInfo);
+    bool IsDroppable(const std::shared_ptr<void> &outputData);
 
 private:
     APP_ERROR ParseConfig(ConfigParser &configParser);
     APP_ERROR StartStream();
     AVFormatContext *CreateFormatContext() const;
     APP_ERROR GetStreamInfo();
-    void PullStreamDataLoop();
+    void ReadPacket(ascendBaseModule::ModuleWaitInfo &waitInfo);
+    void SendPacket(const AVPacket &pkt, std::shared_ptr<void> flowCredit);
+    void ReleasePacket();
+    bool AcquireFlowCredit(const AVPacket &pkt, std::shared_ptr<void> &flowCredit);
+    APP_ERROR StartCapture();
 
 private:
     int videoStream_ = {};
@@ -51,7 +59,20 @@ private:
     uint32_t videoHeight_ = {};
     acldvppStreamFormat videoFormat_ = {};
     std::string streamName_ = {};
+    uint32_t deadlineMs_ = 0; // 0 means the frames have no deadline
     AVFormatContext *pFormatCtx_ = nullptr;
+    ascendBaseModule::ModuleOutputHandle videoDecoderOutput_ = nullptr;
+    std::shared_ptr<ascendBaseModule::MessagePool<CommonData>> framePool_ = nullptr;
+    uint32_t maxInflightFrames_ = 0; // 0 means no flow control
+    bool dropWithoutCredit_ = false; // drop the packets instead of waiting when there is no credit
+    std::shared_ptr<ascendBaseModule::FlowCredit> flowCredit_ = nullptr;
+    bool waitKeyFrame_ = false;
+    bool isFileStream_ = false; // the packets of a file are paced, a live stream paces itself
+    AVPacket packet_ = {};
+    bool hasPacket_ = false; // packet_ is read and waits for a credit
+    uint64_t creditDropCount_ = 0;
+    std::string captureDir_ = {}; // the packets are captured in <captureDir>/ch<channelId>.cap, not if empty
+    PacketCaptureWriter captureWriter_ = {};
 };
 
 MODULE_REGIST(StreamPuller)
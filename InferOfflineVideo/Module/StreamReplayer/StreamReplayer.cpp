@@ -0,0 +1,189 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "StreamReplayer.h"
+
+#include <algorithm>
+#include "Log/Log.h"
+#include "VideoDecoder/VideoDecoder.h"
+
+using namespace ascendBaseModule;
+
+namespace {
+const uint64_t MS_TO_US = 1000;
+const uint32_t REPLAY_STEP_PACKETS = 16; // packets sent by one step when they are due or not paced
+}
+
+StreamReplayer::StreamReplayer()
+{
+    withoutInputQueue_ = true;
+    runInSteps_ = true;
+    isSingleSendThread_ = true;
+    isChannelPerInstance_ = true;
+}
+
+StreamReplayer::~StreamReplayer() {}
+
+APP_ERROR StreamReplayer::ParseConfig(ConfigParser &configParser)
+{
+    std::string itemCfgStr = std::string("SystemConfig.replayDir");
+    std::string replayDir;
+    APP_ERROR ret = configParser.GetStringValue(itemCfgStr, replayDir);
+    if (ret != APP_ERR_OK) {
+        LogError << "StreamReplayer[" << instanceId_ << "]: Fail to get config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    capturePath_ = replayDir + "/ch" + std::to_string(instanceId_) + ".cap";
+
+    itemCfgStr = moduleName_ + std::string(".speed");
+    ret = configParser.GetDoubleValue(itemCfgStr, speed_);
+    if ((ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) || speed_ < 0) {
+        LogError << "StreamReplayer[" << instanceId_ << "]: Invalid config variable named " << itemCfgStr << ".";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+
+    itemCfgStr = moduleName_ + std::string(".deadlineMs");
+    ret = configParser.GetUnsignedIntValue(itemCfgStr, deadlineMs_);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "StreamReplayer[" << instanceId_ << "]: Fail to get config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR StreamReplayer::Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
+{
+    LogDebug << "Begin to init instance " << initArgs.instanceId;
+
+    AssignInitArgs(initArgs);
+    framePool_ = GetMessagePool<CommonData>(ascendBaseModule::MESSAGE_POOL_MAX_FREE, ResetCommonData);
+    channelId_ = instanceId_;
+
+    APP_ERROR ret = ParseConfig(configParser);
+    if (ret != APP_ERR_OK) {
+        LogError << "StreamReplayer[" << instanceId_ << "]: Fail to parse config params." << GetAppErrCodeInfo(ret);
+        return ret;
+    }
+    ret = captureReader_.Open(capturePath_);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    const PacketCaptureHeader &header = captureReader_.GetHeader();
+    if (header.videoFormat != H264_MAIN_LEVEL && header.videoFormat != H265_MAIN_LEVEL) {
+        LogError << "StreamReplayer[" << instanceId_ << "]: unsupported video format " << header.videoFormat <<
+            " in " << capturePath_;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    LogInfo << "StreamReplayer [" << instanceId_ << "]: replay " << captureReader_.GetPacketCount() <<
+        " packets of " << header.width << "x" << header.height << " from " << capturePath_ << " at speed " << speed_;
+
+    isStop_ = false;
+    LogDebug << "StreamReplayer [" << instanceId_ << "] Init success.";
+    return APP_ERR_OK;
+}
+
+APP_ERROR StreamReplayer::DeInit(void)
+{
+    LogDebug << "StreamReplayer [" << instanceId_ << "]: Deinit start.";
+    captureReader_.Close();
+    isStop_ = true;
+    LogDebug << "StreamReplayer [" << instanceId_ << "]: Deinit success.";
+    return APP_ERR_OK;
+}
+
+// StreamReplayer runs in steps, see ProcessStep
+APP_ERROR StreamReplayer::Process(std::shared_ptr<void> inputData)
+{
+    return APP_ERR_OK;
+}
+
+// Each step sends the packets which are due, the packet i being due at its recorded time divided by the speed from
+// the first step, then waits for the next one. The packets sent late, when the pipeline blocks the sends, are caught
+// up by the next steps.
+APP_ERROR StreamReplayer::ProcessStep(ModuleWaitInfo &waitInfo)
+{
+    if (videoDecoderOutput_ == nullptr) {
+        videoDecoderOutput_ = GetOutputHandle(MT_VideoDecoder);
+        startUs_ = GetModuleTimeUs();
+    }
+    waitInfo.type = MODULE_WAIT_NONE;
+    uint64_t packetCount = captureReader_.GetPacketCount();
+    for (uint32_t i = 0; i < REPLAY_STEP_PACKETS && nextPacket_ < packetCount && !isStop_; i++) {
+        if (speed_ != 0) {
+            uint64_t dueUs = startUs_ +
+                static_cast<uint64_t>(captureReader_.GetPacketTimestampUs(nextPacket_) / speed_);
+            uint64_t nowUs = GetModuleTimeUs();
+            if (dueUs > nowUs) {
+                waitInfo.type = MODULE_WAIT_TIMER;
+                waitInfo.timeoutMs = static_cast<uint32_t>((dueUs - nowUs + MS_TO_US - 1) / MS_TO_US);
+                return APP_ERR_OK;
+            }
+        }
+        SendPacket(nextPacket_++);
+    }
+    if (nextPacket_ >= packetCount) {
+        LogInfo << "StreamReplayer [" << instanceId_ << "]: channel replayed in " <<
+            (GetModuleTimeUs() - startUs_) / MS_TO_US << " ms, exit";
+        SendEof();
+        waitInfo.type = MODULE_WAIT_DONE;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR StreamReplayer::SendPacket(uint64_t packetIndex)
+{
+    APP_ERROR ret = captureReader_.ReadPacket(packetIndex, record_, packetData_);
+    if (ret != APP_ERR_OK || packetData_.empty()) {
+        return ret;
+    }
+    const PacketCaptureHeader &header = captureReader_.GetHeader();
+    std::shared_ptr<CommonData> commonData = framePool_->Acquire();
+    commonData->eof = false;
+    commonData->channelId = channelId_;
+    commonData->srcWidth = header.width;
+    commonData->srcHeight = header.height;
+    commonData->videoFormat = static_cast<acldvppStreamFormat>(header.videoFormat);
+    commonData->timestampUs = GetModuleTimeUs();
+    commonData->deadlineUs = (deadlineMs_ == 0) ? 0 : (commonData->timestampUs + deadlineMs_ * MS_TO_US);
+    // with a shm connect the packet is written in a buffer which VideoDecoder reads from the other process
+    std::shared_ptr<uint8_t> buffer = nullptr;
+    if (videoDecoderOutput_->shmSegment != nullptr) {
+        buffer = videoDecoderOutput_->shmSegment->AllocBuffer(static_cast<uint32_t>(packetData_.size()));
+    }
+    if (buffer != nullptr) {
+        commonData->streamData.data = buffer;
+    } else {
+        commonData->streamData.data.reset(new uint8_t[packetData_.size()], std::default_delete<uint8_t[]>());
+    }
+    std::copy(packetData_.begin(), packetData_.end(), static_cast<uint8_t*>(commonData->streamData.data.get()));
+    commonData->streamData.size = packetData_.size();
+    SendToNextModule(videoDecoderOutput_, commonData, commonData->channelId);
+    return APP_ERR_OK;
+}
+
+void StreamReplayer::SendEof()
+{
+    std::shared_ptr<CommonData> frameData = framePool_->Acquire();
+    frameData->eof = true;
+    frameData->channelId = channelId_;
+    SendToNextModule(videoDecoderOutput_, frameData, channelId_);
+}
+
+bool StreamReplayer::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return IsCommonDataDroppable(outputData);
+}
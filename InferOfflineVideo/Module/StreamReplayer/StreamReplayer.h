@@ -0,0 +1,63 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_STREAM_REPLAYER_H
+#define INC_STREAM_REPLAYER_H
+
+#include "ErrorCode/ErrorCode.h"
+#include "ModuleManager/ModuleManager.h"
+#include "ConfigParser/ConfigParser.h"
+#include "DataType/DataType.h"
+#include "PacketCapture.h"
+
+// Replaces StreamPuller with SystemConfig.replayDir: each instance sends the packets captured by StreamPuller in
+// <replayDir>/ch<instanceId>.cap to VideoDecoder, so that a run can be repeated with the same input. With
+// StreamReplayer.speed = 1 the packets are sent at the recorded pace, N sends them N times faster and 0 as fast as
+// the pipeline takes them.
+class StreamReplayer : public ascendBaseModule::ModuleBase {
+public:
+    StreamReplayer();
+    ~StreamReplayer();
+    APP_ERROR Init(ConfigParser &configParser, ascendBaseModule::ModuleInitArgs &initArgs);
+    APP_ERROR DeInit(void);
+
+protected:
+    APP_ERROR Process(std::shared_ptr<void> inputData);
+    APP_ERROR ProcessStep(ascendBaseModule::ModuleWaitInfo &waitInfo);
+    bool IsDroppable(const std::shared_ptr<void> &outputData);
+
+private:
+    APP_ERROR ParseConfig(ConfigParser &configParser);
+    APP_ERROR SendPacket(uint64_t packetIndex);
+    void SendEof();
+
+private:
+    uint32_t channelId_ = {};
+    std::string capturePath_ = {};
+    double speed_ = 1.0; // 0 means as fast as possible
+    uint32_t deadlineMs_ = 0; // 0 means the frames have no deadline
+    PacketCaptureReader captureReader_ = {};
+    ascendBaseModule::ModuleOutputHandle videoDecoderOutput_ = nullptr;
+    std::shared_ptr<ascendBaseModule::MessagePool<CommonData>> framePool_ = nullptr;
+    uint64_t nextPacket_ = 0;
+    uint64_t startUs_ = 0; // time the first packet is sent
+    PacketCaptureRecord record_ = {};
+    std::vector<uint8_t> packetData_ = {};
+};
+
+MODULE_REGIST(StreamReplayer)
+
+#endif
@@ -21,6 +21,7 @@
 #include "Log/Log.h"
 #include "FileManager/FileManager.h"
 #include "ModelInfer/ModelInfer.h"
+#include "BatchAggregator/BatchAggregator.h"
 
 using namespace ascendBaseModule;
 
@@ -31,6 +32,8 @@ namespace {
 VideoDecoder::VideoDecoder()
 {
     isStop_ = false;
+    // the frames are sent from the thread of the DVPP callbacks and the end of streams from Process, so the queues
+    // of ModelInfer may have two producers and isSingleSendThread_ stays false
 }
 
 VideoDecoder::~VideoDecoder() {}
@@ -47,18 +50,21 @@ void VideoDecoder::VideoDecoderCallBack(acldvppStreamDesc *input, acldvppPicDesc
         LogError << "fail to destroy input stream desc";
     }
 
-    auto videoDecoder = static_cast<VideoDecoder*>(userdata);
-    if (videoDecoder == nullptr) {
+    std::unique_ptr<VdecFrameContext> frameContext(static_cast<VdecFrameContext*>(userdata));
+    if (frameContext == nullptr || frameContext->videoDecoder == nullptr) {
         LogError << "VideoDecoder: user data is nullptr";
         return;
     }
+    auto videoDecoder = frameContext->videoDecoder;
+    // the channels of an instance share its report thread, so the callbacks of the instance never run concurrently
+    auto vdecChannel = frameContext->vdecChannel;
 
-    if (videoDecoder->frameId_ % videoDecoder->skipInterval_ == 0) {
+    if (vdecChannel->frameId % videoDecoder->skipInterval_ == 0) {
         DvppDataInfo tmp;
-        tmp.width = videoDecoder->streamWidth_;
-        tmp.height = videoDecoder->streamHeight_;
-        tmp.widthStride = DVPP_ALIGN_UP(videoDecoder->streamWidth_, VPC_STRIDE_WIDTH);
-        tmp.heightStride = DVPP_ALIGN_UP(videoDecoder->streamHeight_, VPC_STRIDE_HEIGHT);
+        tmp.width = vdecChannel->streamWidth;
+        tmp.height = vdecChannel->streamHeight;
+        tmp.widthStride = DVPP_ALIGN_UP(vdecChannel->streamWidth, VPC_STRIDE_WIDTH);
+        tmp.heightStride = DVPP_ALIGN_UP(vdecChannel->streamHeight, VPC_STRIDE_HEIGHT);
         tmp.dataSize = static_cast<uint32_t>(acldvppGetPicDescSize(output));
         tmp.data = static_cast<uint8_t*>(acldvppGetPicDescData(output));
 
@@ -67,16 +73,20 @@ void VideoDecoder::VideoDecoderCallBack(acldvppStreamDesc *input, acldvppPicDesc
         out.height = videoDecoder->resizeHeight_;
         videoDecoder->vpcDvppCommon_->CombineResizeProcess(tmp, out, true, VPC_PT_FIT);
 
-        std::shared_ptr<CommonData> toNext = std::make_shared<CommonData>();
+        std::shared_ptr<CommonData> toNext = videoDecoder->framePool_->Acquire();
         toNext->eof = false;
-        toNext->channelId = videoDecoder->channelId_;
-        toNext->srcWidth = videoDecoder->streamWidth_;
-        toNext->srcHeight = videoDecoder->streamHeight_;
-        toNext->frameId = videoDecoder->frameId_;
+        toNext->channelId = vdecChannel->channelId;
+        toNext->srcWidth = vdecChannel->streamWidth;
+        toNext->srcHeight = vdecChannel->streamHeight;
+        toNext->frameId = vdecChannel->frameId;
+        toNext->sequenceId = vdecChannel->sequenceId++;
+        toNext->timestampUs = frameContext->timestampUs;
+        toNext->deadlineUs = frameContext->deadlineUs;
+        toNext->flowCredit = frameContext->flowCredit;
         toNext->dvppData = std::move(videoDecoder->vpcDvppCommon_->GetResizedImage());
-        videoDecoder->SendToNextModule(MT_ModelInfer, toNext, toNext->channelId);
+        videoDecoder->SendToNextModule(videoDecoder->modelInferOutput_, toNext, toNext->channelId);
     }
-    videoDecoder->frameId_++;
+    vdecChannel->frameId++;
     acldvppFree(acldvppGetPicDescData(output));
     ret = (APP_ERROR)acldvppDestroyPicDesc(output);
     if (ret != APP_ERR_OK) {
@@ -105,13 +115,14 @@ void *VideoDecoder::DecoderThread(void *arg)
     return nullptr;
 }
 
-VdecConfig VideoDecoder::GetVdecConfig() const
+// the vdec channel ids must be unique in the process, the stream channel ids are
+VdecConfig VideoDecoder::GetVdecConfig(const VdecChannel &vdecChannel) const
 {
     VdecConfig vdecConfig;
-    vdecConfig.inputWidth = streamWidth_;
-    vdecConfig.inputHeight = streamHeight_;
+    vdecConfig.inputWidth = vdecChannel.streamWidth;
+    vdecConfig.inputHeight = vdecChannel.streamHeight;
     vdecConfig.outFormat = PIXEL_FORMAT_YUV_SEMIPLANAR_420;
-    vdecConfig.channelId = instanceId_;
+    vdecConfig.channelId = vdecChannel.channelId;
     vdecConfig.threadId = decoderThreadId_;
     vdecConfig.callback = &VideoDecoder::VideoDecoderCallBack;
     return vdecConfig;
@@ -122,6 +133,7 @@ APP_ERROR VideoDecoder::Init(ConfigParser &configParser, ModuleInitArgs &initArg
     LogDebug << "Begin to init instance " << initArgs.instanceId;
 
     AssignInitArgs(initArgs);
+    framePool_ = GetMessagePool<CommonData>(ascendBaseModule::MESSAGE_POOL_MAX_FREE, ResetCommonData);
 
     int ret = ParseConfig(configParser);
     if (ret != APP_ERR_OK) {
@@ -136,6 +148,7 @@ APP_ERROR VideoDecoder::Init(ConfigParser &configParser, ModuleInitArgs &initArg
         return APP_ERR_ACL_FAILURE;
     }
     LogInfo <<"thread create ID = " << decoderThreadId_;
+    RegisterThread(decoderThreadId_);
 
     ret = aclrtCreateStream(&vpcDvppStream_);
     if (ret != APP_ERR_OK) {
@@ -196,53 +209,83 @@ APP_ERROR VideoDecoder::ParseConfig(ConfigParser &configParser)
     return ret;
 }
 
-APP_ERROR VideoDecoder::CreateVdecDvppCommon(acldvppStreamFormat format)
+// created with the first packet of the stream, which carries its size and format
+APP_ERROR VideoDecoder::CreateVdecChannel(const CommonData &data, VdecChannel *&vdecChannel)
 {
-    auto vdecConfig = GetVdecConfig();
-    vdecConfig.inFormat = format;
-    vdecDvppCommon_.reset(new DvppCommon(vdecConfig));
-    if (vdecDvppCommon_ == nullptr) {
-        LogError << "create vdecDvppCommon_ Failed";
+    std::unique_ptr<VdecChannel> newChannel(new VdecChannel());
+    newChannel->channelId = data.channelId;
+    newChannel->frameId = 0;
+    newChannel->sequenceId = 0;
+    newChannel->streamWidth = data.srcWidth;
+    newChannel->streamHeight = data.srcHeight;
+
+    auto vdecConfig = GetVdecConfig(*newChannel);
+    vdecConfig.inFormat = data.videoFormat;
+    newChannel->vdecDvppCommon.reset(new DvppCommon(vdecConfig));
+    if (newChannel->vdecDvppCommon == nullptr) {
+        LogError << "create vdecDvppCommon Failed";
         return APP_ERR_COMM_ALLOC_MEM;
     }
 
-    APP_ERROR ret = vdecDvppCommon_->InitVdec();
+    APP_ERROR ret = newChannel->vdecDvppCommon->InitVdec();
     if (ret != APP_ERR_OK) {
-        LogError << "vdecDvppCommon_ InitVdec Failed";
+        LogError << "vdecDvppCommon InitVdec Failed";
         return ret;
     }
+    vdecChannel = newChannel.get();
+    vdecChannels_[data.channelId] = std::move(newChannel);
+    LogDebug << "VideoDecoder [" << instanceId_ << "] decodes channel " << data.channelId;
     return ret;
 }
 
-APP_ERROR VideoDecoder::Process(std::shared_ptr<void> commonData)
+APP_ERROR VideoDecoder::ProcessMessage(std::shared_ptr<CommonData> data)
 {
-    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(commonData);
-    if (vdecDvppCommon_ == nullptr) {
-        channelId_ = data->channelId;
-        streamWidth_ = data->srcWidth;
-        streamHeight_ = data->srcHeight;
-        APP_ERROR ret = CreateVdecDvppCommon(data->videoFormat);
+    if (modelInferOutput_ == nullptr) {
+        // BatchAggregator, when the pipeline has one, batches the frames for ModelInfer
+        modelInferOutput_ = GetOutputHandle(MT_BatchAggregator);
+        if (modelInferOutput_ == nullptr) {
+            modelInferOutput_ = GetOutputHandle(MT_ModelInfer);
+        }
+    }
+    VdecChannel *vdecChannel = nullptr;
+    auto iter = vdecChannels_.find(data->channelId);
+    if (iter != vdecChannels_.end()) {
+        vdecChannel = iter->second.get();
+    } else if (data->eof) {
+        // the stream ended before its first packet, there is no vdec to flush, only the end to pass on
+        LogWarn << "VideoDecoder [" << instanceId_ << "] gets the end of channel " << data->channelId
+                << " without any packet of it";
+        data->sequenceId = 0;
+        SendToNextModule(modelInferOutput_, data, data->channelId);
+        return APP_ERR_OK;
+    } else {
+        APP_ERROR ret = CreateVdecChannel(*data, vdecChannel);
         if (ret != APP_ERR_OK) {
-            LogError << "CreateVdecDvppCommon Failed";
+            LogError << "CreateVdecChannel Failed";
             return ret;
         }
     }
 
     if (data->eof) {
-        APP_ERROR ret = vdecDvppCommon_->VdecSendEosFrame();
+        APP_ERROR ret = vdecChannel->vdecDvppCommon->VdecSendEosFrame();
         if (ret != APP_ERR_OK) {
             LogError << "Failed to send eos frame, ret = " << ret;
             return ret;
         }
-        SendToNextModule(MT_ModelInfer, data, data->channelId);
+        // the eos is synchronous, the callbacks of all the frames have run
+        data->sequenceId = vdecChannel->sequenceId;
+        SendToNextModule(modelInferOutput_, data, data->channelId);
         return APP_ERR_OK;
     }
     std::shared_ptr<DvppDataInfo> vdecData = std::make_shared<DvppDataInfo>();
     vdecData->dataSize = data->streamData.size;
     vdecData->data = static_cast<uint8_t*>(data->streamData.data.get());
 
-    APP_ERROR ret = vdecDvppCommon_->CombineVdecProcess(vdecData, this);
+    VdecFrameContext *frameContext = new VdecFrameContext {this, vdecChannel, data->timestampUs, data->deadlineUs,
+        data->flowCredit};
+    APP_ERROR ret = vdecChannel->vdecDvppCommon->CombineVdecProcess(vdecData, frameContext);
     if (ret != APP_ERR_OK) {
+        delete frameContext;
         LogError << "Failed to do VdecProcess, ret = " << ret;
         return ret;
     }
@@ -250,14 +293,25 @@ APP_ERROR VideoDecoder::Process(std::shared_ptr<void> commonData)
     return APP_ERR_OK;
 }
 
+bool VideoDecoder::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return IsCommonDataDroppable(outputData);
+}
+
+// the resized image is released by ModelInfer after inference, so release it here when the frame is dropped
+void VideoDecoder::OnDropped(const std::shared_ptr<void> &outputData)
+{
+    ReleaseCommonDataDvpp(*std::static_pointer_cast<CommonData>(outputData));
+}
+
 APP_ERROR VideoDecoder::DeInit(void)
 {
     LogDebug << "VideoDecoder [" << instanceId_ << "] begin to deinit";
 
-    if (vdecDvppCommon_) {
-        APP_ERROR ret = vdecDvppCommon_->DeInit();
+    for (auto &vdecChannel : vdecChannels_) {
+        APP_ERROR ret = vdecChannel.second->vdecDvppCommon->DeInit();
         if (ret != APP_ERR_OK) {
-            LogError << "Failed to deinitialize vdecDvppCommon, ret = " << ret;
+            LogError << "Failed to deinitialize vdecDvppCommon of channel " << vdecChannel.first << ", ret = " << ret;
             return ret;
         }
     }
@@ -17,12 +17,13 @@
 #ifndef VIDEO_DECODER_H
 #define VIDEO_DECODER_H
 
+#include <map>
 #include "ModuleManager/ModuleManager.h"
 #include "ConfigParser/ConfigParser.h"
 #include "DvppCommon/DvppCommon.h"
 #include "DataType/DataType.h"
 
-class VideoDecoder : public ascendBaseModule::ModuleBase {
+class VideoDecoder : public ascendBaseModule::TypedModuleBase<CommonData> {
 public:
     VideoDecoder();
     ~VideoDecoder();
@@ -30,29 +31,49 @@ public:
     APP_ERROR DeInit(void);
 
 protected:
-    APP_ERROR Process(std::shared_ptr<void> inputData);
+    APP_ERROR ProcessMessage(std::shared_ptr<CommonData> data);
+    bool IsDroppable(const std::shared_ptr<void> &outputData);
+    void OnDropped(const std::shared_ptr<void> &outputData);
 
 private:
+    // one vdec channel per stream, an instance decodes the streams of all the channels routed to it
+    struct VdecChannel {
+        uint32_t channelId;
+        uint32_t frameId;
+        uint64_t sequenceId; // of the next frame sent, the frames skipped by skipInterval have none
+        uint32_t streamWidth;
+        uint32_t streamHeight;
+        std::unique_ptr<DvppCommon> vdecDvppCommon;
+    };
+
+    // sent to the vdec with each frame and deleted by the callback, to carry the frame information across
+    struct VdecFrameContext {
+        VideoDecoder *videoDecoder;
+        VdecChannel *vdecChannel;
+        uint64_t timestampUs;
+        uint64_t deadlineUs;
+        std::shared_ptr<void> flowCredit; // kept until the decoded frame is sent, or released if it is skipped
+    };
+
     APP_ERROR ParseConfig(ConfigParser &configParser);
-    VdecConfig GetVdecConfig() const;
+    VdecConfig GetVdecConfig(const VdecChannel &vdecChannel) const;
     static void *DecoderThread(void *arg);
     static void VideoDecoderCallBack(acldvppStreamDesc *input, acldvppPicDesc *output, void *userdata);
-    APP_ERROR CreateVdecDvppCommon(acldvppStreamFormat format);
+    APP_ERROR CreateVdecChannel(const CommonData &data, VdecChannel *&vdecChannel);
 
 private:
     bool stopDecoderThread_ = false;
-    uint32_t frameId_ = 0;
-    uint32_t channelId_ = 0;
-    uint32_t streamWidth_ = 0;
-    uint32_t streamHeight_ = 0;
+    std::map<uint32_t, std::unique_ptr<VdecChannel>> vdecChannels_ = {}; // channel id -> vdec channel
     uint32_t resizeWidth_ = 0;
     uint32_t resizeHeight_ = 0;
     uint32_t skipInterval_ = 1;
 
     aclrtStream vpcDvppStream_ = nullptr;
     std::unique_ptr<DvppCommon> vpcDvppCommon_ = nullptr;
-    std::unique_ptr<DvppCommon> vdecDvppCommon_ = nullptr;
     pthread_t decoderThreadId_ = -1;
+    // resolved by the first Process call, before any frame reaches the callback
+    ascendBaseModule::ModuleOutputHandle modelInferOutput_ = nullptr;
+    std::shared_ptr<ascendBaseModule::MessagePool<CommonData>> framePool_ = nullptr;
 };
 
 MODULE_REGIST(VideoDecoder)
@@ -19,6 +19,7 @@
 #include <csignal>
 #include <unistd.h>
 #include <atomic>
+#include <functional>
 #include "CommandLine.h"
 #include "Singleton.h"
 #include "ConfigParser/ConfigParser.h"
@@ -26,7 +27,9 @@
 #include "ModuleManager/ModuleManager.h"
 
 #include "StreamPuller/StreamPuller.h"
+#include "StreamReplayer/StreamReplayer.h"
 #include "VideoDecoder/VideoDecoder.h"
+#include "BatchAggregator/BatchAggregator.h"
 #include "ModelInfer/ModelInfer.h"
 #include "PostProcess/PostProcess.h"
 
@@ -49,6 +52,166 @@ ModuleConnectDesc g_connectDesc[MODULE_CONNECT_COUNT] = {
     {MT_ModelInfer, MT_PostProcess, MODULE_CONNECT_CHANNEL},
 };
 
+// with BatchAggregator.maxBatchSize, one BatchAggregator by default batches the decoded frames of all the channels
+const uint8_t BATCH_MODULE_TYPE_COUNT = 5;
+const int BATCH_MODULE_CONNECT_COUNT = 4;
+
+ModuleDesc g_batchModuleDesc[BATCH_MODULE_TYPE_COUNT] = {
+    {MT_StreamPuller, -1},
+    {MT_VideoDecoder, -1},
+    {MT_BatchAggregator, 1},
+    {MT_ModelInfer, -1},
+    {MT_PostProcess, -1},
+};
+
+ModuleConnectDesc g_batchConnectDesc[BATCH_MODULE_CONNECT_COUNT] = {
+    {MT_StreamPuller, MT_VideoDecoder, MODULE_CONNECT_CHANNEL},
+    {MT_VideoDecoder, MT_BatchAggregator, MODULE_CONNECT_CHANNEL},
+    {MT_BatchAggregator, MT_ModelInfer, MODULE_CONNECT_LEAST_LOADED},
+    {MT_ModelInfer, MT_PostProcess, MODULE_CONNECT_CHANNEL},
+};
+
+bool GetMessageInfo(const std::shared_ptr<void> &message, ModuleMessageInfo &info)
+{
+    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(message);
+    if (data->eof) {
+        return false;
+    }
+    info.channelId = data->channelId;
+    info.frameId = data->frameId;
+    info.sequenceId = data->sequenceId;
+    info.timestampUs = data->timestampUs;
+    info.deadlineUs = data->deadlineUs;
+    info.bytes = GetCommonDataBytes(*data);
+    return true;
+}
+
+// the fields of a packet sent by StreamPuller to VideoDecoder in another process or spilled to disk, the only connect
+// which can do either: the decoded frames and the inference outputs are in device memory
+struct PacketDescriptor {
+    bool eof;
+    uint32_t channelId;
+    uint64_t frameId;
+    uint64_t sequenceId;
+    uint64_t timestampUs;
+    uint64_t deadlineUs;
+    uint32_t srcWidth;
+    uint32_t srcHeight;
+    acldvppStreamFormat videoFormat;
+    uint32_t streamSize;
+    uint32_t streamRef; // buffer of the shm segment, the spilled packets are written after the descriptor
+};
+
+// the fields of the packet, without its stream
+PacketDescriptor ToDescriptor(const CommonData &data)
+{
+    PacketDescriptor desc = {data.eof, data.channelId, data.frameId, data.sequenceId, data.timestampUs,
+        data.deadlineUs, data.srcWidth, data.srcHeight, data.videoFormat, 0, SHM_INVALID_BUFFER};
+    return desc;
+}
+
+void FromDescriptor(const PacketDescriptor &desc, CommonData &data)
+{
+    data.eof = desc.eof;
+    data.channelId = desc.channelId;
+    data.frameId = desc.frameId;
+    data.sequenceId = desc.sequenceId;
+    data.timestampUs = desc.timestampUs;
+    data.deadlineUs = desc.deadlineUs;
+    data.srcWidth = desc.srcWidth;
+    data.srcHeight = desc.srcHeight;
+    data.videoFormat = desc.videoFormat;
+}
+
+// the packet is copied into a buffer of the segment unless StreamPuller allocated it there, the flow credit stays
+// in the StreamPuller process and is returned once the packet is sent
+bool EncodePacket(const std::shared_ptr<void> &message, ShmSegment &segment, uint8_t *descriptor,
+    uint32_t &descriptorSize)
+{
+    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(message);
+    if (descriptorSize < sizeof(PacketDescriptor) || !data->batchFrames.empty() || data->dvppData != nullptr) {
+        return false;
+    }
+    PacketDescriptor desc = ToDescriptor(*data);
+    if (data->streamData.data != nullptr) {
+        std::shared_ptr<uint8_t> stream = std::static_pointer_cast<uint8_t>(data->streamData.data);
+        desc.streamSize = static_cast<uint32_t>(data->streamData.size);
+        desc.streamRef = segment.ExportBuffer(stream);
+        if (desc.streamRef == SHM_INVALID_BUFFER) {
+            std::shared_ptr<uint8_t> buffer = segment.AllocBuffer(desc.streamSize);
+            if (buffer == nullptr) {
+                LogError << "Packet of " << desc.streamSize << " bytes of channel " << desc.channelId
+                         << " doesn't fit in a buffer of " << segment.GetName();
+                return false;
+            }
+            std::copy(stream.get(), stream.get() + desc.streamSize, buffer.get());
+            desc.streamRef = segment.ExportBuffer(buffer);
+        }
+    }
+    std::memcpy(descriptor, &desc, sizeof(desc));
+    descriptorSize = sizeof(desc);
+    return true;
+}
+
+std::shared_ptr<void> DecodePacket(const uint8_t *descriptor, uint32_t descriptorSize, ShmSegment &segment,
+    const std::shared_ptr<MessagePool<CommonData>> &packetPool)
+{
+    if (descriptorSize != sizeof(PacketDescriptor)) {
+        return nullptr;
+    }
+    PacketDescriptor desc;
+    std::memcpy(&desc, descriptor, sizeof(desc));
+    std::shared_ptr<CommonData> data = packetPool->Acquire();
+    FromDescriptor(desc, *data);
+    if (desc.streamRef != SHM_INVALID_BUFFER) {
+        data->streamData.data = segment.ImportBuffer(desc.streamRef);
+        data->streamData.size = desc.streamSize;
+    }
+    return data;
+}
+
+// a spilled packet is copied out of its buffer, which returns the flow credit: the spill queue and not StreamPuller
+// holds the burst then
+bool EncodeSpilledPacket(const std::shared_ptr<void> &message, std::vector<uint8_t> &bytes)
+{
+    std::shared_ptr<CommonData> data = std::static_pointer_cast<CommonData>(message);
+    if (!data->batchFrames.empty() || data->dvppData != nullptr) {
+        return false;
+    }
+    PacketDescriptor desc = ToDescriptor(*data);
+    if (data->streamData.data != nullptr) {
+        desc.streamSize = static_cast<uint32_t>(data->streamData.size);
+    }
+    bytes.resize(sizeof(desc) + desc.streamSize);
+    std::memcpy(bytes.data(), &desc, sizeof(desc));
+    if (desc.streamSize > 0) {
+        std::memcpy(bytes.data() + sizeof(desc), data->streamData.data.get(), desc.streamSize);
+    }
+    return true;
+}
+
+std::shared_ptr<void> DecodeSpilledPacket(const uint8_t *bytes, uint32_t size,
+    const std::shared_ptr<MessagePool<CommonData>> &packetPool)
+{
+    PacketDescriptor desc;
+    if (size < sizeof(desc)) {
+        return nullptr;
+    }
+    std::memcpy(&desc, bytes, sizeof(desc));
+    if (size != sizeof(desc) + desc.streamSize) {
+        return nullptr;
+    }
+    std::shared_ptr<CommonData> data = packetPool->Acquire();
+    FromDescriptor(desc, *data);
+    if (desc.streamSize > 0) {
+        std::shared_ptr<uint8_t> stream(new uint8_t[desc.streamSize], std::default_delete<uint8_t[]>());
+        std::memcpy(stream.get(), bytes + sizeof(desc), desc.streamSize);
+        data->streamData.data = stream;
+        data->streamData.size = desc.streamSize;
+    }
+    return data;
+}
+
 void SigHandler(int signo)
 {
     if (signo == SIGINT) {
@@ -56,7 +219,8 @@ void SigHandler(int signo)
     }
 }
 
-APP_ERROR InitModuleManager(ModuleManager &moduleManager, std::string &configPath, std::string &aclConfigPath)
+APP_ERROR InitModuleManager(ModuleManager &moduleManager, std::string &configPath, std::string &aclConfigPath,
+    const std::string &processName)
 {
     LogInfo << "InitModuleManager begin";
     ConfigParser configParser;
@@ -83,14 +247,55 @@ APP_ERROR InitModuleManager(ModuleManager &moduleManager, std::string &configPat
         return APP_ERR_COMM_FAILURE;
     }
 
-    Singleton::GetInstance().SetStreamPullerNum((g_moduleDesc[0].moduleCount == -1) ?
-        channelCount : g_moduleDesc[0].moduleCount);
-    ret = moduleManager.RegisterModules(PIPELINE_DEFAULT, g_moduleDesc, MODULE_TYPE_COUNT, channelCount);
+    uint32_t batchSize = 1;
+    itemCfgStr = MT_BatchAggregator + std::string(".maxBatchSize");
+    ret = configParser.GetUnsignedIntValue(itemCfgStr, batchSize);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "Invalid config variable named " << itemCfgStr << ", ret = " << ret;
+        return ret;
+    }
+    bool useBatch = (batchSize > 1);
+
+    // with SystemConfig.replayDir StreamReplayer sends the packets captured by StreamPuller instead of pulling them
+    std::string replayDir;
+    itemCfgStr = std::string("SystemConfig.replayDir");
+    ret = configParser.GetStringValue(itemCfgStr, replayDir);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogError << "Invalid config variable named " << itemCfgStr << ", ret = " << ret;
+        return ret;
+    }
+    const std::string &sourceModule = replayDir.empty() ? MT_StreamPuller : MT_StreamReplayer;
+    std::vector<ModuleDesc> moduleDesc(useBatch ? g_batchModuleDesc : g_moduleDesc,
+        useBatch ? g_batchModuleDesc + BATCH_MODULE_TYPE_COUNT : g_moduleDesc + MODULE_TYPE_COUNT);
+    std::vector<ModuleConnectDesc> connectDesc(useBatch ? g_batchConnectDesc : g_connectDesc,
+        useBatch ? g_batchConnectDesc + BATCH_MODULE_CONNECT_COUNT : g_connectDesc + MODULE_CONNECT_COUNT);
+    moduleDesc[0].moduleName = sourceModule;
+    connectDesc[0].moduleSend = sourceModule;
+
+    // <module>.instanceCount of the config file overrides channelCount
+    moduleManager.SetProcessName(processName);
+    ret = moduleManager.RegisterModules(PIPELINE_DEFAULT, moduleDesc.data(), static_cast<int>(moduleDesc.size()),
+        channelCount);
     if (ret != APP_ERR_OK) {
         return APP_ERR_COMM_FAILURE;
     }
+    Singleton::GetInstance().SetStreamPullerNum(moduleManager.GetModuleCount(PIPELINE_DEFAULT, sourceModule));
 
-    ret = moduleManager.RegisterModuleConnects(PIPELINE_DEFAULT, g_connectDesc, MODULE_CONNECT_COUNT);
+    moduleManager.SetMessageInfoGetter(GetMessageInfo);
+    // the decoded packets come from the pool of the frames StreamPuller and VideoDecoder use
+    std::shared_ptr<MessagePool<CommonData>> packetPool =
+        moduleManager.GetMessagePools(PIPELINE_DEFAULT)->GetPool<CommonData>(MESSAGE_POOL_MAX_FREE, ResetCommonData);
+    ShmMessageCodec shmCodec;
+    shmCodec.encode = EncodePacket;
+    shmCodec.decode = std::bind(DecodePacket, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+        packetPool);
+    moduleManager.SetShmMessageCodec(shmCodec);
+    SpillMessageCodec spillCodec;
+    spillCodec.encode = EncodeSpilledPacket;
+    spillCodec.decode = std::bind(DecodeSpilledPacket, std::placeholders::_1, std::placeholders::_2, packetPool);
+    moduleManager.SetSpillMessageCodec(spillCodec);
+    ret = moduleManager.RegisterModuleConnects(PIPELINE_DEFAULT, connectDesc.data(),
+        static_cast<int>(connectDesc.size()));
     if (ret != APP_ERR_OK) {
         LogError << "Fail to connect module, ret = " << ret;
         return APP_ERR_COMM_FAILURE;
@@ -125,7 +330,7 @@ int main(int argc, const char *argv[])
     SetLogLevel(cmdParams.debugLevel);
 
     ModuleManager moduleManager;
-    MainAssert(InitModuleManager(moduleManager, cmdParams.Config, cmdParams.aclConfig));
+    MainAssert(InitModuleManager(moduleManager, cmdParams.Config, cmdParams.aclConfig, cmdParams.processName));
     MainAssert(moduleManager.RunPipeline());
 
     LogInfo << "wait for exit signal";
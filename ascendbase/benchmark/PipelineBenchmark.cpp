@@ -0,0 +1,550 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "BlockingQueue/RingBlockingQueue.h"
+#include "CommandParser/CommandParser.h"
+#include "Log/Log.h"
+#include "ModuleManager/ModuleManager.h"
+
+using namespace ascendBaseModule;
+
+namespace {
+struct PipelineTopology {
+    std::string name;
+    ModuleConnectType stageConnect; // how the sources spread the frames over the stages
+    bool stagePerSource;            // one stage and one sink per source, else fanOut stages and one sink
+};
+
+const PipelineTopology PIPELINE_TOPOLOGIES[] = {
+    {"chain", MODULE_CONNECT_CHANNEL, true},
+    {"fan_out", MODULE_CONNECT_LEAST_LOADED, false},
+    {"broadcast", MODULE_CONNECT_BROADCAST, false},
+    // the stages get any channel, so the channel connect to the sinks has several producers per queue
+    {"regroup", MODULE_CONNECT_LEAST_LOADED, true},
+};
+const std::string QUEUE_TYPES[] = {"blocking", "ring", "auto", "fused", "shm", "spill"};
+const std::string QUEUE_TYPE_FUSED = "fused"; // only for the one to one connects of the chain
+const std::string QUEUE_TYPE_AUTO = "auto";   // spsc where each queue has one producer, checked by the sinks
+const std::string QUEUE_TYPE_SHM = "shm"; // in process, measures the encoding and the futex wakeups
+const std::string SHM_NAMES[] = {"/DefaultPipeline_BenchmarkSource_BenchmarkStage",
+    "/DefaultPipeline_BenchmarkStage_BenchmarkSink"};
+
+enum BenchmarkHop {
+    HOP_SOURCE_STAGE = 0,
+    HOP_STAGE_SINK,
+    HOP_END_TO_END,
+    HOP_COUNT
+};
+const char *HOP_NAMES[HOP_COUNT] = {"Source>Stage", "Stage>Sink", "end to end"};
+
+const int INTERVAL_LENGTH_NAME = 12;
+const int INTERVAL_LENGTH_DEFAULT = 12;
+const uint32_t WAIT_INTERVAL_MS = 1;
+const uint32_t SOURCE_STEP_FRAMES = 64; // frames sent by one step of an unpaced source
+const uint32_t MS_PER_SEC = 1000;
+const double NS_TO_US = 1000.0;
+const double PERCENT = 100.0;
+const std::string BENCHMARK_CONFIG_FILE = "./pipeline_benchmark.config";
+
+struct BenchmarkParams {
+    uint32_t frameCount = 0;   // frames sent by each source
+    uint32_t sourceFps = 0;    // frames sent by each source per second, 0 for as fast as possible
+    uint32_t costUs = 0;       // cpu time spent by a stage on each frame
+    uint32_t messageBytes = 0; // payload allocated and written by the source for each frame
+};
+
+struct BenchmarkMessage {
+    uint32_t channelId = 0;
+    uint64_t createNs = 0; // time the source created the frame
+    uint64_t sentNs = 0;   // time the previous module sent the frame
+    std::shared_ptr<uint8_t> payload = nullptr;
+};
+
+BenchmarkParams g_params;
+std::atomic<uint64_t> g_receivedCount(0);
+std::atomic<uint32_t> g_spscSinkCount(0); // sinks whose input queue is a spsc ring
+std::mutex g_latencyMutex;
+std::vector<uint64_t> g_latencyNs[HOP_COUNT];
+
+uint64_t GetTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the cost of the processing a real stage does, a DVPP call or an inference for example
+void SpendCpu(uint32_t costUs)
+{
+    if (costUs == 0) {
+        return;
+    }
+    uint64_t endNs = GetTimeNs() + costUs * static_cast<uint64_t>(NS_TO_US);
+    while (GetTimeNs() < endNs) {
+    }
+}
+
+// the modules keep their samples, processed by one thread at a time, and hand them over when deinited
+void SaveLatency(BenchmarkHop hop, std::vector<uint64_t> &latencyNs)
+{
+    std::unique_lock<std::mutex> lock(g_latencyMutex);
+    g_latencyNs[hop].insert(g_latencyNs[hop].end(), latencyNs.begin(), latencyNs.end());
+    latencyNs.clear();
+}
+
+double GetCpuTimeSec()
+{
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+}
+
+// runs in steps, on the event loop with -event_loop_threads, so that many paced sources share a few threads
+struct BenchmarkDescriptor {
+    uint64_t createNs;
+    uint64_t sentNs;
+    uint32_t payloadRef;
+};
+
+// the payload is copied into a buffer of the segment unless it is already in one
+bool EncodeMessage(const std::shared_ptr<void> &message, ShmSegment &segment, uint8_t *descriptor,
+    uint32_t &descriptorSize)
+{
+    if (descriptorSize < sizeof(BenchmarkDescriptor)) {
+        return false;
+    }
+    std::shared_ptr<BenchmarkMessage> benchmarkMessage = std::static_pointer_cast<BenchmarkMessage>(message);
+    BenchmarkDescriptor desc = {benchmarkMessage->createNs, benchmarkMessage->sentNs, SHM_INVALID_BUFFER};
+    if (benchmarkMessage->payload != nullptr) {
+        desc.payloadRef = segment.ExportBuffer(benchmarkMessage->payload);
+        if (desc.payloadRef == SHM_INVALID_BUFFER) {
+            std::shared_ptr<uint8_t> buffer = segment.AllocBuffer(g_params.messageBytes);
+            if (buffer == nullptr) {
+                return false;
+            }
+            std::copy(benchmarkMessage->payload.get(), benchmarkMessage->payload.get() + g_params.messageBytes,
+                buffer.get());
+            desc.payloadRef = segment.ExportBuffer(buffer);
+        }
+    }
+    std::memcpy(descriptor, &desc, sizeof(desc));
+    descriptorSize = sizeof(desc);
+    return true;
+}
+
+std::shared_ptr<void> DecodeMessage(const uint8_t *descriptor, uint32_t descriptorSize, ShmSegment &segment)
+{
+    if (descriptorSize != sizeof(BenchmarkDescriptor)) {
+        return nullptr;
+    }
+    BenchmarkDescriptor desc;
+    std::memcpy(&desc, descriptor, sizeof(desc));
+    std::shared_ptr<BenchmarkMessage> message = std::make_shared<BenchmarkMessage>();
+    message->createNs = desc.createNs;
+    message->sentNs = desc.sentNs;
+    if (desc.payloadRef != SHM_INVALID_BUFFER) {
+        message->payload = segment.ImportBuffer(desc.payloadRef);
+    }
+    return message;
+}
+
+// the spilled messages carry their payload after the record
+struct SpilledRecord {
+    uint64_t createNs;
+    uint64_t sentNs;
+    uint32_t payloadBytes;
+};
+
+bool EncodeSpilledMessage(const std::shared_ptr<void> &message, std::vector<uint8_t> &bytes)
+{
+    std::shared_ptr<BenchmarkMessage> benchmarkMessage = std::static_pointer_cast<BenchmarkMessage>(message);
+    uint32_t payloadBytes = (benchmarkMessage->payload == nullptr) ? 0 : g_params.messageBytes;
+    SpilledRecord record = {benchmarkMessage->createNs, benchmarkMessage->sentNs, payloadBytes};
+    bytes.resize(sizeof(record) + payloadBytes);
+    std::memcpy(bytes.data(), &record, sizeof(record));
+    if (payloadBytes != 0) {
+        std::memcpy(bytes.data() + sizeof(record), benchmarkMessage->payload.get(), payloadBytes);
+    }
+    return true;
+}
+
+std::shared_ptr<void> DecodeSpilledMessage(const uint8_t *bytes, uint32_t size)
+{
+    SpilledRecord record;
+    if (size < sizeof(record)) {
+        return nullptr;
+    }
+    std::memcpy(&record, bytes, sizeof(record));
+    if (size != sizeof(record) + record.payloadBytes) {
+        return nullptr;
+    }
+    std::shared_ptr<BenchmarkMessage> message = std::make_shared<BenchmarkMessage>();
+    message->createNs = record.createNs;
+    message->sentNs = record.sentNs;
+    if (record.payloadBytes != 0) {
+        message->payload.reset(new uint8_t[record.payloadBytes], std::default_delete<uint8_t[]>());
+        std::memcpy(message->payload.get(), bytes + sizeof(record), record.payloadBytes);
+    }
+    return message;
+}
+
+class BenchmarkSource : public ModuleBase {
+public:
+    APP_ERROR Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
+    {
+        AssignInitArgs(initArgs);
+        withoutInputQueue_ = true;
+        runInSteps_ = true;
+        isSingleSendThread_ = true;
+        isChannelPerInstance_ = true;
+        messagePool_ = GetMessagePool<BenchmarkMessage>();
+        sentCount_ = 0;
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR DeInit(void)
+    {
+        return APP_ERR_OK;
+    }
+
+protected:
+    APP_ERROR Process(std::shared_ptr<void> inputData)
+    {
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR ProcessStep(ModuleWaitInfo &waitInfo)
+    {
+        if (stageOutput_ == nullptr) {
+            stageOutput_ = GetOutputHandle("BenchmarkStage");
+        }
+        uint32_t stepFrames = (g_params.sourceFps == 0) ? SOURCE_STEP_FRAMES : 1;
+        for (uint32_t i = 0; i < stepFrames && sentCount_ < g_params.frameCount; i++, sentCount_++) {
+            std::shared_ptr<BenchmarkMessage> message = messagePool_->Acquire();
+            if (g_params.messageBytes != 0) {
+                message->payload.reset(new uint8_t[g_params.messageBytes], std::default_delete<uint8_t[]>());
+                std::fill(message->payload.get(), message->payload.get() + g_params.messageBytes, sentCount_);
+            }
+            message->channelId = static_cast<uint32_t>(instanceId_);
+            message->createNs = GetTimeNs();
+            message->sentNs = message->createNs;
+            SendToNextModule(stageOutput_, message, instanceId_);
+        }
+        if (sentCount_ >= g_params.frameCount) {
+            waitInfo.type = MODULE_WAIT_DONE;
+        } else if (g_params.sourceFps == 0) {
+            waitInfo.type = MODULE_WAIT_NONE;
+        } else {
+            waitInfo.type = MODULE_WAIT_TIMER;
+            waitInfo.timeoutMs = MS_PER_SEC / g_params.sourceFps;
+        }
+        return APP_ERR_OK;
+    }
+
+private:
+    std::shared_ptr<MessagePool<BenchmarkMessage>> messagePool_ = nullptr;
+    ModuleOutputHandle stageOutput_ = nullptr;
+    uint32_t sentCount_ = 0;
+};
+
+class BenchmarkStage : public ModuleBase {
+public:
+    APP_ERROR Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
+    {
+        AssignInitArgs(initArgs);
+        isSingleSendThread_ = true;
+        messagePool_ = GetMessagePool<BenchmarkMessage>();
+        latencyNs_.reserve(g_params.frameCount);
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR DeInit(void)
+    {
+        SaveLatency(HOP_SOURCE_STAGE, latencyNs_);
+        return APP_ERR_OK;
+    }
+
+protected:
+    APP_ERROR Process(std::shared_ptr<void> inputData)
+    {
+        if (sinkOutput_ == nullptr) {
+            sinkOutput_ = GetOutputHandle("BenchmarkSink");
+        }
+        std::shared_ptr<BenchmarkMessage> message = std::static_pointer_cast<BenchmarkMessage>(inputData);
+        latencyNs_.push_back(GetTimeNs() - message->sentNs);
+        SpendCpu(g_params.costUs);
+        // a broadcast frame is shared by all the stages, so each of them sends its own message
+        std::shared_ptr<BenchmarkMessage> output = messagePool_->Acquire();
+        output->channelId = message->channelId;
+        output->createNs = message->createNs;
+        output->payload = message->payload;
+        output->sentNs = GetTimeNs();
+        SendToNextModule(sinkOutput_, output, static_cast<int>(output->channelId));
+        return APP_ERR_OK;
+    }
+
+private:
+    std::shared_ptr<MessagePool<BenchmarkMessage>> messagePool_ = nullptr;
+    ModuleOutputHandle sinkOutput_ = nullptr;
+    std::vector<uint64_t> latencyNs_ = {};
+};
+
+class BenchmarkSink : public ModuleBase {
+public:
+    APP_ERROR Init(ConfigParser &configParser, ModuleInitArgs &initArgs)
+    {
+        AssignInitArgs(initArgs);
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR DeInit(void)
+    {
+        SaveLatency(HOP_STAGE_SINK, hopLatencyNs_);
+        SaveLatency(HOP_END_TO_END, endToEndNs_);
+        return APP_ERR_OK;
+    }
+
+protected:
+    APP_ERROR Process(std::shared_ptr<void> inputData)
+    {
+        if (!isQueueChecked_) {
+            isQueueChecked_ = true;
+            if (std::dynamic_pointer_cast<SpscBlockingQueue<std::shared_ptr<void>>>(inputQueue_) != nullptr) {
+                g_spscSinkCount++;
+            }
+        }
+        std::shared_ptr<BenchmarkMessage> message = std::static_pointer_cast<BenchmarkMessage>(inputData);
+        uint64_t nowNs = GetTimeNs();
+        hopLatencyNs_.push_back(nowNs - message->sentNs);
+        endToEndNs_.push_back(nowNs - message->createNs);
+        g_receivedCount++;
+        return APP_ERR_OK;
+    }
+
+private:
+    bool isQueueChecked_ = false;
+    std::vector<uint64_t> hopLatencyNs_ = {};
+    std::vector<uint64_t> endToEndNs_ = {};
+};
+
+MODULE_REGIST(BenchmarkSource)
+MODULE_REGIST(BenchmarkStage)
+MODULE_REGIST(BenchmarkSink)
+
+namespace {
+struct CaseResult {
+    bool isComplete = false;
+    bool isQueueTypeExpected = true;
+    double framesPerSec = 0;
+    double cpuPercent = 0; // cpu time of the process over the run time, 100 for one busy core
+    double percentileUs[HOP_COUNT][3] = {};
+};
+
+const double PERCENTILES[] = {0.5, 0.99, 0.999};
+
+void ComputePercentiles(CaseResult &result)
+{
+    for (int hop = 0; hop < HOP_COUNT; hop++) {
+        std::vector<uint64_t> &latencyNs = g_latencyNs[hop];
+        if (latencyNs.empty()) {
+            continue;
+        }
+        std::sort(latencyNs.begin(), latencyNs.end());
+        for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); i++) {
+            size_t index = std::min(latencyNs.size() - 1, static_cast<size_t>(PERCENTILES[i] * latencyNs.size()));
+            result.percentileUs[hop][i] = latencyNs[index] / NS_TO_US;
+        }
+        latencyNs.clear();
+    }
+}
+
+APP_ERROR RunCase(const PipelineTopology &topology, const std::string &queueType, CommandParser &option,
+    CaseResult &result)
+{
+    int sourceCount = option.GetIntOption("-sources");
+    int fanOut = option.GetIntOption("-fan_out");
+    {
+        std::ofstream configFile(BENCHMARK_CONFIG_FILE);
+        configFile << "SystemConfig.executorThreadNum = " << option.GetIntOption("-executor_threads") << std::endl;
+        configFile << "SystemConfig.eventLoopThreadNum = " << option.GetIntOption("-event_loop_threads") << std::endl;
+        configFile << "BenchmarkStage.queueType = " << queueType << std::endl;
+        configFile << "BenchmarkSink.queueType = " << queueType << std::endl;
+        configFile << "BenchmarkStage.queueSize = " << option.GetUint32Option("-queue_size") << std::endl;
+        configFile << "BenchmarkSink.queueSize = " << option.GetUint32Option("-queue_size") << std::endl;
+        configFile << "BenchmarkStage.shmBufferBytes = " << g_params.messageBytes << std::endl;
+        configFile << "BenchmarkSink.shmBufferBytes = " << g_params.messageBytes << std::endl;
+    }
+    // the segments of the previous case have another config
+    for (const auto &shmName : SHM_NAMES) {
+        ShmSegment::Unlink(shmName);
+    }
+    std::string configPath = BENCHMARK_CONFIG_FILE;
+    std::string aclConfigPath = "";
+    ModuleManager moduleManager;
+    APP_ERROR ret = moduleManager.Init(configPath, aclConfigPath);
+    std::remove(BENCHMARK_CONFIG_FILE.c_str());
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    ShmMessageCodec shmCodec;
+    shmCodec.encode = EncodeMessage;
+    shmCodec.decode = DecodeMessage;
+    moduleManager.SetShmMessageCodec(shmCodec);
+    SpillMessageCodec spillCodec;
+    spillCodec.encode = EncodeSpilledMessage;
+    spillCodec.decode = DecodeSpilledMessage;
+    moduleManager.SetSpillMessageCodec(spillCodec);
+
+    int stageCount = topology.stagePerSource ? sourceCount : fanOut;
+    int sinkCount = topology.stagePerSource ? sourceCount : 1;
+    ModuleDesc moduleDesc[] = {
+        {"BenchmarkSource", sourceCount},
+        {"BenchmarkStage", stageCount},
+        {"BenchmarkSink", sinkCount},
+    };
+    ModuleConnectType sinkConnect = topology.stagePerSource ? MODULE_CONNECT_CHANNEL : MODULE_CONNECT_ONE;
+    ModuleConnectDesc connectDesc[] = {
+        {"BenchmarkSource", "BenchmarkStage", topology.stageConnect},
+        {"BenchmarkStage", "BenchmarkSink", sinkConnect},
+    };
+    const int moduleTypeCount = sizeof(moduleDesc) / sizeof(moduleDesc[0]);
+    const int moduleConnectCount = sizeof(connectDesc) / sizeof(connectDesc[0]);
+    ret = moduleManager.RegisterModules(PIPELINE_DEFAULT, moduleDesc, moduleTypeCount, sourceCount);
+    if (ret == APP_ERR_OK) {
+        ret = moduleManager.RegisterModuleConnects(PIPELINE_DEFAULT, connectDesc, moduleConnectCount);
+    }
+    if (ret != APP_ERR_OK) {
+        moduleManager.DeInit();
+        return ret;
+    }
+
+    uint64_t copyCount = (topology.stageConnect == MODULE_CONNECT_BROADCAST) ? fanOut : 1;
+    uint64_t expectedCount = static_cast<uint64_t>(g_params.frameCount) * sourceCount * copyCount;
+    g_receivedCount = 0;
+    g_spscSinkCount = 0;
+    double startCpuSec = GetCpuTimeSec();
+    auto startTime = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::seconds(option.GetUint32Option("-timeout_s"));
+    ret = moduleManager.RunPipeline();
+    while (ret == APP_ERR_OK && g_receivedCount < expectedCount &&
+        std::chrono::steady_clock::now() - startTime < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_INTERVAL_MS));
+    }
+    double costSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double cpuSec = GetCpuTimeSec() - startCpuSec;
+    result.isComplete = (g_receivedCount == expectedCount);
+    // auto takes spsc for the sinks of the chain only, the stages of regroup all send to every sink
+    if (queueType == QUEUE_TYPE_AUTO && topology.stagePerSource) {
+        bool isChain = (topology.stageConnect == MODULE_CONNECT_CHANNEL);
+        result.isQueueTypeExpected = (g_spscSinkCount == (isChain ? static_cast<uint32_t>(sinkCount) : 0));
+    }
+    result.framesPerSec = g_receivedCount / costSec;
+    result.cpuPercent = cpuSec / costSec * PERCENT;
+
+    moduleManager.DeInit();
+    for (const auto &shmName : SHM_NAMES) {
+        ShmSegment::Unlink(shmName);
+    }
+    ComputePercentiles(result);
+    return ret;
+}
+
+void PrintResult(const PipelineTopology &topology, const std::string &queueType, const CaseResult &result)
+{
+    for (int hop = 0; hop < HOP_COUNT; hop++) {
+        if (hop == 0) {
+            std::cout << std::setw(INTERVAL_LENGTH_NAME) << topology.name << std::setw(INTERVAL_LENGTH_NAME)
+                      << queueType << std::setw(INTERVAL_LENGTH_DEFAULT) << static_cast<uint64_t>(result.framesPerSec)
+                      << std::setw(INTERVAL_LENGTH_DEFAULT) << static_cast<int>(result.cpuPercent);
+        } else {
+            std::cout << std::setw(INTERVAL_LENGTH_NAME * 2 + INTERVAL_LENGTH_DEFAULT * 2) << "";
+        }
+        std::cout << std::setw(INTERVAL_LENGTH_DEFAULT + 2) << HOP_NAMES[hop];
+        for (auto percentileUs : result.percentileUs[hop]) {
+            std::cout << std::setw(INTERVAL_LENGTH_DEFAULT) << percentileUs;
+        }
+        if (hop == 0 && !result.isComplete) {
+            std::cout << "timeout, frames lost";
+        }
+        if (hop == 0 && !result.isQueueTypeExpected) {
+            std::cout << "unexpected queue type of the sinks";
+        }
+        std::cout << std::endl;
+    }
+}
+}
+
+int main(int argc, const char *argv[])
+{
+    CommandParser option;
+    option.AddOption("-frames", "20000", "number of frames sent by each source");
+    option.AddOption("-sources", "4", "number of source instances, the channels");
+    option.AddOption("-fan_out", "4", "number of stage instances of the fan_out and broadcast topologies");
+    option.AddOption("-cost_us", "0", "cpu time in microseconds a stage spends on each frame");
+    option.AddOption("-message_bytes", "0", "payload in bytes allocated and written for each frame");
+    option.AddOption("-queue_size", "200", "capacity of the input queues");
+    option.AddOption("-executor_threads", "0", "SystemConfig.executorThreadNum, 0 for a thread per instance");
+    option.AddOption("-event_loop_threads", "0", "SystemConfig.eventLoopThreadNum, 0 for a thread per source");
+    option.AddOption("-source_fps", "0", "frames sent by each source per second, 0 for as fast as possible");
+    option.AddOption("-timeout_s", "60", "max run time of a case in seconds");
+    option.ParseArgs(argc, argv);
+    g_params.frameCount = option.GetUint32Option("-frames");
+    g_params.sourceFps = option.GetUint32Option("-source_fps");
+    g_params.costUs = option.GetUint32Option("-cost_us");
+    g_params.messageBytes = option.GetUint32Option("-message_bytes");
+    AtlasAscendLog::Log::LogErrorOn();
+
+    std::cout.setf(std::ios::left);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(INTERVAL_LENGTH_NAME) << "topology" << std::setw(INTERVAL_LENGTH_NAME) << "queue"
+              << std::setw(INTERVAL_LENGTH_DEFAULT) << "frames/s" << std::setw(INTERVAL_LENGTH_DEFAULT) << "cpu(%)"
+              << std::setw(INTERVAL_LENGTH_DEFAULT + 2) << "hop" << std::setw(INTERVAL_LENGTH_DEFAULT) << "p50(us)"
+              << std::setw(INTERVAL_LENGTH_DEFAULT) << "p99(us)" << std::setw(INTERVAL_LENGTH_DEFAULT) << "p99.9(us)"
+              << std::endl;
+    int failCount = 0;
+    for (const auto &topology : PIPELINE_TOPOLOGIES) {
+        for (const auto &queueType : QUEUE_TYPES) {
+            if (queueType == QUEUE_TYPE_FUSED && topology.stageConnect != MODULE_CONNECT_CHANNEL) {
+                continue;
+            }
+            CaseResult result;
+            APP_ERROR ret = RunCase(topology, queueType, option, result);
+            if (ret != APP_ERR_OK) {
+                std::cout << std::setw(INTERVAL_LENGTH_NAME) << topology.name << std::setw(INTERVAL_LENGTH_NAME)
+                          << queueType << "fail to run the pipeline, ret=" << ret << std::endl;
+                failCount++;
+                continue;
+            }
+            PrintResult(topology, queueType, result);
+            failCount += (result.isComplete && result.isQueueTypeExpected) ? 0 : 1;
+        }
+    }
+    return (failCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CommandParser/CommandParser.h"
+#include "BlockingQueue/BlockingQueue.h"
+#include "BlockingQueue/RingBlockingQueue.h"
+
+namespace {
+using FrameQueue = ItemQueue<std::shared_ptr<void>>;
+
+struct BenchmarkCase {
+    int producerNum;
+    int consumerNum;
+};
+
+const BenchmarkCase BENCHMARK_CASES[] = {
+    {1, 1},
+    {4, 1},
+    {8, 1},
+    {4, 4},
+    {8, 8},
+};
+const int INTERVAL_LENGTH_NAME = 12;
+const int INTERVAL_LENGTH_DEFAULT = 15;
+
+// Every producer pushes itemCount frames, then one nullptr per consumer is pushed as end mark.
+// Returns the throughput in million items per second.
+double RunCase(std::shared_ptr<FrameQueue> queue, const BenchmarkCase &benchCase, uint32_t itemCount)
+{
+    std::shared_ptr<void> frame = std::make_shared<int>(0);
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < benchCase.consumerNum; i++) {
+        consumers.emplace_back([queue]() {
+            std::shared_ptr<void> item = nullptr;
+            while (queue->Pop(item) == APP_ERR_OK && item != nullptr) {
+            }
+        });
+    }
+    for (int i = 0; i < benchCase.producerNum; i++) {
+        producers.emplace_back([queue, frame, itemCount]() {
+            for (uint32_t j = 0; j < itemCount; j++) {
+                queue->Push(frame, true);
+            }
+        });
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    for (int i = 0; i < benchCase.consumerNum; i++) {
+        queue->Push(nullptr, true);
+    }
+    for (auto &t : consumers) {
+        t.join();
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    double costSec = std::chrono::duration<double>(endTime - startTime).count();
+    return static_cast<double>(itemCount) * benchCase.producerNum / costSec / 1e6;
+}
+}
+
+int main(int argc, const char *argv[])
+{
+    CommandParser option;
+    option.AddOption("-items", "1000000", "number of items pushed by each producer");
+    option.AddOption("-queue_size", "200", "capacity of the queue");
+    option.AddOption("-spin_us", "0", "max spin time of the queues before parking, 0 to park at once");
+    option.ParseArgs(argc, argv);
+    uint32_t itemCount = option.GetUint32Option("-items");
+    uint32_t queueSize = option.GetUint32Option("-queue_size");
+    QueueWaitStrategy waitStrategy;
+    waitStrategy.maxSpinUs = option.GetUint32Option("-spin_us");
+    waitStrategy.mode = (waitStrategy.maxSpinUs == 0) ? QUEUE_WAIT_PARK : QUEUE_WAIT_ADAPTIVE_SPIN;
+
+    std::cout.setf(std::ios::left);
+    std::cout << std::setw(INTERVAL_LENGTH_NAME) << "producers" << std::setw(INTERVAL_LENGTH_NAME) << "consumers"
+              << std::setw(INTERVAL_LENGTH_DEFAULT) << "list(Mops/s)" << std::setw(INTERVAL_LENGTH_DEFAULT)
+              << "ring(Mops/s)" << std::setw(INTERVAL_LENGTH_DEFAULT) << "spsc(Mops/s)" << std::endl;
+    for (const auto &benchCase : BENCHMARK_CASES) {
+        auto listQueue = std::make_shared<BlockingQueue<std::shared_ptr<void>>>(queueSize);
+        listQueue->SetWaitStrategy(waitStrategy);
+        double listOps = RunCase(listQueue, benchCase, itemCount);
+        auto ringQueue = std::make_shared<RingBlockingQueue<std::shared_ptr<void>>>(queueSize);
+        ringQueue->SetWaitStrategy(waitStrategy);
+        double ringOps = RunCase(ringQueue, benchCase, itemCount);
+        std::cout << std::setw(INTERVAL_LENGTH_NAME) << benchCase.producerNum << std::setw(INTERVAL_LENGTH_NAME)
+                  << benchCase.consumerNum << std::setw(INTERVAL_LENGTH_DEFAULT) << listOps
+                  << std::setw(INTERVAL_LENGTH_DEFAULT) << ringOps;
+        // the spsc queue only supports one producer and one consumer
+        if (benchCase.producerNum == 1 && benchCase.consumerNum == 1) {
+            auto spscQueue = std::make_shared<SpscBlockingQueue<std::shared_ptr<void>>>(queueSize);
+            spscQueue->SetWaitStrategy(waitStrategy);
+            double spscOps = RunCase(spscQueue, benchCase, itemCount);
+            std::cout << std::setw(INTERVAL_LENGTH_DEFAULT) << spscOps;
+        } else {
+            std::cout << std::setw(INTERVAL_LENGTH_DEFAULT) << "-";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
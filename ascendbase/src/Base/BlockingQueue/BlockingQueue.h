@@ -17,15 +17,24 @@
 #define BLOCKING_QUEUE_H
 
 #include "ErrorCode/ErrorCode.h"
+#include "BlockingQueue/ItemQueue.h"
+#include "BlockingQueue/QueueMemoryBudget.h"
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <stdint.h>
+#include <vector>
 
 static const int DEFAULT_MAX_QUEUE_SIZE = 256;
 
-template<typename T> class BlockingQueue {
+template<typename T> class BlockingQueue : public ItemQueue<T> {
 public:
+    using ItemSizeGetter = typename ItemQueue<T>::ItemSizeGetter;
+
     BlockingQueue(uint32_t maxSize = DEFAULT_MAX_QUEUE_SIZE) : max_size_(maxSize), is_stoped_(false) {}
 
     ~BlockingQueue() {}
@@ -34,9 +43,7 @@ public:
     {
         std::unique_lock<std::mutex> lock(mutex_);
 
-        while (queue_.empty() && !is_stoped_) {
-            empty_cond_.wait(lock);
-        }
+        WaitNotEmpty(lock);
 
         if (is_stoped_) {
             return APP_ERR_QUEUE_STOPED;
@@ -47,6 +54,8 @@ public:
         } else {
             item = queue_.front();
             queue_.pop_front();
+            this->statistic_.AddPop(1);
+            ReleaseBytes(GetItemBytes(item));
         }
 
         full_cond_.notify_one();
@@ -59,10 +68,15 @@ public:
         std::unique_lock<std::mutex> lock(mutex_);
         auto realTime = std::chrono::milliseconds(timeOutMs);
 
-        while (queue_.empty() && !is_stoped_) {
-            empty_cond_.wait_for(lock, realTime);
+        if (queue_.empty() && !is_stoped_) {
+            auto waitStart = QueueStatistic::Now();
+            SpinNotEmpty(lock);
+            while (queue_.empty() && !is_stoped_) {
+                empty_cond_.wait_for(lock, realTime);
+            }
+            this->statistic_.AddConsumerWait(waitStart);
         }
-        
+
         if (is_stoped_) {
             return APP_ERR_QUEUE_STOPED;
         }
@@ -72,6 +86,8 @@ public:
         } else {
             item = queue_.front();
             queue_.pop_front();
+            this->statistic_.AddPop(1);
+            ReleaseBytes(GetItemBytes(item));
         }
 
         full_cond_.notify_one();
@@ -79,22 +95,136 @@ public:
         return APP_ERR_OK;
     }
 
+    // wait until the queue is not empty, then take out at most maxItems items with one lock
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        WaitNotEmpty(lock);
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        return TakeItems(items, maxItems);
+    }
+
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems, unsigned int timeOutMs)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto realTime = std::chrono::milliseconds(timeOutMs);
+
+        if (queue_.empty() && !is_stoped_) {
+            auto waitStart = QueueStatistic::Now();
+            SpinNotEmpty(lock);
+            empty_cond_.wait_for(lock, realTime, [this]() { return !queue_.empty() || is_stoped_; });
+            this->statistic_.AddConsumerWait(waitStart);
+        }
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        return TakeItems(items, maxItems);
+    }
+
     APP_ERROR Push(const T& item, bool isWait = false)
     {
+        uint64_t itemBytes = GetItemBytes(item);
+        APP_ERROR ret = AcquireSharedBudget(itemBytes, isWait);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+
         std::unique_lock<std::mutex> lock(mutex_);
 
-        while (queue_.size() >= max_size_ && isWait && !is_stoped_) {
-            full_cond_.wait(lock);
+        if (isWait) {
+            WaitNotFull(lock, itemBytes);
         }
 
         if (is_stoped_) {
+            ReleaseSharedBudget(itemBytes);
             return APP_ERR_QUEUE_STOPED;
         }
 
-        if (queue_.size() >= max_size_) {
+        if (IsOverLimit(itemBytes)) {
+            ReleaseSharedBudget(itemBytes);
             return APP_ERROR_QUEUE_FULL;
         }
         queue_.push_back(item);
+        queued_bytes_ += itemBytes;
+        this->statistic_.AddPush(1, queue_.size());
+        OnItemPushed();
+
+        empty_cond_.notify_one();
+
+        return APP_ERR_OK;
+    }
+
+    // push the items in order, the items before the first one which can not be pushed stay in the queue
+    APP_ERROR PushBatch(const std::vector<T> &items, bool isWait = false)
+    {
+        // the shared budget is acquired without the lock of the queue, so one item at a time
+        if (size_getter_ != nullptr) {
+            for (const auto &item : items) {
+                APP_ERROR ret = Push(item, isWait);
+                if (ret != APP_ERR_OK) {
+                    return ret;
+                }
+            }
+            return APP_ERR_OK;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (const auto &item : items) {
+            if (queue_.size() >= max_size_ && isWait && !is_stoped_) {
+                empty_cond_.notify_all();
+                WaitNotFull(lock);
+            }
+
+            if (is_stoped_) {
+                return APP_ERR_QUEUE_STOPED;
+            }
+
+            if (queue_.size() >= max_size_) {
+                empty_cond_.notify_all();
+                return APP_ERROR_QUEUE_FULL;
+            }
+            queue_.push_back(item);
+            this->statistic_.AddPush(1, queue_.size());
+            OnItemPushed();
+        }
+
+        empty_cond_.notify_all();
+
+        return APP_ERR_OK;
+    }
+
+    // push the item without waiting, the oldest items are taken out first so that at most maxItems items
+    // (and no more than the capacity) are left in the queue, the items taken out are appended to evictedItems.
+    // In byte budgeted mode the oldest items are also taken out until the item fits in the byte budgets.
+    APP_ERROR PushEvictOldest(const T &item, uint32_t maxItems, std::vector<T> &evictedItems)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        uint64_t itemBytes = GetItemBytes(item);
+        size_t limit = std::max<size_t>(std::min(maxItems, max_size_), 1);
+        while (queue_.size() >= limit || (!queue_.empty() && IsOverLimit(itemBytes))) {
+            EvictFront(evictedItems);
+        }
+        // the budget can't be refused once this queue holds no bytes
+        while (AcquireSharedBudget(itemBytes, false) != APP_ERR_OK) {
+            EvictFront(evictedItems);
+        }
+        queue_.push_back(item);
+        queued_bytes_ += itemBytes;
+        this->statistic_.AddPush(1, queue_.size());
+        OnItemPushed();
 
         empty_cond_.notify_one();
 
@@ -103,27 +233,61 @@ public:
 
     APP_ERROR Push_Front(const T &item, bool isWait = false)
     {
+        uint64_t itemBytes = GetItemBytes(item);
+        APP_ERROR ret = AcquireSharedBudget(itemBytes, isWait);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+
         std::unique_lock<std::mutex> lock(mutex_);
 
-        while (queue_.size() >= max_size_ && isWait && !is_stoped_) {
-            full_cond_.wait(lock);
+        if (isWait) {
+            WaitNotFull(lock, itemBytes);
         }
 
         if (is_stoped_) {
+            ReleaseSharedBudget(itemBytes);
             return APP_ERR_QUEUE_STOPED;
         }
 
-        if (queue_.size() >= max_size_) {
+        if (IsOverLimit(itemBytes)) {
+            ReleaseSharedBudget(itemBytes);
             return APP_ERROR_QUEUE_FULL;
         }
 
         queue_.push_front(item);
+        queued_bytes_ += itemBytes;
+        this->statistic_.AddPush(1, queue_.size());
+        OnItemPushed();
 
         empty_cond_.notify_one();
 
         return APP_ERR_OK;
     }
 
+    // call before the queue is used, the consumers spin before waiting on the condition, the producers always
+    // wait on it at once
+    void SetWaitStrategy(const QueueWaitStrategy &waitStrategy)
+    {
+        consumer_spinner_.SetStrategy(waitStrategy);
+    }
+
+    // Byte budgeted mode, call before the queue is used. The producers wait until the item fits in maxBytes
+    // (0 for no limit on this queue) and in the shared budget (nullptr for none) as well as in the capacity in
+    // items. An item bigger than the budgets is still accepted by a queue which holds no bytes.
+    APP_ERROR SetByteBudget(ItemSizeGetter sizeGetter, uint64_t maxBytes,
+        std::shared_ptr<QueueMemoryBudget> sharedBudget)
+    {
+        if (sizeGetter == nullptr) {
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_getter_ = sizeGetter;
+        max_bytes_ = maxBytes;
+        shared_budget_ = sharedBudget;
+        return APP_ERR_OK;
+    }
+
     void Stop()
     {
         {
@@ -133,6 +297,9 @@ public:
 
         full_cond_.notify_all();
         empty_cond_.notify_all();
+        if (shared_budget_ != nullptr) {
+            shared_budget_->NotifyAll();
+        }
     }
 
     void Restart()
@@ -194,6 +361,131 @@ public:
     {
         std::unique_lock<std::mutex> lock(mutex_);
         queue_.clear();
+        ReleaseBytes(queued_bytes_);
+    }
+
+private:
+    // called with mutex_ locked
+    void WaitNotEmpty(std::unique_lock<std::mutex> &lock)
+    {
+        if (!queue_.empty() || is_stoped_) {
+            return;
+        }
+        auto waitStart = QueueStatistic::Now();
+        SpinNotEmpty(lock);
+        while (queue_.empty() && !is_stoped_) {
+            empty_cond_.wait(lock);
+        }
+        this->statistic_.AddConsumerWait(waitStart);
+    }
+
+    // called with mutex_ locked and the queue empty, spins with mutex_ unlocked so that the producers can push
+    void SpinNotEmpty(std::unique_lock<std::mutex> &lock)
+    {
+        if (!consumer_spinner_.IsEnabled()) {
+            return;
+        }
+        uint64_t pushCount = push_count_.load(std::memory_order_relaxed);
+        lock.unlock();
+        consumer_spinner_.Spin([this, pushCount]() {
+            return push_count_.load(std::memory_order_acquire) != pushCount || is_stoped_;
+        });
+        lock.lock();
+    }
+
+    // called with mutex_ locked after an item is pushed, only the spinning consumers need to know
+    void OnItemPushed()
+    {
+        if (consumer_spinner_.IsEnabled()) {
+            push_count_.fetch_add(1, std::memory_order_release);
+            consumer_spinner_.RecordArrival();
+        }
+    }
+
+    // called with mutex_ locked
+    void WaitNotFull(std::unique_lock<std::mutex> &lock, uint64_t itemBytes = 0)
+    {
+        if (!IsOverLimit(itemBytes) || is_stoped_) {
+            return;
+        }
+        auto waitStart = QueueStatistic::Now();
+        while (IsOverLimit(itemBytes) && !is_stoped_) {
+            full_cond_.wait(lock);
+        }
+        this->statistic_.AddProducerWait(waitStart);
+    }
+
+    // called with mutex_ locked, an empty queue accepts an item bigger than maxBytes
+    bool IsOverLimit(uint64_t itemBytes) const
+    {
+        return queue_.size() >= max_size_ ||
+            (max_bytes_ != 0 && queued_bytes_ != 0 && queued_bytes_ + itemBytes > max_bytes_);
+    }
+
+    uint64_t GetItemBytes(const T &item) const
+    {
+        return (size_getter_ == nullptr) ? 0 : size_getter_(item);
+    }
+
+    APP_ERROR AcquireSharedBudget(uint64_t itemBytes, bool isWait)
+    {
+        if (shared_budget_ == nullptr || itemBytes == 0) {
+            return APP_ERR_OK;
+        }
+        auto bypass = [this]() { return queued_bytes_ == 0 || is_stoped_; };
+        if (shared_budget_->Acquire(itemBytes, false, bypass)) {
+            return APP_ERR_OK;
+        }
+        if (!isWait) {
+            return APP_ERROR_QUEUE_FULL;
+        }
+        auto waitStart = QueueStatistic::Now();
+        shared_budget_->Acquire(itemBytes, true, bypass);
+        this->statistic_.AddProducerWait(waitStart);
+        return APP_ERR_OK;
+    }
+
+    void ReleaseSharedBudget(uint64_t itemBytes)
+    {
+        if (shared_budget_ != nullptr && itemBytes != 0) {
+            shared_budget_->Release(itemBytes);
+        }
+    }
+
+    // called with mutex_ locked, for the bytes of the items taken out of the queue
+    void ReleaseBytes(uint64_t itemBytes)
+    {
+        queued_bytes_ -= itemBytes;
+        ReleaseSharedBudget(itemBytes);
+    }
+
+    // called with mutex_ locked and queue_ not empty
+    void EvictFront(std::vector<T> &evictedItems)
+    {
+        evictedItems.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+        this->statistic_.AddPop(1);
+        ReleaseBytes(GetItemBytes(evictedItems.back()));
+    }
+
+    // called with mutex_ locked
+    APP_ERROR TakeItems(std::vector<T> &items, uint32_t maxItems)
+    {
+        items.clear();
+        if (queue_.empty()) {
+            return APP_ERR_QUEUE_EMPTY;
+        }
+
+        while (!queue_.empty() && items.size() < maxItems) {
+            items.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+            ReleaseBytes(GetItemBytes(items.back()));
+        }
+        this->statistic_.AddPop(items.size());
+
+        full_cond_.notify_all();
+
+        return APP_ERR_OK;
     }
 
 private:
@@ -202,7 +494,15 @@ private:
     std::condition_variable empty_cond_;
     std::condition_variable full_cond_;
     uint32_t max_size_;
-
-    bool is_stoped_;
+    ItemSizeGetter size_getter_ = nullptr;
+    uint64_t max_bytes_ = 0;
+    std::shared_ptr<QueueMemoryBudget> shared_budget_ = nullptr;
+    // read by the bypass check of the shared budget without mutex_
+    std::atomic<uint64_t> queued_bytes_ = {0};
+    // read by the spinning consumers without mutex_
+    std::atomic<uint64_t> push_count_ = {0};
+    QueueSpinner consumer_spinner_;
+
+    std::atomic<bool> is_stoped_;
 };
 #endif // __INC_BLOCKING_QUEUE_H__
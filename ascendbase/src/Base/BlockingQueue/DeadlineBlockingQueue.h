@@ -0,0 +1,273 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEADLINE_BLOCKING_QUEUE_H
+#define DEADLINE_BLOCKING_QUEUE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include "BlockingQueue/ItemQueue.h"
+
+// Earliest deadline first queue, the item with the smallest deadline is popped first and items with the same
+// deadline are popped in push order. Items without deadline (the getter returns 0) are popped after all the
+// items with one, in push order.
+template<typename T> class DeadlineBlockingQueue : public ItemQueue<T> {
+public:
+    using DeadlineGetter = std::function<uint64_t(const T &item)>;
+
+    DeadlineBlockingQueue(uint32_t maxSize, DeadlineGetter deadlineGetter)
+        : max_size_(maxSize), deadline_getter_(deadlineGetter)
+    {}
+
+    ~DeadlineBlockingQueue() {}
+
+    APP_ERROR Pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        WaitNotEmpty(lock);
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        item = TakeFront();
+        full_cond_.notify_one();
+
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR Pop(T &item, unsigned int timeOutMs)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto realTime = std::chrono::milliseconds(timeOutMs);
+
+        if (heap_.empty() && !is_stoped_) {
+            auto waitStart = QueueStatistic::Now();
+            empty_cond_.wait_for(lock, realTime, [this]() { return !heap_.empty() || is_stoped_; });
+            this->statistic_.AddConsumerWait(waitStart);
+        }
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        if (heap_.empty()) {
+            return APP_ERR_QUEUE_EMPTY;
+        }
+
+        item = TakeFront();
+        full_cond_.notify_one();
+
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        WaitNotEmpty(lock);
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        return TakeItems(items, maxItems);
+    }
+
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems, unsigned int timeOutMs)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto realTime = std::chrono::milliseconds(timeOutMs);
+
+        if (heap_.empty() && !is_stoped_) {
+            auto waitStart = QueueStatistic::Now();
+            empty_cond_.wait_for(lock, realTime, [this]() { return !heap_.empty() || is_stoped_; });
+            this->statistic_.AddConsumerWait(waitStart);
+        }
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        return TakeItems(items, maxItems);
+    }
+
+    APP_ERROR Push(const T &item, bool isWait = false)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (isWait && heap_.size() >= max_size_ && !is_stoped_) {
+            auto waitStart = QueueStatistic::Now();
+            while (heap_.size() >= max_size_ && !is_stoped_) {
+                full_cond_.wait(lock);
+            }
+            this->statistic_.AddProducerWait(waitStart);
+        }
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        if (heap_.size() >= max_size_) {
+            return APP_ERROR_QUEUE_FULL;
+        }
+        Insert(item);
+
+        empty_cond_.notify_one();
+
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR PushBatch(const std::vector<T> &items, bool isWait = false)
+    {
+        for (const auto &item : items) {
+            APP_ERROR ret = Push(item, isWait);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+        }
+        return APP_ERR_OK;
+    }
+
+    // the items evicted are the ones closest to their deadline, which are the most likely to miss it
+    APP_ERROR PushEvictOldest(const T &item, uint32_t maxItems, std::vector<T> &evictedItems)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (is_stoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+
+        size_t limit = std::max<size_t>(std::min(maxItems, max_size_), 1);
+        while (heap_.size() >= limit) {
+            evictedItems.push_back(TakeFront());
+        }
+        Insert(item);
+
+        empty_cond_.notify_one();
+
+        return APP_ERR_OK;
+    }
+
+    // the consumers wait on the condition at once
+    void SetWaitStrategy(const QueueWaitStrategy &waitStrategy) {}
+
+    void Stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            is_stoped_ = true;
+        }
+
+        full_cond_.notify_all();
+        empty_cond_.notify_all();
+    }
+
+    int GetSize()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return heap_.size();
+    }
+
+    APP_ERROR IsEmpty()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return heap_.empty();
+    }
+
+private:
+    // called with mutex_ locked
+    void WaitNotEmpty(std::unique_lock<std::mutex> &lock)
+    {
+        if (!heap_.empty() || is_stoped_) {
+            return;
+        }
+        auto waitStart = QueueStatistic::Now();
+        while (heap_.empty() && !is_stoped_) {
+            empty_cond_.wait(lock);
+        }
+        this->statistic_.AddConsumerWait(waitStart);
+    }
+
+    struct Entry {
+        uint64_t deadline;
+        uint64_t sequence;
+        T item;
+    };
+
+    // heap order, true if a is popped after b
+    static bool Later(const Entry &a, const Entry &b)
+    {
+        if (a.deadline != b.deadline) {
+            return a.deadline > b.deadline;
+        }
+        return a.sequence > b.sequence;
+    }
+
+    // called with mutex_ locked
+    void Insert(const T &item)
+    {
+        uint64_t deadline = deadline_getter_(item);
+        if (deadline == 0) {
+            deadline = std::numeric_limits<uint64_t>::max();
+        }
+        heap_.push_back(Entry {deadline, sequence_++, item});
+        std::push_heap(heap_.begin(), heap_.end(), Later);
+        this->statistic_.AddPush(1, heap_.size());
+    }
+
+    // called with mutex_ locked and heap_ not empty
+    T TakeFront()
+    {
+        std::pop_heap(heap_.begin(), heap_.end(), Later);
+        T item = std::move(heap_.back().item);
+        heap_.pop_back();
+        this->statistic_.AddPop(1);
+        return item;
+    }
+
+    // called with mutex_ locked
+    APP_ERROR TakeItems(std::vector<T> &items, uint32_t maxItems)
+    {
+        items.clear();
+        if (heap_.empty()) {
+            return APP_ERR_QUEUE_EMPTY;
+        }
+
+        while (!heap_.empty() && items.size() < maxItems) {
+            items.push_back(TakeFront());
+        }
+
+        full_cond_.notify_all();
+
+        return APP_ERR_OK;
+    }
+
+private:
+    std::vector<Entry> heap_;
+    uint64_t sequence_ = 0;
+    std::mutex mutex_;
+    std::condition_variable empty_cond_;
+    std::condition_variable full_cond_;
+    uint32_t max_size_;
+    DeadlineGetter deadline_getter_;
+    bool is_stoped_ = false;
+};
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ITEM_QUEUE_H
+#define ITEM_QUEUE_H
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+#include "BlockingQueue/QueueStatistic.h"
+#include "BlockingQueue/QueueWaitStrategy.h"
+
+// The operations the modules send and receive through, which every queue type implements: BlockingQueue (a list
+// under a mutex), the lock-free rings, the deadline, shm and spill queues. A queue type only offers the extra
+// operations it really supports on its own class, such as the byte budget of BlockingQueue and SpillBlockingQueue.
+template<typename T> class ItemQueue {
+public:
+    // memory held by an item, it must not change while the item is in the queue
+    using ItemSizeGetter = std::function<uint64_t(const T &item)>;
+
+    virtual ~ItemQueue() {}
+
+    virtual APP_ERROR Pop(T &item) = 0;
+    virtual APP_ERROR Pop(T &item, unsigned int timeOutMs) = 0;
+    // wait until the queue is not empty, then take out at most maxItems items
+    virtual APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems) = 0;
+    virtual APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems, unsigned int timeOutMs) = 0;
+    virtual APP_ERROR Push(const T &item, bool isWait = false) = 0;
+    // push the items in order, the items before the first one which can not be pushed stay in the queue
+    virtual APP_ERROR PushBatch(const std::vector<T> &items, bool isWait = false) = 0;
+    // push the item without waiting, the oldest items are taken out first so that at most maxItems items are left,
+    // the items taken out are appended to evictedItems. ModuleManager only gives the queues which can evict to the
+    // senders dropping the oldest items.
+    virtual APP_ERROR PushEvictOldest(const T &item, uint32_t maxItems, std::vector<T> &evictedItems) = 0;
+    // call before the queue is used, the queues which always park ignore it
+    virtual void SetWaitStrategy(const QueueWaitStrategy &waitStrategy) = 0;
+    virtual void Stop() = 0;
+    virtual int GetSize() = 0;
+    virtual APP_ERROR IsEmpty() = 0;
+
+    // number of items dropped by the overflow policy of the producers instead of being pushed
+    void AddDropCount(uint64_t count)
+    {
+        statistic_.AddDrop(count);
+    }
+
+    uint64_t GetDropCount() const
+    {
+        return statistic_.GetDropCount();
+    }
+
+    // can be called at any time, the counters are read one by one without stopping the queue
+    QueueStatisticInfo GetStatistic()
+    {
+        return statistic_.GetInfo(GetSize());
+    }
+
+protected:
+    QueueStatistic statistic_;
+};
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QUEUE_MEMORY_BUDGET_H
+#define QUEUE_MEMORY_BUDGET_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+
+// Memory budget shared by several byte budgeted queues, for example all the queues of a pipeline. A queue
+// acquires the bytes of an item when it is pushed and releases them when it is popped, so the budget bounds
+// the memory held by the queued items whichever queue they are in.
+class QueueMemoryBudget {
+public:
+    explicit QueueMemoryBudget(uint64_t maxBytes) : max_bytes_(maxBytes) {}
+
+    ~QueueMemoryBudget() {}
+
+    // Waits until the bytes fit in the budget, or bypass() returns true: the queues pass "I am empty" so that
+    // a module whose output queue is empty always progresses, otherwise the modules which hold the budget in
+    // their input queues and wait for it on their output queues would deadlock.
+    // Returns false without acquiring anything if isWait is false and the bytes don't fit.
+    bool Acquire(uint64_t bytes, bool isWait, const std::function<bool()> &bypass)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (used_bytes_ + bytes > max_bytes_ && !bypass()) {
+            if (!isWait) {
+                return false;
+            }
+            cond_.wait(lock);
+        }
+        used_bytes_ += bytes;
+        return true;
+    }
+
+    void Release(uint64_t bytes)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            used_bytes_ = (used_bytes_ > bytes) ? (used_bytes_ - bytes) : 0;
+        }
+        cond_.notify_all();
+    }
+
+    // wakes the waiting producers so that they check their bypass condition again, a stopped queue for example
+    void NotifyAll()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+        }
+        cond_.notify_all();
+    }
+
+    uint64_t GetUsedBytes()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return used_bytes_;
+    }
+
+    uint64_t GetMaxBytes() const
+    {
+        return max_bytes_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    uint64_t used_bytes_ = 0;
+    const uint64_t max_bytes_;
+};
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QUEUE_STATISTIC_H
+#define QUEUE_STATISTIC_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// wait time histograms, bucket 0 counts the waits shorter than 2 us, bucket i the waits of [2^i, 2^(i+1)) us,
+// the last bucket also counts all the longer waits
+static const size_t QUEUE_WAIT_BUCKET_COUNT = 32;
+
+struct QueueStatisticInformation {
+    uint64_t depth = 0;
+    uint64_t maxDepth = 0;
+    uint64_t pushCount = 0;
+    uint64_t popCount = 0;
+    uint64_t dropCount = 0;
+    uint64_t producerWaitUs = 0; // total time producers waited for a free place
+    uint64_t consumerWaitUs = 0; // total time consumers waited for an item
+    uint64_t producerWaitBuckets[QUEUE_WAIT_BUCKET_COUNT] = {};
+    uint64_t consumerWaitBuckets[QUEUE_WAIT_BUCKET_COUNT] = {};
+};
+
+using QueueStatisticInfo = QueueStatisticInformation;
+
+// Counters of a queue, updated with relaxed atomics so they can be read at any time without locking the queue.
+// The clock is only read by the threads which really wait.
+class QueueStatistic {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    static TimePoint Now()
+    {
+        return std::chrono::steady_clock::now();
+    }
+
+    void AddPush(uint64_t count, uint64_t depth)
+    {
+        pushCount_.fetch_add(count, std::memory_order_relaxed);
+        uint64_t maxDepth = maxDepth_.load(std::memory_order_relaxed);
+        while (depth > maxDepth && !maxDepth_.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    void AddPop(uint64_t count)
+    {
+        popCount_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void AddDrop(uint64_t count)
+    {
+        dropCount_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void AddProducerWait(const TimePoint &startTime)
+    {
+        AddWait(startTime, producerWaitUs_, producerWaitBuckets_);
+    }
+
+    void AddConsumerWait(const TimePoint &startTime)
+    {
+        AddWait(startTime, consumerWaitUs_, consumerWaitBuckets_);
+    }
+
+    uint64_t GetDropCount() const
+    {
+        return dropCount_.load(std::memory_order_relaxed);
+    }
+
+    QueueStatisticInfo GetInfo(uint64_t depth) const
+    {
+        QueueStatisticInfo info;
+        info.depth = depth;
+        info.maxDepth = maxDepth_.load(std::memory_order_relaxed);
+        info.pushCount = pushCount_.load(std::memory_order_relaxed);
+        info.popCount = popCount_.load(std::memory_order_relaxed);
+        info.dropCount = dropCount_.load(std::memory_order_relaxed);
+        info.producerWaitUs = producerWaitUs_.load(std::memory_order_relaxed);
+        info.consumerWaitUs = consumerWaitUs_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < QUEUE_WAIT_BUCKET_COUNT; i++) {
+            info.producerWaitBuckets[i] = producerWaitBuckets_[i].load(std::memory_order_relaxed);
+            info.consumerWaitBuckets[i] = consumerWaitBuckets_[i].load(std::memory_order_relaxed);
+        }
+        return info;
+    }
+
+private:
+    static void AddWait(const TimePoint &startTime, std::atomic<uint64_t> &totalUs,
+        std::atomic<uint64_t> (&buckets)[QUEUE_WAIT_BUCKET_COUNT])
+    {
+        uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(Now() - startTime).count();
+        totalUs.fetch_add(waitUs, std::memory_order_relaxed);
+        size_t bucket = 0;
+        while (waitUs > 1 && bucket < QUEUE_WAIT_BUCKET_COUNT - 1) {
+            waitUs >>= 1;
+            bucket++;
+        }
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> maxDepth_ = {0};
+    std::atomic<uint64_t> pushCount_ = {0};
+    std::atomic<uint64_t> popCount_ = {0};
+    std::atomic<uint64_t> dropCount_ = {0};
+    std::atomic<uint64_t> producerWaitUs_ = {0};
+    std::atomic<uint64_t> consumerWaitUs_ = {0};
+    std::atomic<uint64_t> producerWaitBuckets_[QUEUE_WAIT_BUCKET_COUNT] = {};
+    std::atomic<uint64_t> consumerWaitBuckets_[QUEUE_WAIT_BUCKET_COUNT] = {};
+};
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QUEUE_WAIT_STRATEGY_H
+#define QUEUE_WAIT_STRATEGY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+
+enum QueueWaitMode {
+    QUEUE_WAIT_PARK = 0,     // park the thread as soon as it has to wait
+    QUEUE_WAIT_ADAPTIVE_SPIN // spin, then yield, then park, the spin time follows the inter-arrival time
+};
+
+struct QueueWaitStrategy {
+    QueueWaitMode mode = QUEUE_WAIT_PARK;
+    uint32_t maxSpinUs = 50;    // upper bound of the spin time, sparser arrivals are parked right away
+    uint32_t maxYieldCount = 4; // number of sched_yield between spinning and parking
+};
+
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Event the threads park on: a waiter takes the epoch with PrepareWait, checks its condition again, then sleeps
+// in Wait until the epoch changes. Notify only locks and signals when a thread is between PrepareWait and the
+// end of Wait, so the producers and consumers which don't have to wait never make a system call.
+// The condition variable parks on a futex; waking the thread under the mutex lets the notifier go on pushing
+// while the woken thread gets the mutex back, instead of switching to it for every item.
+class QueueEvent {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    uint32_t PrepareWait()
+    {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    void CancelWait()
+    {
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // returns false if the deadline is reached before the epoch changes
+    bool Wait(uint32_t epoch, const TimePoint *deadline)
+    {
+        bool notified = true;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (epoch_.load(std::memory_order_relaxed) == epoch) {
+                if (deadline == nullptr) {
+                    cond_.wait(lock);
+                } else if (cond_.wait_until(lock, *deadline) == std::cv_status::timeout) {
+                    notified = (epoch_.load(std::memory_order_relaxed) != epoch);
+                    break;
+                }
+            }
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        return notified;
+    }
+
+    // the caller has published the change the waiters are waiting for before calling this
+    void Notify(bool notifyAll)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        epoch_.fetch_add(1, std::memory_order_relaxed);
+        notifyAll ? cond_.notify_all() : cond_.notify_one();
+    }
+
+private:
+    std::atomic<uint32_t> epoch_ = {0};
+    std::atomic<int> waiters_ = {0};
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+// Spinning part of QUEUE_WAIT_ADAPTIVE_SPIN. The other side calls RecordArrival each time it makes the waited
+// condition true (an item pushed for the consumer, a cell freed for the producer), and the average time between
+// these arrivals decides the spin time: twice the average while it is below maxSpinUs, no spinning at all when the
+// arrivals are sparser, as the thread would park anyway. With the default strategy it never spins.
+class QueueSpinner {
+public:
+    void SetStrategy(const QueueWaitStrategy &waitStrategy)
+    {
+        strategy_ = waitStrategy;
+        averageIntervalNs_.store(static_cast<uint64_t>(waitStrategy.maxSpinUs) * NS_PER_US / SPIN_FACTOR,
+            std::memory_order_relaxed);
+        lastArrivalNs_.store(0, std::memory_order_relaxed);
+    }
+
+    bool IsEnabled() const
+    {
+        return strategy_.mode == QUEUE_WAIT_ADAPTIVE_SPIN;
+    }
+
+    // returns true if ready() became true before the spin budget is exhausted
+    template<typename Ready> bool Spin(Ready ready) const
+    {
+        if (!IsEnabled()) {
+            return false;
+        }
+        uint64_t maxSpinNs = static_cast<uint64_t>(strategy_.maxSpinUs) * NS_PER_US;
+        uint64_t averageIntervalNs = averageIntervalNs_.load(std::memory_order_relaxed);
+        if (averageIntervalNs > maxSpinNs) {
+            return false;
+        }
+        // on a single cpu the other side can't make ready() true while this thread spins
+        static const bool isMultiCpu = std::thread::hardware_concurrency() > 1;
+        uint64_t budgetNs = isMultiCpu ? std::min(maxSpinNs, averageIntervalNs * SPIN_FACTOR) : 0;
+        auto spinStart = std::chrono::steady_clock::now();
+        for (uint32_t i = 1; budgetNs > 0; i++) {
+            if (ready()) {
+                return true;
+            }
+            CpuRelax();
+            if (i % CLOCK_CHECK_INTERVAL == 0 && static_cast<uint64_t>(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(std::chrono::steady_clock::now() - spinStart).count()) >= budgetNs) {
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < strategy_.maxYieldCount; i++) {
+            std::this_thread::yield();
+            if (ready()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // called by the other side, concurrent calls may lose a sample of the average, which only moves it less
+    void RecordArrival()
+    {
+        if (!IsEnabled()) {
+            return;
+        }
+        uint64_t nowNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        uint64_t lastNs = lastArrivalNs_.exchange(nowNs, std::memory_order_relaxed);
+        if (lastNs == 0 || nowNs <= lastNs) {
+            return;
+        }
+        uint64_t averageIntervalNs = averageIntervalNs_.load(std::memory_order_relaxed);
+        averageIntervalNs = averageIntervalNs - averageIntervalNs / AVERAGE_WEIGHT + (nowNs - lastNs) / AVERAGE_WEIGHT;
+        averageIntervalNs_.store(averageIntervalNs, std::memory_order_relaxed);
+    }
+
+private:
+    static const uint64_t NS_PER_US = 1000;
+    static const uint64_t SPIN_FACTOR = 2;
+    static const uint64_t AVERAGE_WEIGHT = 8;
+    static const uint32_t CLOCK_CHECK_INTERVAL = 64;
+    QueueWaitStrategy strategy_ = {};
+    std::atomic<uint64_t> averageIntervalNs_ = {0};
+    std::atomic<uint64_t> lastArrivalNs_ = {0};
+};
+#endif
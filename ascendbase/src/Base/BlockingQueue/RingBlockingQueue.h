@@ -0,0 +1,475 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RING_BLOCKING_QUEUE_H
+#define RING_BLOCKING_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "BlockingQueue/BlockingQueue.h"
+#include "BlockingQueue/ItemQueue.h"
+#include "BlockingQueue/QueueWaitStrategy.h"
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+// storage aligned on the cache line, std::allocator only aligns on alignof(std::max_align_t) before C++17
+template<typename U> struct CacheLineAllocator {
+    using value_type = U;
+
+    CacheLineAllocator() {}
+    template<typename V> CacheLineAllocator(const CacheLineAllocator<V> &) {}
+
+    U *allocate(size_t n)
+    {
+        void *p = nullptr;
+        if (posix_memalign(&p, CACHE_LINE_SIZE, n * sizeof(U)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<U *>(p);
+    }
+
+    void deallocate(U *p, size_t)
+    {
+        free(p);
+    }
+
+    template<typename V> bool operator==(const CacheLineAllocator<V> &) const
+    {
+        return true;
+    }
+
+    template<typename V> bool operator!=(const CacheLineAllocator<V> &) const
+    {
+        return false;
+    }
+};
+
+inline size_t RoundUpPowerOfTwo(uint32_t size)
+{
+    size_t capacity = 2;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Bounded multi-producer/multi-consumer ring, every cell carries a sequence number telling whether it is ready
+// to be written or to be read, so producers and consumers only contend on their own position counter.
+// The cells are rounded up to a power of two, but no more than size items are held at a time.
+template<typename T> class MpmcRing {
+public:
+    static const bool MULTI_CONSUMER = true;
+
+    explicit MpmcRing(uint32_t size)
+        : capacity_(RoundUpPowerOfTwo(size)), mask_(capacity_ - 1), limit_(std::max<uint32_t>(size, 1)),
+          cells_(capacity_)
+    {
+        for (size_t i = 0; i < capacity_; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    bool TryPush(const T &item)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0 && pos - dequeuePos_.load(std::memory_order_acquire) >= limit_) {
+                return false;
+            } else if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &item)
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->data = T(); // drop the reference held by the cell as soon as the item leaves the queue
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    bool HasReadyItem() const
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_seq_cst);
+        return cells_[pos & mask_].sequence.load(std::memory_order_seq_cst) == pos + 1;
+    }
+
+    bool HasFreeCell() const
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_seq_cst);
+        return cells_[pos & mask_].sequence.load(std::memory_order_seq_cst) == pos &&
+            pos - dequeuePos_.load(std::memory_order_seq_cst) < limit_;
+    }
+
+    size_t Size() const
+    {
+        size_t enqueuePos = enqueuePos_.load(std::memory_order_relaxed);
+        size_t dequeuePos = dequeuePos_.load(std::memory_order_relaxed);
+        return (enqueuePos > dequeuePos) ? (enqueuePos - dequeuePos) : 0;
+    }
+
+    size_t Capacity() const
+    {
+        return limit_;
+    }
+
+private:
+    // a cell per cache line, the producer writing a cell doesn't invalidate the line of the consumer reading the
+    // previous one
+    struct alignas(CACHE_LINE_SIZE) Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    const size_t limit_; // configured size, the ring holds at most that many items
+    std::vector<Cell, CacheLineAllocator<Cell>> cells_;
+    char padding0_[CACHE_LINE_SIZE] = {};
+    std::atomic<size_t> enqueuePos_;
+    char padding1_[CACHE_LINE_SIZE] = {};
+    std::atomic<size_t> dequeuePos_;
+    char padding2_[CACHE_LINE_SIZE] = {};
+};
+
+// Bounded single-producer/single-consumer ring. TryPush and TryPop are wait-free: each side owns one index and
+// keeps a cached copy of the other side's index, which is only reloaded when the ring looks full or empty.
+// At most one thread may push and at most one thread may pop at any time.
+template<typename T> class SpscRing {
+public:
+    static const bool MULTI_CONSUMER = false;
+
+    explicit SpscRing(uint32_t size)
+        : capacity_(RoundUpPowerOfTwo(size)), mask_(capacity_ - 1), limit_(std::max<uint32_t>(size, 1)),
+          cells_(capacity_)
+    {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    bool TryPush(const T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ >= limit_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ >= limit_) {
+                return false;
+            }
+        }
+        cells_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) {
+                return false;
+            }
+        }
+        item = std::move(cells_[head & mask_]);
+        cells_[head & mask_] = T(); // drop the reference held by the cell as soon as the item leaves the queue
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool HasReadyItem() const
+    {
+        return head_.load(std::memory_order_seq_cst) != tail_.load(std::memory_order_seq_cst);
+    }
+
+    bool HasFreeCell() const
+    {
+        return tail_.load(std::memory_order_seq_cst) - head_.load(std::memory_order_seq_cst) < limit_;
+    }
+
+    size_t Size() const
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return (tail > head) ? (tail - head) : 0;
+    }
+
+    size_t Capacity() const
+    {
+        return limit_;
+    }
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    const size_t limit_; // configured size, the ring holds at most that many items
+    std::vector<T> cells_;
+    char padding0_[CACHE_LINE_SIZE] = {};
+    std::atomic<size_t> head_; // written by the consumer
+    size_t tailCache_ = 0;     // consumer's copy of tail_
+    char padding1_[CACHE_LINE_SIZE] = {};
+    std::atomic<size_t> tail_; // written by the producer
+    size_t headCache_ = 0;     // producer's copy of head_
+    char padding2_[CACHE_LINE_SIZE] = {};
+};
+
+// Queue on top of a lock-free ring (MpmcRing or SpscRing).
+// Push and Pop never lock while the ring is neither full nor empty. A thread which has to wait spins first if
+// the wait strategy says so, then parks on a futex which is only woken when such a waiter exists.
+// The ring storage is rounded up to a power of two, the capacity stays maxSize like with the other queues.
+template<typename T, typename Ring> class LockFreeBlockingQueue : public ItemQueue<T> {
+public:
+    LockFreeBlockingQueue(uint32_t maxSize = DEFAULT_MAX_QUEUE_SIZE) : ring_(maxSize) {}
+
+    ~LockFreeBlockingQueue() {}
+
+    APP_ERROR Pop(T &item)
+    {
+        return PopUntil(item, nullptr);
+    }
+
+    APP_ERROR Pop(T &item, unsigned int timeOutMs)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+        return PopUntil(item, &deadline);
+    }
+
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems)
+    {
+        return PopBatchUntil(items, maxItems, nullptr);
+    }
+
+    APP_ERROR PopBatch(std::vector<T> &items, uint32_t maxItems, unsigned int timeOutMs)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+        return PopBatchUntil(items, maxItems, &deadline);
+    }
+
+    APP_ERROR Push(const T &item, bool isWait = false)
+    {
+        while (true) {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return APP_ERR_QUEUE_STOPED;
+            }
+            if (ring_.TryPush(item)) {
+                this->statistic_.AddPush(1, ring_.Size());
+                NotifyConsumer(false);
+                return APP_ERR_OK;
+            }
+            if (!isWait) {
+                return APP_ERROR_QUEUE_FULL;
+            }
+            WaitFreeCell();
+        }
+    }
+
+    // push the items in order, the items before the first one which can not be pushed stay in the queue
+    APP_ERROR PushBatch(const std::vector<T> &items, bool isWait = false)
+    {
+        for (const auto &item : items) {
+            APP_ERROR ret = Push(item, isWait);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+        }
+        return APP_ERR_OK;
+    }
+
+    // the producer takes the oldest items out itself, so the ring has to accept more than one consumer: ModuleManager
+    // never gives a SpscBlockingQueue to a sender which drops the oldest items
+    APP_ERROR PushEvictOldest(const T &item, uint32_t maxItems, std::vector<T> &evictedItems)
+    {
+        if (!Ring::MULTI_CONSUMER) {
+            return APP_ERR_COMM_UNREALIZED;
+        }
+        size_t limit = std::max<size_t>(std::min<size_t>(maxItems, ring_.Capacity()), 1);
+        T evicted;
+        while (true) {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return APP_ERR_QUEUE_STOPED;
+            }
+            while (ring_.Size() >= limit && ring_.TryPop(evicted)) {
+                evictedItems.push_back(std::move(evicted));
+                this->statistic_.AddPop(1);
+            }
+            if (ring_.TryPush(item)) {
+                this->statistic_.AddPush(1, ring_.Size());
+                NotifyConsumer(false);
+                return APP_ERR_OK;
+            }
+        }
+    }
+
+    // the producers spin for a free cell as well as the consumers for an item
+    void SetWaitStrategy(const QueueWaitStrategy &waitStrategy)
+    {
+        consumerSpinner_.SetStrategy(waitStrategy);
+        producerSpinner_.SetStrategy(waitStrategy);
+    }
+
+    void Stop()
+    {
+        is_stoped_.store(true, std::memory_order_release);
+        notFull_.Notify(true);
+        notEmpty_.Notify(true);
+    }
+
+    int GetSize()
+    {
+        return static_cast<int>(ring_.Size());
+    }
+
+    APP_ERROR IsEmpty()
+    {
+        return !ring_.HasReadyItem();
+    }
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    APP_ERROR PopUntil(T &item, const TimePoint *deadline)
+    {
+        while (true) {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return APP_ERR_QUEUE_STOPED;
+            }
+            if (ring_.TryPop(item)) {
+                this->statistic_.AddPop(1);
+                NotifyProducer(false);
+                return APP_ERR_OK;
+            }
+            APP_ERROR ret = WaitReadyItem(deadline);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+        }
+    }
+
+    APP_ERROR PopBatchUntil(std::vector<T> &items, uint32_t maxItems, const TimePoint *deadline)
+    {
+        items.clear();
+        T item;
+        APP_ERROR ret = PopUntil(item, deadline);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        items.push_back(std::move(item));
+        while (items.size() < maxItems && ring_.TryPop(item)) {
+            items.push_back(std::move(item));
+        }
+        if (items.size() > 1) {
+            this->statistic_.AddPop(items.size() - 1);
+            NotifyProducer(true);
+        }
+        return APP_ERR_OK;
+    }
+
+    // wait until an item is published, the queue is stopped or the deadline is reached
+    APP_ERROR WaitReadyItem(const TimePoint *deadline)
+    {
+        auto ready = [this]() { return ring_.HasReadyItem() || is_stoped_.load(std::memory_order_acquire); };
+        auto waitStart = QueueStatistic::Now();
+        bool timeout = false;
+        if (!consumerSpinner_.Spin(ready)) {
+            while (!timeout) {
+                uint32_t epoch = notEmpty_.PrepareWait();
+                if (ready()) {
+                    notEmpty_.CancelWait();
+                    break;
+                }
+                timeout = !notEmpty_.Wait(epoch, deadline);
+            }
+        }
+        this->statistic_.AddConsumerWait(waitStart);
+        return (timeout && !ring_.HasReadyItem()) ? APP_ERR_QUEUE_EMPTY : APP_ERR_OK;
+    }
+
+    // wait until a cell is free or the queue is stopped
+    void WaitFreeCell()
+    {
+        auto ready = [this]() { return ring_.HasFreeCell() || is_stoped_.load(std::memory_order_acquire); };
+        auto waitStart = QueueStatistic::Now();
+        if (!producerSpinner_.Spin(ready)) {
+            while (true) {
+                uint32_t epoch = notFull_.PrepareWait();
+                if (ready()) {
+                    notFull_.CancelWait();
+                    break;
+                }
+                notFull_.Wait(epoch, nullptr);
+            }
+        }
+        this->statistic_.AddProducerWait(waitStart);
+    }
+
+    void NotifyConsumer(bool notifyAll)
+    {
+        consumerSpinner_.RecordArrival();
+        notEmpty_.Notify(notifyAll);
+    }
+
+    void NotifyProducer(bool notifyAll)
+    {
+        producerSpinner_.RecordArrival();
+        notFull_.Notify(notifyAll);
+    }
+
+private:
+    Ring ring_;
+    QueueEvent notEmpty_;
+    QueueEvent notFull_;
+    QueueSpinner consumerSpinner_;
+    QueueSpinner producerSpinner_;
+    std::atomic<bool> is_stoped_ = {false};
+};
+
+template<typename T> using RingBlockingQueue = LockFreeBlockingQueue<T, MpmcRing<T>>;
+template<typename T> using SpscBlockingQueue = LockFreeBlockingQueue<T, SpscRing<T>>;
+#endif
@@ -0,0 +1,584 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockingQueue/ShmBlockingQueue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "Log/Log.h"
+
+namespace {
+const uint32_t SHM_SEGMENT_READY = 0x53484d31; // written last by the creator of the segment
+const uint64_t SHM_CACHE_LINE = 64;
+const uint64_t SHM_PAGE_SIZE = 4096;
+const mode_t SHM_MODE = 0600;
+const uint32_t SHM_ATTACH_TIMEOUT_MS = 5000; // max time the creator may take to initialize the segment
+const uint32_t SHM_ATTACH_POLL_MS = 1;
+const uint64_t SHM_BUFFER_INDEX_MASK = 0xffffffff;
+const uint32_t SHM_BUFFER_TAG_SHIFT = 32;
+const long NS_PER_SEC = 1000000000;
+
+uint64_t AlignUp(uint64_t value, uint64_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+size_t RoundUpCapacity(uint32_t size)
+{
+    size_t capacity = 2;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// the futexes are shared between processes, so FUTEX_PRIVATE_FLAG is not set
+void FutexWait(std::atomic<uint32_t> *word, uint32_t value, const struct timespec *timeout)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, value, timeout, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<uint32_t> *word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+}
+
+struct ShmSegment::SegmentHeader {
+    std::atomic<uint32_t> state;
+    uint32_t queueCount;
+    uint32_t queueCapacity; // slots of each ring, a power of two
+    uint32_t queueSize;     // items each ring holds at most
+    uint32_t descriptorBytes;
+    uint32_t bufferCount;
+    uint32_t bufferBytes;
+    uint64_t slotBytes;
+    uint64_t ringBytes;
+    uint64_t bufferStateOffset;
+    uint64_t bufferOffset;
+    uint64_t bufferStride;
+    uint64_t segmentBytes;
+    std::atomic<uint64_t> freeHead; // (tag << 32) | index of the first free buffer, the tag avoids the ABA problem
+};
+
+// The producer and the consumer each write their own cache line. A waiter increments the waiters count, reads the
+// sequence, checks its condition again, then sleeps on the futex of the sequence, which the other side increments
+// only when there is a waiter.
+struct ShmSegment::RingHeader {
+    std::atomic<uint64_t> head; // written by the consumer
+    char padding0[SHM_CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail; // written by the producer
+    char padding1[SHM_CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint32_t> notEmptySequence;
+    std::atomic<uint32_t> notEmptyWaiters;
+    char padding2[SHM_CACHE_LINE - 2 * sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> notFullSequence;
+    std::atomic<uint32_t> notFullWaiters;
+};
+
+namespace {
+struct BufferState {
+    std::atomic<uint32_t> refCount;
+    std::atomic<uint32_t> nextFree;
+};
+
+// the layout follows from the config, so both processes compute the same
+void ComputeLayout(const ShmSegmentConfig &config, uint64_t headerBytes, uint64_t ringHeaderBytes,
+    uint64_t &slotBytes, uint64_t &ringBytes, uint64_t &bufferStateOffset, uint64_t &bufferOffset,
+    uint64_t &bufferStride, uint64_t &segmentBytes)
+{
+    slotBytes = AlignUp(sizeof(uint32_t) + config.descriptorBytes, sizeof(uint64_t));
+    ringBytes = AlignUp(ringHeaderBytes + RoundUpCapacity(config.queueSize) * slotBytes, SHM_CACHE_LINE);
+    bufferStateOffset = AlignUp(headerBytes, SHM_CACHE_LINE) + config.queueCount * ringBytes;
+    bufferOffset = AlignUp(bufferStateOffset + config.bufferCount * sizeof(BufferState), SHM_PAGE_SIZE);
+    bufferStride = AlignUp(config.bufferBytes, SHM_CACHE_LINE);
+    segmentBytes = bufferOffset + config.bufferCount * bufferStride;
+}
+}
+
+ShmSegment::~ShmSegment()
+{
+    if (base_ != nullptr) {
+        munmap(base_, segmentBytes_);
+    }
+}
+
+APP_ERROR ShmSegment::Open(const std::string &name, const ShmSegmentConfig &config,
+    std::shared_ptr<ShmSegment> &segment)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futexes are 32 bits words");
+    if (config.queueCount == 0 || config.queueSize == 0 || config.descriptorBytes == 0 ||
+        (config.bufferCount != 0 && config.bufferBytes == 0) || config.bufferCount >= SHM_INVALID_BUFFER) {
+        LogError << "Invalid config of the shared memory segment " << name;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    uint64_t slotBytes = 0;
+    uint64_t ringBytes = 0;
+    uint64_t bufferStateOffset = 0;
+    uint64_t bufferOffset = 0;
+    uint64_t bufferStride = 0;
+    uint64_t segmentBytes = 0;
+    ComputeLayout(config, sizeof(SegmentHeader), AlignUp(sizeof(RingHeader), SHM_CACHE_LINE), slotBytes, ringBytes,
+        bufferStateOffset, bufferOffset, bufferStride, segmentBytes);
+
+    std::shared_ptr<ShmSegment> newSegment(new ShmSegment());
+    newSegment->name_ = name;
+    APP_ERROR ret = APP_ERR_OK;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, SHM_MODE);
+    if (fd >= 0) {
+        ret = newSegment->Create(fd, config, segmentBytes);
+        if (ret != APP_ERR_OK) {
+            shm_unlink(name.c_str());
+        }
+    } else if (errno == EEXIST) {
+        fd = shm_open(name.c_str(), O_RDWR, SHM_MODE);
+        ret = (fd >= 0) ? newSegment->Attach(fd, config, segmentBytes) : APP_ERR_COMM_OPEN_FAIL;
+    } else {
+        ret = APP_ERR_COMM_OPEN_FAIL;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (ret != APP_ERR_OK) {
+        LogError << "Fail to open the shared memory segment " << name << ", ret = " << ret << ", errno = " << errno;
+        return ret;
+    }
+    segment = newSegment;
+    return APP_ERR_OK;
+}
+
+APP_ERROR ShmSegment::Unlink(const std::string &name)
+{
+    return (shm_unlink(name.c_str()) == 0 || errno == ENOENT) ? APP_ERR_OK : APP_ERR_COMM_FAILURE;
+}
+
+APP_ERROR ShmSegment::Create(int fd, const ShmSegmentConfig &config, uint64_t segmentBytes)
+{
+    if (ftruncate(fd, static_cast<off_t>(segmentBytes)) != 0) {
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    void *base = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    base_ = static_cast<uint8_t *>(base);
+    segmentBytes_ = segmentBytes;
+    header_ = new (base_) SegmentHeader();
+    header_->queueCount = config.queueCount;
+    header_->queueCapacity = static_cast<uint32_t>(RoundUpCapacity(config.queueSize));
+    header_->queueSize = std::max<uint32_t>(config.queueSize, 1);
+    header_->descriptorBytes = config.descriptorBytes;
+    header_->bufferCount = config.bufferCount;
+    header_->bufferBytes = config.bufferBytes;
+    ComputeLayout(config, sizeof(SegmentHeader), AlignUp(sizeof(RingHeader), SHM_CACHE_LINE), header_->slotBytes,
+        header_->ringBytes, header_->bufferStateOffset, header_->bufferOffset, header_->bufferStride,
+        header_->segmentBytes);
+    for (uint32_t i = 0; i < config.queueCount; i++) {
+        new (GetRing(i)) RingHeader();
+    }
+    for (uint32_t i = 0; i < config.bufferCount; i++) {
+        BufferState *state = new (base_ + header_->bufferStateOffset + i * sizeof(BufferState)) BufferState();
+        state->nextFree.store((i + 1 < config.bufferCount) ? i + 1 : SHM_INVALID_BUFFER, std::memory_order_relaxed);
+    }
+    header_->freeHead.store((config.bufferCount == 0) ? SHM_INVALID_BUFFER : 0, std::memory_order_relaxed);
+    header_->state.store(SHM_SEGMENT_READY, std::memory_order_release);
+    LogInfo << "Create the shared memory segment " << name_ << " of " << segmentBytes << " bytes";
+    return APP_ERR_OK;
+}
+
+// the creator sizes the segment right after creating it, then initializes it
+APP_ERROR ShmSegment::Attach(int fd, const ShmSegmentConfig &config, uint64_t segmentBytes)
+{
+    struct stat fileStat = {};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHM_ATTACH_TIMEOUT_MS);
+    while (fstat(fd, &fileStat) == 0 && fileStat.st_size == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHM_ATTACH_POLL_MS));
+    }
+    if (static_cast<uint64_t>(fileStat.st_size) != segmentBytes) {
+        LogFatal << "The shared memory segment " << name_ << " has " << fileStat.st_size << " bytes instead of " <<
+            segmentBytes << ", it was created with another config, remove /dev/shm" << name_;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    void *base = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    base_ = static_cast<uint8_t *>(base);
+    segmentBytes_ = segmentBytes;
+    header_ = reinterpret_cast<SegmentHeader *>(base_);
+    while (header_->state.load(std::memory_order_acquire) != SHM_SEGMENT_READY &&
+        std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHM_ATTACH_POLL_MS));
+    }
+    if (header_->state.load(std::memory_order_acquire) != SHM_SEGMENT_READY) {
+        return APP_ERR_COMM_TIMEOUT;
+    }
+    if (header_->queueCount != config.queueCount ||
+        header_->queueSize != std::max<uint32_t>(config.queueSize, 1) ||
+        header_->descriptorBytes != config.descriptorBytes || header_->bufferCount != config.bufferCount ||
+        header_->bufferBytes != config.bufferBytes) {
+        LogFatal << "The shared memory segment " << name_ << " was created with another config, remove /dev/shm" <<
+            name_;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    LogInfo << "Attach the shared memory segment " << name_;
+    return APP_ERR_OK;
+}
+
+std::shared_ptr<uint8_t> ShmSegment::AllocBuffer(uint32_t size)
+{
+    if (size > header_->bufferBytes) {
+        return nullptr;
+    }
+    uint64_t head = header_->freeHead.load(std::memory_order_acquire);
+    uint32_t bufferIndex = SHM_INVALID_BUFFER;
+    while (true) {
+        bufferIndex = static_cast<uint32_t>(head & SHM_BUFFER_INDEX_MASK);
+        if (bufferIndex == SHM_INVALID_BUFFER) {
+            return nullptr;
+        }
+        uint64_t next = GetNextFree(bufferIndex)->load(std::memory_order_relaxed);
+        uint64_t newHead = (((head >> SHM_BUFFER_TAG_SHIFT) + 1) << SHM_BUFFER_TAG_SHIFT) | next;
+        if (header_->freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+    GetRefCount(bufferIndex)->store(1, std::memory_order_relaxed);
+    std::shared_ptr<ShmSegment> self = shared_from_this();
+    return std::shared_ptr<uint8_t>(GetBuffer(bufferIndex), [self, bufferIndex](uint8_t *) {
+        self->ReleaseBuffer(bufferIndex);
+    });
+}
+
+uint32_t ShmSegment::ExportBuffer(const std::shared_ptr<uint8_t> &buffer)
+{
+    uint8_t *data = buffer.get();
+    uint8_t *bufferArea = base_ + header_->bufferOffset;
+    if (header_->bufferCount == 0 || data < bufferArea || data >= base_ + segmentBytes_ ||
+        (data - bufferArea) % header_->bufferStride != 0) {
+        return SHM_INVALID_BUFFER;
+    }
+    uint32_t bufferIndex = static_cast<uint32_t>((data - bufferArea) / header_->bufferStride);
+    GetRefCount(bufferIndex)->fetch_add(1, std::memory_order_relaxed);
+    return bufferIndex;
+}
+
+std::shared_ptr<uint8_t> ShmSegment::ImportBuffer(uint32_t bufferRef)
+{
+    if (bufferRef >= header_->bufferCount) {
+        return nullptr;
+    }
+    std::shared_ptr<ShmSegment> self = shared_from_this();
+    return std::shared_ptr<uint8_t>(GetBuffer(bufferRef), [self, bufferRef](uint8_t *) {
+        self->ReleaseBuffer(bufferRef);
+    });
+}
+
+void ShmSegment::ReleaseBuffer(uint32_t bufferIndex)
+{
+    if (GetRefCount(bufferIndex)->fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    uint64_t head = header_->freeHead.load(std::memory_order_relaxed);
+    while (true) {
+        GetNextFree(bufferIndex)->store(static_cast<uint32_t>(head & SHM_BUFFER_INDEX_MASK),
+            std::memory_order_relaxed);
+        uint64_t newHead = (((head >> SHM_BUFFER_TAG_SHIFT) + 1) << SHM_BUFFER_TAG_SHIFT) | bufferIndex;
+        if (header_->freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+}
+
+uint32_t ShmSegment::GetBufferBytes() const
+{
+    return header_->bufferBytes;
+}
+
+uint32_t ShmSegment::GetQueueCount() const
+{
+    return header_->queueCount;
+}
+
+const std::string &ShmSegment::GetName() const
+{
+    return name_;
+}
+
+ShmSegment::RingHeader *ShmSegment::GetRing(uint32_t queueIndex) const
+{
+    return reinterpret_cast<RingHeader *>(base_ + AlignUp(sizeof(SegmentHeader), SHM_CACHE_LINE) +
+        queueIndex * header_->ringBytes);
+}
+
+uint8_t *ShmSegment::GetSlot(uint32_t queueIndex, uint64_t position) const
+{
+    uint8_t *slots = reinterpret_cast<uint8_t *>(GetRing(queueIndex)) + AlignUp(sizeof(RingHeader), SHM_CACHE_LINE);
+    return slots + (position & (header_->queueCapacity - 1)) * header_->slotBytes;
+}
+
+std::atomic<uint32_t> *ShmSegment::GetRefCount(uint32_t bufferIndex) const
+{
+    return &reinterpret_cast<BufferState *>(base_ + header_->bufferStateOffset)[bufferIndex].refCount;
+}
+
+std::atomic<uint32_t> *ShmSegment::GetNextFree(uint32_t bufferIndex) const
+{
+    return &reinterpret_cast<BufferState *>(base_ + header_->bufferStateOffset)[bufferIndex].nextFree;
+}
+
+uint8_t *ShmSegment::GetBuffer(uint32_t bufferIndex) const
+{
+    return base_ + header_->bufferOffset + bufferIndex * header_->bufferStride;
+}
+
+namespace {
+// the change the waiters wait for is published before calling this
+void NotifyWaiters(std::atomic<uint32_t> &sequence, std::atomic<uint32_t> &waiters)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    sequence.fetch_add(1, std::memory_order_seq_cst);
+    FutexWakeAll(&sequence);
+}
+
+// returns once ready() is true, the sequence changed or the deadline is reached
+template<typename Ready> void WaitSequence(std::atomic<uint32_t> &sequence, std::atomic<uint32_t> &waiters,
+    Ready ready, const std::chrono::steady_clock::time_point *deadline)
+{
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t value = sequence.load(std::memory_order_seq_cst);
+    if (!ready()) {
+        struct timespec timeout = {};
+        if (deadline != nullptr) {
+            long long remainNs = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline -
+                std::chrono::steady_clock::now()).count();
+            remainNs = std::max(remainNs, 0LL);
+            timeout.tv_sec = static_cast<time_t>(remainNs / NS_PER_SEC);
+            timeout.tv_nsec = static_cast<long>(remainNs % NS_PER_SEC);
+        }
+        FutexWait(&sequence, value, (deadline == nullptr) ? nullptr : &timeout);
+    }
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+}
+
+ShmBlockingQueue::ShmBlockingQueue(std::shared_ptr<ShmSegment> segment, uint32_t queueIndex,
+    const ShmMessageCodec &codec)
+    : segment_(segment), ring_(segment->GetRing(queueIndex)), queueIndex_(queueIndex), codec_(codec)
+{
+}
+
+APP_ERROR ShmBlockingQueue::Pop(std::shared_ptr<void> &item)
+{
+    return PopUntil(item, nullptr);
+}
+
+APP_ERROR ShmBlockingQueue::Pop(std::shared_ptr<void> &item, unsigned int timeOutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+    return PopUntil(item, &deadline);
+}
+
+APP_ERROR ShmBlockingQueue::PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems)
+{
+    return PopBatchUntil(items, maxItems, nullptr);
+}
+
+APP_ERROR ShmBlockingQueue::PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems,
+    unsigned int timeOutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+    return PopBatchUntil(items, maxItems, &deadline);
+}
+
+// the descriptor is encoded in the free slot, then published by moving the tail
+APP_ERROR ShmBlockingQueue::Push(const std::shared_ptr<void> &item, bool isWait)
+{
+    std::unique_lock<std::mutex> lock(pushMutex_);
+    uint64_t tail = 0;
+    while (true) {
+        if (isStoped_.load(std::memory_order_acquire)) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        tail = ring_->tail.load(std::memory_order_relaxed);
+        if (tail - ring_->head.load(std::memory_order_acquire) < segment_->header_->queueSize) {
+            break;
+        }
+        if (!isWait) {
+            return APP_ERROR_QUEUE_FULL;
+        }
+        WaitFreeSlot();
+    }
+
+    uint8_t *slot = segment_->GetSlot(queueIndex_, tail);
+    uint32_t descriptorSize = segment_->header_->descriptorBytes;
+    if (!codec_.encode(item, *segment_, slot + sizeof(uint32_t), descriptorSize) ||
+        descriptorSize > segment_->header_->descriptorBytes) {
+        LogError << "Fail to encode a message for the shared memory segment " << segment_->GetName();
+        return APP_ERR_COMM_FAILURE;
+    }
+    std::memcpy(slot, &descriptorSize, sizeof(uint32_t));
+    ring_->tail.store(tail + 1, std::memory_order_release);
+    statistic_.AddPush(1, GetSize());
+    NotifyWaiters(ring_->notEmptySequence, ring_->notEmptyWaiters);
+    return APP_ERR_OK;
+}
+
+APP_ERROR ShmBlockingQueue::PushBatch(const std::vector<std::shared_ptr<void>> &items, bool isWait)
+{
+    for (const auto &item : items) {
+        APP_ERROR ret = Push(item, isWait);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR ShmBlockingQueue::PushEvictOldest(const std::shared_ptr<void> &item, uint32_t maxItems,
+    std::vector<std::shared_ptr<void>> &evictedItems)
+{
+    return APP_ERR_COMM_UNREALIZED;
+}
+
+// only stops this side, the waiters of the other process wake up and wait again
+void ShmBlockingQueue::Stop()
+{
+    isStoped_.store(true, std::memory_order_seq_cst);
+    ring_->notEmptySequence.fetch_add(1, std::memory_order_seq_cst);
+    FutexWakeAll(&ring_->notEmptySequence);
+    ring_->notFullSequence.fetch_add(1, std::memory_order_seq_cst);
+    FutexWakeAll(&ring_->notFullSequence);
+}
+
+int ShmBlockingQueue::GetSize()
+{
+    uint64_t tail = ring_->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring_->head.load(std::memory_order_relaxed);
+    return (tail > head) ? static_cast<int>(tail - head) : 0;
+}
+
+APP_ERROR ShmBlockingQueue::IsEmpty()
+{
+    return ring_->head.load(std::memory_order_seq_cst) == ring_->tail.load(std::memory_order_seq_cst);
+}
+
+// the items are decoded and released, which returns their buffers to the pool
+ShmSegment &ShmBlockingQueue::GetSegment()
+{
+    return *segment_;
+}
+
+APP_ERROR ShmBlockingQueue::PopUntil(std::shared_ptr<void> &item, const TimePoint *deadline)
+{
+    std::vector<std::shared_ptr<void>> items;
+    APP_ERROR ret = PopBatchUntil(items, 1, deadline);
+    if (ret == APP_ERR_OK) {
+        item = items.front();
+    }
+    return ret;
+}
+
+// the descriptors which fail to decode are skipped
+APP_ERROR ShmBlockingQueue::PopBatchUntil(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems,
+    const TimePoint *deadline)
+{
+    items.clear();
+    std::unique_lock<std::mutex> lock(popMutex_);
+    std::shared_ptr<void> item;
+    while (items.size() < maxItems) {
+        if (items.empty() && isStoped_.load(std::memory_order_acquire)) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        if (TryPop(item)) {
+            if (item != nullptr) {
+                items.push_back(std::move(item));
+            }
+            continue;
+        }
+        if (!items.empty()) {
+            break;
+        }
+        if (!WaitReadyItem(deadline)) {
+            return APP_ERR_QUEUE_EMPTY;
+        }
+    }
+    return APP_ERR_OK;
+}
+
+bool ShmBlockingQueue::TryPop(std::shared_ptr<void> &item)
+{
+    uint64_t head = ring_->head.load(std::memory_order_relaxed);
+    if (head == ring_->tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    uint8_t *slot = segment_->GetSlot(queueIndex_, head);
+    uint32_t descriptorSize = 0;
+    std::memcpy(&descriptorSize, slot, sizeof(uint32_t));
+    item = (descriptorSize <= segment_->header_->descriptorBytes) ?
+        codec_.decode(slot + sizeof(uint32_t), descriptorSize, *segment_) : nullptr;
+    if (item == nullptr) {
+        LogError << "Fail to decode a message of the shared memory segment " << segment_->GetName();
+    }
+    ring_->head.store(head + 1, std::memory_order_release);
+    statistic_.AddPop(1);
+    NotifyWaiters(ring_->notFullSequence, ring_->notFullWaiters);
+    return true;
+}
+
+// false if the deadline is reached before an item is ready
+bool ShmBlockingQueue::WaitReadyItem(const TimePoint *deadline)
+{
+    auto ready = [this]() {
+        return !IsEmpty() || isStoped_.load(std::memory_order_seq_cst);
+    };
+    auto waitStart = QueueStatistic::Now();
+    while (!ready()) {
+        if (deadline != nullptr && std::chrono::steady_clock::now() >= *deadline) {
+            break;
+        }
+        WaitSequence(ring_->notEmptySequence, ring_->notEmptyWaiters, ready, deadline);
+    }
+    statistic_.AddConsumerWait(waitStart);
+    return ready();
+}
+
+void ShmBlockingQueue::WaitFreeSlot()
+{
+    uint64_t capacity = segment_->header_->queueSize;
+    auto ready = [this, capacity]() {
+        return ring_->tail.load(std::memory_order_seq_cst) - ring_->head.load(std::memory_order_seq_cst) < capacity ||
+            isStoped_.load(std::memory_order_seq_cst);
+    };
+    auto waitStart = QueueStatistic::Now();
+    while (!ready()) {
+        WaitSequence(ring_->notFullSequence, ring_->notFullWaiters, ready, nullptr);
+    }
+    statistic_.AddProducerWait(waitStart);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SHM_BLOCKING_QUEUE_H
+#define SHM_BLOCKING_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "BlockingQueue/BlockingQueue.h"
+
+class ShmSegment;
+
+// Turns a message into the bytes of its descriptor and back, for the queues between processes. encode gets the
+// capacity of the descriptor in descriptorSize and sets the bytes written, it returns false if the message can't
+// cross. The payloads aren't copied into the descriptor: they are buffers of the segment (ShmSegment::AllocBuffer)
+// passed by reference (ExportBuffer, then ImportBuffer on the other side).
+struct ShmMessageCodec {
+    std::function<bool(const std::shared_ptr<void> &message, ShmSegment &segment, uint8_t *descriptor,
+        uint32_t &descriptorSize)> encode = nullptr;
+    std::function<std::shared_ptr<void>(const uint8_t *descriptor, uint32_t descriptorSize, ShmSegment &segment)>
+        decode = nullptr;
+};
+
+struct ShmSegmentConfig {
+    uint32_t queueCount = 1;        // number of rings, one per receiver instance
+    uint32_t queueSize = DEFAULT_MAX_QUEUE_SIZE; // descriptors each ring holds at most
+    uint32_t descriptorBytes = 256; // max size of a descriptor
+    uint32_t bufferCount = 0;       // number of buffers of the pool, 0 for the descriptors only
+    uint32_t bufferBytes = 0;       // size of each buffer
+};
+
+const uint32_t SHM_INVALID_BUFFER = UINT32_MAX;
+
+// Shared memory of a connect between two processes of the same host, found by its name (shm_open): a single
+// producer/single consumer ring of descriptors per receiver instance, and a pool of fixed size buffers shared by
+// the rings. The first process to open the segment creates it, the other one maps it and must use the same config.
+// The segment isn't removed when the processes end, so that either of them can restart and go on with it, remove
+// /dev/shm/<name> once done or before changing its config.
+// A buffer is referenced by the processes which hold it, it returns to the pool when the last reference is
+// released. The buffers held by a process which crashes are lost until the segment is removed.
+class ShmSegment : public std::enable_shared_from_this<ShmSegment> {
+public:
+    ~ShmSegment();
+    static APP_ERROR Open(const std::string &name, const ShmSegmentConfig &config,
+        std::shared_ptr<ShmSegment> &segment);
+    static APP_ERROR Unlink(const std::string &name);
+
+    // buffer of at least size bytes from the pool, nullptr if size is larger than a buffer or none is free
+    std::shared_ptr<uint8_t> AllocBuffer(uint32_t size);
+    // reference of a buffer of the segment for a descriptor, SHM_INVALID_BUFFER if the data isn't in one. The
+    // reference holds the buffer until ImportBuffer takes it over.
+    uint32_t ExportBuffer(const std::shared_ptr<uint8_t> &buffer);
+    std::shared_ptr<uint8_t> ImportBuffer(uint32_t bufferRef);
+    uint32_t GetBufferBytes() const;
+    uint32_t GetQueueCount() const;
+    const std::string &GetName() const;
+
+private:
+    friend class ShmBlockingQueue;
+    struct SegmentHeader;
+    struct RingHeader;
+
+    ShmSegment() {};
+    APP_ERROR Create(int fd, const ShmSegmentConfig &config, uint64_t segmentBytes);
+    APP_ERROR Attach(int fd, const ShmSegmentConfig &config, uint64_t segmentBytes);
+    RingHeader *GetRing(uint32_t queueIndex) const;
+    uint8_t *GetSlot(uint32_t queueIndex, uint64_t position) const;
+    std::atomic<uint32_t> *GetRefCount(uint32_t bufferIndex) const;
+    std::atomic<uint32_t> *GetNextFree(uint32_t bufferIndex) const;
+    uint8_t *GetBuffer(uint32_t bufferIndex) const;
+    void ReleaseBuffer(uint32_t bufferIndex);
+
+private:
+    std::string name_ = {};
+    uint8_t *base_ = nullptr;
+    uint64_t segmentBytes_ = 0;
+    SegmentHeader *header_ = nullptr;
+};
+
+// Queue over one ring of a ShmSegment, the producer process pushes to it and the consumer process pops
+// from its own ShmBlockingQueue over the same ring, or one process does both. The messages are encoded by Push and
+// decoded by Pop with the codec. The threads of a process are serialized on each side, so that the ring only has
+// one producer and one consumer, and they park on futexes of the segment which the other process wakes.
+// The items stay in the ring when the queue stops, for the consumer which opens the segment next.
+class ShmBlockingQueue : public ItemQueue<std::shared_ptr<void>> {
+public:
+    ShmBlockingQueue(std::shared_ptr<ShmSegment> segment, uint32_t queueIndex, const ShmMessageCodec &codec);
+    ~ShmBlockingQueue() {};
+
+    APP_ERROR Pop(std::shared_ptr<void> &item);
+    APP_ERROR Pop(std::shared_ptr<void> &item, unsigned int timeOutMs);
+    APP_ERROR PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems);
+    APP_ERROR PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems, unsigned int timeOutMs);
+    APP_ERROR Push(const std::shared_ptr<void> &item, bool isWait = false);
+    APP_ERROR PushBatch(const std::vector<std::shared_ptr<void>> &items, bool isWait = false);
+    // the other process takes the items out, the producer can't evict them
+    APP_ERROR PushEvictOldest(const std::shared_ptr<void> &item, uint32_t maxItems,
+        std::vector<std::shared_ptr<void>> &evictedItems);
+    // the waits always park on the futexes of the segment
+    void SetWaitStrategy(const QueueWaitStrategy &waitStrategy) {}
+    void Stop();
+    int GetSize();
+    APP_ERROR IsEmpty();
+
+    ShmSegment &GetSegment();
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    APP_ERROR PopUntil(std::shared_ptr<void> &item, const TimePoint *deadline);
+    APP_ERROR PopBatchUntil(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems, const TimePoint *deadline);
+    // called with popMutex_ locked, false if the ring is empty
+    bool TryPop(std::shared_ptr<void> &item);
+    bool WaitReadyItem(const TimePoint *deadline);
+    void WaitFreeSlot();
+
+private:
+    std::shared_ptr<ShmSegment> segment_;
+    ShmSegment::RingHeader *ring_ = nullptr;
+    uint32_t queueIndex_ = 0;
+    ShmMessageCodec codec_ = {};
+    std::atomic<bool> isStoped_ = {false};
+    std::mutex pushMutex_;
+    std::mutex popMutex_;
+};
+#endif
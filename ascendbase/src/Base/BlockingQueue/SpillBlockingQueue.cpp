@@ -0,0 +1,526 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockingQueue/SpillBlockingQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include "Log/Log.h"
+
+namespace {
+const uint32_t SPILL_RETRY_MS = 10; // recheck of a producer which waits for room in memory and in the shared budget
+const uint64_t SPILL_RECORD_HEADER = sizeof(uint32_t); // size of the item, before its bytes
+const uint64_t SPILL_REFILL_BATCH = 64; // items read back at one time, the file of the writer is flushed once for them
+}
+
+SpillBlockingQueue::SpillBlockingQueue(const SpillQueueConfig &config, const SpillMessageCodec &codec)
+    : config_(config), codec_(codec)
+{
+}
+
+SpillBlockingQueue::~SpillBlockingQueue()
+{
+    Clear();
+    if (spillCount_ != 0) {
+        LogInfo << spillCount_ << " items were spilled to " << config_.filePrefix << "_*.spill";
+    }
+}
+
+APP_ERROR SpillBlockingQueue::Pop(std::shared_ptr<void> &item)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!WaitNotEmpty(lock, nullptr)) {
+        return isStoped_ ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+    TakeFront(item);
+    fullCond_.notify_all();
+    return APP_ERR_OK;
+}
+
+APP_ERROR SpillBlockingQueue::Pop(std::shared_ptr<void> &item, unsigned int timeOutMs)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    TimePoint deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+    if (!WaitNotEmpty(lock, &deadline)) {
+        return isStoped_ ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+    TakeFront(item);
+    fullCond_.notify_all();
+    return APP_ERR_OK;
+}
+
+APP_ERROR SpillBlockingQueue::PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems)
+{
+    items.clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!WaitNotEmpty(lock, nullptr)) {
+        return isStoped_ ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+    while (!memoryItems_.empty() && items.size() < maxItems) {
+        items.push_back(nullptr);
+        TakeFront(items.back());
+    }
+    fullCond_.notify_all();
+    return APP_ERR_OK;
+}
+
+APP_ERROR SpillBlockingQueue::PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems,
+    unsigned int timeOutMs)
+{
+    items.clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    TimePoint deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+    if (!WaitNotEmpty(lock, &deadline)) {
+        return isStoped_ ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+    while (!memoryItems_.empty() && items.size() < maxItems) {
+        items.push_back(nullptr);
+        TakeFront(items.back());
+    }
+    fullCond_.notify_all();
+    return APP_ERR_OK;
+}
+
+APP_ERROR SpillBlockingQueue::Push(const std::shared_ptr<void> &item, bool isWait)
+{
+    return PushItem(item, isWait);
+}
+
+APP_ERROR SpillBlockingQueue::PushBatch(const std::vector<std::shared_ptr<void>> &items, bool isWait)
+{
+    for (const auto &item : items) {
+        APP_ERROR ret = PushItem(item, isWait);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
+    return APP_ERR_OK;
+}
+
+// The item goes to memory if nothing is on disk and it fits, else to disk. An item which can't be encoded waits
+// until the disk is empty and the item fits in memory. The item is encoded out of the lock, only when it doesn't fit.
+APP_ERROR SpillBlockingQueue::PushItem(const std::shared_ptr<void> &item, bool isWait)
+{
+    uint64_t itemBytes = GetItemBytes(item);
+    std::vector<uint8_t> bytes;
+    bool isEncoded = false;
+    bool canSpill = (codec_.encode != nullptr);
+    bool isWaiting = false;
+    QueueStatistic::TimePoint waitStart;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (isStoped_) {
+                return APP_ERR_QUEUE_STOPED;
+            }
+            if (spilledItems_ == 0 && !isSpilling_ && TryPushMemory(item, itemBytes)) {
+                if (isWaiting) {
+                    statistic_.AddProducerWait(waitStart);
+                }
+                statistic_.AddPush(1, memoryItems_.size() + spilledItems_);
+                emptyCond_.notify_one();
+                return APP_ERR_OK;
+            }
+        }
+        if (canSpill && !isEncoded) {
+            canSpill = codec_.encode(item, bytes);
+            isEncoded = true;
+        }
+        APP_ERROR ret = canSpill ? SpillItem(item, itemBytes, bytes) : APP_ERROR_QUEUE_FULL;
+        if (ret != APP_ERROR_QUEUE_FULL) {
+            if (ret == APP_ERR_OK && isWaiting) {
+                statistic_.AddProducerWait(waitStart);
+            }
+            return ret;
+        }
+        if (!isWait) {
+            return APP_ERROR_QUEUE_FULL;
+        }
+        if (!isWaiting) {
+            isWaiting = true;
+            waitStart = QueueStatistic::Now();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        fullCond_.wait_for(lock, std::chrono::milliseconds(SPILL_RETRY_MS));
+    }
+}
+
+// Appends the item to the spill files unless it fits in memory now, APP_ERROR_QUEUE_FULL if the disk is full. The
+// producers spill one at a time, the item is counted once written, so that the consumer reads what is in the file.
+APP_ERROR SpillBlockingQueue::SpillItem(const std::shared_ptr<void> &item, uint64_t itemBytes,
+    const std::vector<uint8_t> &bytes)
+{
+    std::unique_lock<std::mutex> writeLock(writeMutex_);
+    uint64_t recordBytes = SPILL_RECORD_HEADER + bytes.size();
+    bool isNewSegment = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (isStoped_) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        if (spilledItems_ == 0 && TryPushMemory(item, itemBytes)) {
+            statistic_.AddPush(1, memoryItems_.size());
+            emptyCond_.notify_one();
+            return APP_ERR_OK;
+        }
+        if (config_.maxDiskBytes != 0 && spilledBytes_ != 0 && spilledBytes_ + recordBytes > config_.maxDiskBytes) {
+            return APP_ERROR_QUEUE_FULL;
+        }
+        isSpilling_ = true;
+        isNewSegment = (writeFile_ == nullptr || isWriteSegmentRetired_ || writeBytes_ >= config_.segmentBytes);
+        isWriteSegmentRetired_ = false;
+    }
+    APP_ERROR ret = WriteRecord(bytes, isNewSegment);
+    std::unique_lock<std::mutex> lock(mutex_);
+    isSpilling_ = false;
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    if (isWriteSegmentRetired_) {
+        // a failed read gave up the segment while the item was written to it
+        statistic_.AddDrop(1);
+        return APP_ERR_OK;
+    }
+    if (segments_.empty() || segments_.back().index != writeIndex_) {
+        segments_.push_back({writePath_, writeIndex_, 0});
+    }
+    segments_.back().itemCount++;
+    spilledItems_++;
+    spilledBytes_ += recordBytes;
+    spillCount_++;
+    statistic_.AddPush(1, memoryItems_.size() + spilledItems_);
+    emptyCond_.notify_one();
+    return APP_ERR_OK;
+}
+
+// called with writeMutex_ locked, appends the item to the last segment or to a new one
+APP_ERROR SpillBlockingQueue::WriteRecord(const std::vector<uint8_t> &bytes, bool isNewSegment)
+{
+    if (isNewSegment) {
+        if (writeFile_ != nullptr) {
+            fclose(writeFile_);
+            writeFile_ = nullptr;
+        }
+        writeIndex_ = segmentIndex_++;
+        writePath_ = config_.filePrefix + "_" + std::to_string(writeIndex_) + ".spill";
+        writeBytes_ = 0;
+        writeFile_ = fopen(writePath_.c_str(), "wb");
+        if (writeFile_ == nullptr) {
+            LogError << "Fail to create the spill file " << writePath_;
+            return APP_ERR_COMM_OPEN_FAIL;
+        }
+    }
+    uint32_t size = static_cast<uint32_t>(bytes.size());
+    if (fwrite(&size, sizeof(size), 1, writeFile_) != 1 ||
+        (size != 0 && fwrite(bytes.data(), 1, size, writeFile_) != size)) {
+        LogError << "Fail to write the spill file " << writePath_;
+        return APP_ERR_COMM_WRITE_FAIL;
+    }
+    writeBytes_ += SPILL_RECORD_HEADER + size;
+    return APP_ERR_OK;
+}
+
+APP_ERROR SpillBlockingQueue::PushEvictOldest(const std::shared_ptr<void> &item, uint32_t maxItems,
+    std::vector<std::shared_ptr<void>> &evictedItems)
+{
+    return APP_ERR_COMM_UNREALIZED;
+}
+
+APP_ERROR SpillBlockingQueue::SetByteBudget(ItemSizeGetter sizeGetter, uint64_t maxBytes,
+    std::shared_ptr<QueueMemoryBudget> sharedBudget)
+{
+    if (sizeGetter == nullptr) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    sizeGetter_ = sizeGetter;
+    maxBytes_ = maxBytes;
+    sharedBudget_ = sharedBudget;
+    return APP_ERR_OK;
+}
+
+void SpillBlockingQueue::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        isStoped_ = true;
+    }
+    fullCond_.notify_all();
+    emptyCond_.notify_all();
+    if (sharedBudget_ != nullptr) {
+        sharedBudget_->NotifyAll();
+    }
+}
+
+int SpillBlockingQueue::GetSize()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return static_cast<int>(memoryItems_.size() + spilledItems_);
+}
+
+APP_ERROR SpillBlockingQueue::IsEmpty()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return memoryItems_.empty() && spilledItems_ == 0;
+}
+
+void SpillBlockingQueue::Clear()
+{
+    std::unique_lock<std::mutex> readLock(readMutex_);
+    std::unique_lock<std::mutex> writeLock(writeMutex_);
+    std::vector<std::string> paths;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!memoryItems_.empty()) {
+            std::shared_ptr<void> item;
+            TakeFront(item);
+        }
+        for (auto &segment : segments_) {
+            paths.push_back(segment.path);
+        }
+        segments_.clear();
+        spilledItems_ = 0;
+        spilledBytes_ = 0;
+        clearCount_++;
+        fullCond_.notify_all();
+    }
+    if (writeFile_ != nullptr) {
+        fclose(writeFile_);
+        writeFile_ = nullptr;
+    }
+    if (readFile_ != nullptr) {
+        fclose(readFile_);
+        readFile_ = nullptr;
+        readPath_.clear();
+    }
+    RemoveSegments(paths);
+}
+
+uint64_t SpillBlockingQueue::GetSpillCount() const
+{
+    return spillCount_;
+}
+
+// called with mutex_ locked, false if the queue stopped or the deadline passed while it is empty
+bool SpillBlockingQueue::WaitNotEmpty(std::unique_lock<std::mutex> &lock, const TimePoint *deadline)
+{
+    if (memoryItems_.empty()) {
+        Refill(lock);
+    }
+    if (!memoryItems_.empty() || isStoped_) {
+        return !isStoped_;
+    }
+    auto waitStart = QueueStatistic::Now();
+    while (memoryItems_.empty() && !isStoped_) {
+        if (spilledItems_ != 0 && !isRefilling_) {
+            Refill(lock);
+            continue;
+        }
+        if (deadline == nullptr) {
+            emptyCond_.wait(lock);
+        } else if (emptyCond_.wait_until(lock, *deadline) == std::cv_status::timeout) {
+            Refill(lock);
+            break;
+        }
+    }
+    statistic_.AddConsumerWait(waitStart);
+    return !isStoped_ && !memoryItems_.empty();
+}
+
+// called with mutex_ locked, an empty queue accepts an item bigger than the byte budgets
+bool SpillBlockingQueue::TryPushMemory(const std::shared_ptr<void> &item, uint64_t itemBytes)
+{
+    if (IsMemoryOverLimit(itemBytes)) {
+        return false;
+    }
+    if (sharedBudget_ != nullptr && itemBytes != 0 &&
+        !sharedBudget_->Acquire(itemBytes, false, [this]() { return queuedBytes_ == 0; })) {
+        return false;
+    }
+    memoryItems_.push_back(item);
+    queuedBytes_ += itemBytes;
+    return true;
+}
+
+// called with mutex_ locked
+bool SpillBlockingQueue::IsMemoryOverLimit(uint64_t itemBytes) const
+{
+    return memoryItems_.size() >= config_.maxItems ||
+        (maxBytes_ != 0 && queuedBytes_ != 0 && queuedBytes_ + itemBytes > maxBytes_);
+}
+
+// Called with mutex_ locked, moves a batch of the oldest spilled items back to memory, which is unlocked while the
+// files are read. The byte budgets are checked once for the batch: the items taken out of the disk are kept.
+void SpillBlockingQueue::Refill(std::unique_lock<std::mutex> &lock)
+{
+    if (isRefilling_ || spilledItems_ == 0 || (!memoryItems_.empty() && IsMemoryOverLimit(0)) ||
+        (sharedBudget_ != nullptr && sharedBudget_->GetUsedBytes() >= sharedBudget_->GetMaxBytes() &&
+        queuedBytes_ != 0)) {
+        return;
+    }
+    uint64_t roomCount = (memoryItems_.size() < config_.maxItems) ? config_.maxItems - memoryItems_.size() : 1;
+    uint64_t planCount = std::min(std::min(roomCount, spilledItems_), SPILL_REFILL_BATCH);
+    std::vector<std::pair<std::string, uint64_t>> readPlan;
+    bool isWriteSegmentRead = false;
+    for (size_t i = 0; i < segments_.size() && planCount != 0; i++) {
+        uint64_t count = std::min(planCount, segments_[i].itemCount);
+        if (count != 0) {
+            readPlan.push_back(std::make_pair(segments_[i].path, count));
+            isWriteSegmentRead = (i + 1 == segments_.size());
+            planCount -= count;
+        }
+    }
+    uint64_t clearCount = clearCount_;
+    isRefilling_ = true;
+    lock.unlock();
+
+    std::vector<std::shared_ptr<void>> items;
+    uint64_t readCount = 0;
+    uint64_t readBytes = 0;
+    bool isReadOk = ReadRecords(readPlan, isWriteSegmentRead, items, readCount, readBytes);
+
+    lock.lock();
+    std::vector<std::string> removedPaths;
+    if (clearCount == clearCount_) {
+        for (uint64_t count = readCount; count != 0 && !segments_.empty();) {
+            Segment &segment = segments_.front();
+            uint64_t segmentCount = std::min(count, segment.itemCount);
+            segment.itemCount -= segmentCount;
+            count -= segmentCount;
+            if (segment.itemCount == 0 && segments_.size() > 1) {
+                removedPaths.push_back(segment.path);
+                segments_.pop_front();
+            }
+        }
+        spilledItems_ -= readCount;
+        spilledBytes_ -= readBytes;
+        statistic_.AddDrop(readCount - items.size());
+        if (!isReadOk) {
+            LogError << "The items spilled to " << config_.filePrefix << "_*.spill can't be read, "
+                     << spilledItems_ << " items are lost";
+            statistic_.AddDrop(spilledItems_);
+            spilledItems_ = 0;
+            spilledBytes_ = 0;
+        }
+        // the segment written is removed once read up, unless an item is being written to it
+        if (!isReadOk || (spilledItems_ == 0 && !isSpilling_)) {
+            for (auto &segment : segments_) {
+                removedPaths.push_back(segment.path);
+            }
+            segments_.clear();
+            isWriteSegmentRetired_ = true;
+        }
+        for (auto &item : items) {
+            // the item is taken out of the disk already, it is kept whatever the budget
+            uint64_t itemBytes = GetItemBytes(item);
+            if (sharedBudget_ != nullptr && itemBytes != 0) {
+                sharedBudget_->Acquire(itemBytes, false, []() { return true; });
+            }
+            memoryItems_.push_back(item);
+            queuedBytes_ += itemBytes;
+        }
+    } else {
+        items.clear();
+    }
+    if (!removedPaths.empty()) {
+        lock.unlock();
+        {
+            std::unique_lock<std::mutex> readLock(readMutex_);
+            RemoveSegments(removedPaths);
+        }
+        lock.lock();
+    }
+    isRefilling_ = false;
+    emptyCond_.notify_all();
+    fullCond_.notify_all();
+}
+
+// Called without lock, reads the items of readPlan, count by segment, in the order they were written. The
+// producer's buffer is flushed once when the items are read from the segment it writes.
+bool SpillBlockingQueue::ReadRecords(const std::vector<std::pair<std::string, uint64_t>> &readPlan,
+    bool isWriteSegmentRead, std::vector<std::shared_ptr<void>> &items, uint64_t &readCount, uint64_t &readBytes)
+{
+    std::unique_lock<std::mutex> readLock(readMutex_);
+    if (isWriteSegmentRead) {
+        std::unique_lock<std::mutex> writeLock(writeMutex_);
+        if (writeFile_ != nullptr) {
+            fflush(writeFile_);
+        }
+    }
+    std::vector<uint8_t> bytes;
+    for (auto &segmentRead : readPlan) {
+        if (readFile_ == nullptr || readPath_ != segmentRead.first) {
+            if (readFile_ != nullptr) {
+                fclose(readFile_);
+            }
+            readPath_ = segmentRead.first;
+            readFile_ = fopen(readPath_.c_str(), "rb");
+            if (readFile_ == nullptr) {
+                return false;
+            }
+        }
+        // the end of the file may have been reached by a previous read before the writer appended to it
+        clearerr(readFile_);
+        for (uint64_t i = 0; i < segmentRead.second; i++) {
+            uint32_t size = 0;
+            if (fread(&size, sizeof(size), 1, readFile_) != 1) {
+                return false;
+            }
+            bytes.resize(size);
+            if (size != 0 && fread(bytes.data(), 1, size, readFile_) != size) {
+                return false;
+            }
+            readCount++;
+            readBytes += SPILL_RECORD_HEADER + size;
+            std::shared_ptr<void> item = codec_.decode(bytes.data(), size);
+            if (item != nullptr) {
+                items.push_back(item);
+            }
+        }
+    }
+    return true;
+}
+
+// called with readMutex_ locked
+void SpillBlockingQueue::RemoveSegments(const std::vector<std::string> &paths)
+{
+    for (auto &path : paths) {
+        if (readFile_ != nullptr && readPath_ == path) {
+            fclose(readFile_);
+            readFile_ = nullptr;
+            readPath_.clear();
+        }
+        std::remove(path.c_str());
+    }
+}
+
+// called with mutex_ locked and memoryItems_ not empty
+void SpillBlockingQueue::TakeFront(std::shared_ptr<void> &item)
+{
+    item = std::move(memoryItems_.front());
+    memoryItems_.pop_front();
+    statistic_.AddPop(1);
+    uint64_t itemBytes = GetItemBytes(item);
+    queuedBytes_ -= itemBytes;
+    if (sharedBudget_ != nullptr && itemBytes != 0) {
+        sharedBudget_->Release(itemBytes);
+    }
+}
+
+uint64_t SpillBlockingQueue::GetItemBytes(const std::shared_ptr<void> &item) const
+{
+    return (sizeGetter_ == nullptr) ? 0 : sizeGetter_(item);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SPILL_BLOCKING_QUEUE_H
+#define SPILL_BLOCKING_QUEUE_H
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BlockingQueue/BlockingQueue.h"
+
+// Turns a message into bytes for the spill files and back. encode returns false for a message which can't be
+// written, which then waits for room in memory like with the other queues.
+struct SpillMessageCodec {
+    std::function<bool(const std::shared_ptr<void> &message, std::vector<uint8_t> &bytes)> encode = nullptr;
+    std::function<std::shared_ptr<void>(const uint8_t *bytes, uint32_t size)> decode = nullptr;
+};
+
+struct SpillQueueConfig {
+    std::string filePrefix = {};  // the segments are <filePrefix>_<n>.spill
+    uint32_t maxItems = DEFAULT_MAX_QUEUE_SIZE; // items kept in memory
+    uint64_t segmentBytes = 64 * 1024 * 1024;   // size from which the next items go to a new segment
+    uint64_t maxDiskBytes = 0;    // bytes of the segments past which the producers wait, 0 for no limit
+};
+
+// Queue for the jobs which must neither drop nor block their producers: the items past the capacity in memory,
+// maxItems and the byte budget of SetByteBudget, are encoded and appended to segment files instead of waiting,
+// then read back in order once the consumer has taken the items in memory. Once an item is spilled, the next ones
+// follow it on disk until the consumer catches up, so that the order is kept. A segment is removed once read, so
+// the disk holds the backlog only. The spilled items are lost when the queue stops.
+// The files are written and read out of mutex_, so that the disk doesn't hold up the pushes and pops in memory: the
+// spilling producers take turns on writeMutex_ and one consumer at a time refills the memory with a batch of items.
+class SpillBlockingQueue : public ItemQueue<std::shared_ptr<void>> {
+public:
+    SpillBlockingQueue(const SpillQueueConfig &config, const SpillMessageCodec &codec);
+    ~SpillBlockingQueue();
+
+    APP_ERROR Pop(std::shared_ptr<void> &item);
+    APP_ERROR Pop(std::shared_ptr<void> &item, unsigned int timeOutMs);
+    APP_ERROR PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems);
+    APP_ERROR PopBatch(std::vector<std::shared_ptr<void>> &items, uint32_t maxItems, unsigned int timeOutMs);
+    APP_ERROR Push(const std::shared_ptr<void> &item, bool isWait = false);
+    APP_ERROR PushBatch(const std::vector<std::shared_ptr<void>> &items, bool isWait = false);
+    // nothing is dropped, the producers spill instead
+    APP_ERROR PushEvictOldest(const std::shared_ptr<void> &item, uint32_t maxItems,
+        std::vector<std::shared_ptr<void>> &evictedItems);
+    // the producers wait for room on disk only, and then in steps of SPILL_RETRY_MS
+    void SetWaitStrategy(const QueueWaitStrategy &waitStrategy) {}
+    void Stop();
+    int GetSize();
+    APP_ERROR IsEmpty();
+
+    // the byte budgets bound the items in memory, the next ones are spilled
+    APP_ERROR SetByteBudget(ItemSizeGetter sizeGetter, uint64_t maxBytes,
+        std::shared_ptr<QueueMemoryBudget> sharedBudget);
+    // drops the items in memory and removes the spill files
+    void Clear();
+
+    uint64_t GetSpillCount() const;
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct Segment {
+        std::string path;
+        uint64_t index;
+        uint64_t itemCount; // written and not read yet
+    };
+
+    // called without lock
+    APP_ERROR PushItem(const std::shared_ptr<void> &item, bool isWait);
+    APP_ERROR SpillItem(const std::shared_ptr<void> &item, uint64_t itemBytes, const std::vector<uint8_t> &bytes);
+    APP_ERROR WriteRecord(const std::vector<uint8_t> &bytes, bool isNewSegment);
+    bool ReadRecords(const std::vector<std::pair<std::string, uint64_t>> &readPlan, bool isWriteSegmentRead,
+        std::vector<std::shared_ptr<void>> &items, uint64_t &readCount, uint64_t &readBytes);
+    void RemoveSegments(const std::vector<std::string> &paths);
+    // called with mutex_ locked
+    bool WaitNotEmpty(std::unique_lock<std::mutex> &lock, const TimePoint *deadline);
+    bool TryPushMemory(const std::shared_ptr<void> &item, uint64_t itemBytes);
+    bool IsMemoryOverLimit(uint64_t itemBytes) const;
+    void Refill(std::unique_lock<std::mutex> &lock);
+    void TakeFront(std::shared_ptr<void> &item);
+    uint64_t GetItemBytes(const std::shared_ptr<void> &item) const;
+
+private:
+    SpillQueueConfig config_ = {};
+    SpillMessageCodec codec_ = {};
+    std::deque<std::shared_ptr<void>> memoryItems_ = {};
+    std::mutex mutex_;
+    std::condition_variable emptyCond_;
+    std::condition_variable fullCond_;
+    ItemSizeGetter sizeGetter_ = nullptr;
+    uint64_t maxBytes_ = 0;
+    std::shared_ptr<QueueMemoryBudget> sharedBudget_ = nullptr;
+    std::atomic<uint64_t> queuedBytes_ = {0}; // in memory, read by the bypass check of the shared budget
+    std::deque<Segment> segments_ = {}; // front is read, back is written
+    uint64_t spilledItems_ = 0; // on disk
+    uint64_t spilledBytes_ = 0; // on disk
+    bool isSpilling_ = false;   // a producer writes an item, the next ones follow it
+    bool isRefilling_ = false;  // a consumer reads a batch of items
+    bool isWriteSegmentRetired_ = false; // the segment written was read up and removed, the next item opens one
+    uint64_t clearCount_ = 0;   // a refill running over Clear drops what it read
+    std::atomic<uint64_t> spillCount_ = {0};
+    std::atomic<bool> isStoped_ = {false};
+    // taken before mutex_, readMutex_ before writeMutex_
+    std::mutex readMutex_;
+    std::mutex writeMutex_;
+    FILE *writeFile_ = nullptr;  // with writeMutex_
+    std::string writePath_ = {};
+    uint64_t writeIndex_ = 0;    // of the segment written
+    uint64_t writeBytes_ = 0;    // in the segment written
+    uint64_t segmentIndex_ = 0;  // of the next segment file
+    FILE *readFile_ = nullptr;   // with readMutex_
+    std::string readPath_ = {};
+};
+#endif
@@ -22,6 +22,7 @@
 #include <vector>
 #include "acl/acl.h"
 #include "acl/ops/acl_dvpp.h"
+#include "CommonDataType/RawData.h"
 
 #define DVPP_ALIGN_UP(x, align) ((((x) + ((align)-1)) / (align)) * (align))
 
@@ -92,12 +93,6 @@ struct ImageInfo {
     std::shared_ptr<uint8_t> data; // Smart pointer of image data
 };
 
-// Description of data in device
-struct RawData {
-    size_t lenOfByte; // Size of memory, bytes
-    std::shared_ptr<void> data; // Smart pointer of data
-};
-
 // Description of data in device
 struct StreamData {
     size_t size; // Size of memory, bytes
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2020.Huawei Technologies Co., Ltd. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RAW_DATA_H
+#define RAW_DATA_H
+
+#include <cstddef>
+#include <memory>
+
+// Description of data in device, apart from CommonDataType.h so that the host side code doesn't need AscendCL
+struct RawData {
+    size_t lenOfByte; // Size of memory, bytes
+    std::shared_ptr<void> data; // Smart pointer of data
+};
+
+#endif
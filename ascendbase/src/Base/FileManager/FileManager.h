@@ -36,7 +36,7 @@
 #include <cstdio>
 #include <iostream>
 #include <set>
-#include "CommonDataType/CommonDataType.h"
+#include "CommonDataType/RawData.h"
 #include "Log/Log.h"
 #include "ErrorCode/ErrorCode.h"
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ModuleManager/CpuAffinity.h"
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "Log/Log.h"
+
+namespace ascendBaseModule {
+namespace {
+const int MPOL_PREFERRED_MODE = 1; // MPOL_PREFERRED of numaif.h, which comes with libnuma
+const int MAX_NUMA_NODE = 64;
+const int BITS_PER_ULONG = sizeof(unsigned long) * 8;
+}
+
+APP_ERROR ParseCpuList(const std::string &cpuListStr, std::vector<uint32_t> &cpuList)
+{
+    cpuList.clear();
+    std::stringstream listStream(cpuListStr);
+    std::string range;
+    while (std::getline(listStream, range, ',')) {
+        if (range.find_first_not_of(" \t\r\n") == std::string::npos) {
+            continue;
+        }
+        unsigned long first = 0;
+        unsigned long last = 0;
+        char separator = 0;
+        std::stringstream rangeStream(range);
+        if (!(rangeStream >> first)) {
+            LogError << "Invalid cpu list " << cpuListStr;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        last = first;
+        if ((rangeStream >> separator) && (separator != '-' || !(rangeStream >> last))) {
+            LogError << "Invalid cpu list " << cpuListStr;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        if (last < first || last >= CPU_SETSIZE) {
+            LogError << "Invalid cpu list " << cpuListStr;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++) {
+            cpuList.push_back(static_cast<uint32_t>(cpu));
+        }
+    }
+    if (cpuList.empty()) {
+        LogError << "Empty cpu list " << cpuListStr;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR GetNumaNodeCpus(int numaNode, std::vector<uint32_t> &cpuList)
+{
+    std::string path = "/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist";
+    std::ifstream file(path);
+    std::string cpuListStr;
+    if (!file.is_open() || !std::getline(file, cpuListStr)) {
+        LogError << "Fail to read the cpus of numa node " << numaNode << " from " << path;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    return ParseCpuList(cpuListStr, cpuList);
+}
+
+APP_ERROR SetThreadAffinity(pthread_t thread, const std::vector<uint32_t> &cpuList)
+{
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (auto cpu : cpuList) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    int ret = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuSet);
+    if (ret != 0) {
+        LogError << "Fail to set the cpu affinity of a thread, ret = " << ret;
+        return APP_ERR_COMM_FAILURE;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR SetPreferredNumaNode(int numaNode)
+{
+    if (numaNode < 0 || numaNode >= MAX_NUMA_NODE) {
+        LogError << "Invalid numa node " << numaNode;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    unsigned long nodeMask[MAX_NUMA_NODE / BITS_PER_ULONG] = {0};
+    nodeMask[numaNode / BITS_PER_ULONG] = 1UL << (numaNode % BITS_PER_ULONG);
+    // maxnode is the number of bits of the mask plus one, the kernel ignores the last one
+    long ret = syscall(SYS_set_mempolicy, MPOL_PREFERRED_MODE, nodeMask, MAX_NUMA_NODE + 1);
+    if (ret != 0) {
+        LogError << "Fail to prefer the memory of numa node " << numaNode << ", errno = " << errno;
+        return APP_ERR_COMM_FAILURE;
+    }
+    return APP_ERR_OK;
+}
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_CPU_AFFINITY_H
+#define INC_CPU_AFFINITY_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+
+namespace ascendBaseModule {
+// cpu list in the kernel format, such as "0-3,8,10-11"
+APP_ERROR ParseCpuList(const std::string &cpuListStr, std::vector<uint32_t> &cpuList);
+// cpus of the numa node, from /sys/devices/system/node/node<numaNode>/cpulist
+APP_ERROR GetNumaNodeCpus(int numaNode, std::vector<uint32_t> &cpuList);
+APP_ERROR SetThreadAffinity(pthread_t thread, const std::vector<uint32_t> &cpuList);
+// the memory allocated by the calling thread, and by the threads it creates afterwards, comes from the numa node
+// as long as it has free memory
+APP_ERROR SetPreferredNumaNode(int numaNode);
+}
+
+#endif
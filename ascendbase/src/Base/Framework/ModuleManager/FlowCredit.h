@@ -0,0 +1,137 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_FLOW_CREDIT_H
+#define INC_FLOW_CREDIT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "SlotAllocator.h"
+
+namespace ascendBaseModule {
+// Credits bounding the frames a source has in flight in the pipeline. The source acquires a credit for each frame
+// and the frame carries the token through the modules. The credit returns when the last reference to the token is
+// dropped, that is when the frame is released after the last module or dropped on the way, so the source throttles
+// or drops at ingest instead of the modules blocking each other hop by hop in the middle of the pipeline.
+// There is one token slot per credit, holding the control block of the shared_ptr like MessagePool does, so a token
+// costs no heap allocation.
+class FlowCredit : public std::enable_shared_from_this<FlowCredit> {
+public:
+    explicit FlowCredit(uint32_t creditCount) : creditCount_(creditCount), slots_(creditCount)
+    {
+        freeSlots_.reserve(creditCount);
+        for (auto &slot : slots_) {
+            freeSlots_.push_back(&slot);
+        }
+        readyFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~FlowCredit()
+    {
+        if (readyFd_ >= 0) {
+            close(readyFd_);
+        }
+    }
+
+    // token holding one credit, nullptr if no credit returned within waitMs
+    // the FlowCredit must be owned by a shared_ptr, which the tokens keep alive
+    std::shared_ptr<void> Acquire(uint32_t waitMs)
+    {
+        TokenSlot *slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (isReadySignaled_) {
+                uint64_t value = 0;
+                while (read(readyFd_, &value, sizeof(value)) > 0) {}
+                isReadySignaled_ = false;
+            }
+            if (!cond_.wait_for(lock, std::chrono::milliseconds(waitMs), [this]() { return !freeSlots_.empty(); })) {
+                isWaited_ = true;
+                return nullptr;
+            }
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+        return std::shared_ptr<void>(static_cast<void *>(slot), TokenDeleter(),
+            SlotAllocator<TokenSlot, FlowCredit, TokenSlot> {slot, shared_from_this()});
+    }
+
+    // readable (POLLIN) once a credit returns after an Acquire found none, for the sources which wait on an event
+    // loop instead of blocking in Acquire, -1 if it couldn't be created
+    int GetReadyFd() const
+    {
+        return readyFd_;
+    }
+
+    uint32_t GetInflightCount()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return creditCount_ - static_cast<uint32_t>(freeSlots_.size());
+    }
+
+    uint32_t GetCreditCount() const
+    {
+        return creditCount_;
+    }
+
+private:
+    struct TokenSlot {
+        SlotControlBlock controlBlock;
+    };
+
+    // the credit returns with the slot, in Recycle
+    struct TokenDeleter {
+        void operator()(void *) const {}
+    };
+
+    template<typename U, typename Owner, typename Slot> friend struct SlotAllocator;
+
+    // readyFd_ is written under the lock, so that an Acquire never drains it before the write and leaves it readable
+    void Recycle(TokenSlot *slot)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            freeSlots_.push_back(slot);
+            if (isWaited_ && readyFd_ >= 0) {
+                // if the write fails, the source finds the credit when its wait times out
+                const uint64_t value = 1;
+                ssize_t written = write(readyFd_, &value, sizeof(value));
+                (void)written;
+                isReadySignaled_ = true;
+            }
+            isWaited_ = false;
+        }
+        cond_.notify_one();
+    }
+
+private:
+    const uint32_t creditCount_;
+    std::vector<TokenSlot> slots_;
+    std::vector<TokenSlot *> freeSlots_ = {};
+    int readyFd_ = -1;
+    bool isWaited_ = false;        // an Acquire found no credit, the next release signals readyFd_
+    bool isReadySignaled_ = false; // readyFd_ is readable until the next Acquire
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+}
+
+#endif
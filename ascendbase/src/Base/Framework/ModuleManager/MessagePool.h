@@ -0,0 +1,144 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_MESSAGE_POOL_H
+#define INC_MESSAGE_POOL_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+#include "SlotAllocator.h"
+
+namespace ascendBaseModule {
+const uint32_t MESSAGE_POOL_MAX_FREE = 1024;
+
+// Pool of recyclable messages. A message lives in a slot together with the control block of the shared_ptr handed
+// out by Acquire, so the reference count is stored in the message slot and a message sent through the queues as
+// shared_ptr<void> costs no heap allocation once the pool is warm. When the last reference is dropped the message
+// is reset, not destroyed, so that its members keep their capacity, and the slot goes back to the free list.
+template<typename T> class MessagePool : public std::enable_shared_from_this<MessagePool<T>> {
+public:
+    using ResetFunc = std::function<void(T &)>;
+
+    // resetFunc prepares a released message for its next use, by default it is assigned T()
+    explicit MessagePool(uint32_t maxFreeCount = MESSAGE_POOL_MAX_FREE, ResetFunc resetFunc = nullptr)
+        : maxFreeCount_(maxFreeCount), resetFunc_(resetFunc) {}
+
+    ~MessagePool()
+    {
+        for (auto slot : freeSlots_) {
+            delete slot;
+        }
+    }
+
+    // the pool must be owned by a shared_ptr, which the messages keep alive
+    std::shared_ptr<T> Acquire()
+    {
+        Slot *slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!freeSlots_.empty()) {
+                slot = freeSlots_.back();
+                freeSlots_.pop_back();
+            }
+        }
+        if (slot == nullptr) {
+            slot = new Slot();
+            createdCount_++;
+        }
+        return std::shared_ptr<T>(&slot->message, MessageResetter {this},
+            SlotAllocator<T, MessagePool, Slot> {slot, this->shared_from_this()});
+    }
+
+    // number of messages created since the pool exists, in use or free
+    uint64_t GetCreatedCount() const
+    {
+        return createdCount_;
+    }
+
+    size_t GetFreeCount()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return freeSlots_.size();
+    }
+
+private:
+    struct Slot {
+        T message = {};
+        SlotControlBlock controlBlock;
+    };
+
+    struct MessageResetter {
+        MessagePool *pool;
+        void operator()(T *message) const
+        {
+            if (pool->resetFunc_ != nullptr) {
+                pool->resetFunc_(*message);
+            } else {
+                *message = T();
+            }
+        }
+    };
+
+    template<typename U, typename Owner, typename S> friend struct SlotAllocator;
+
+    void Recycle(Slot *slot)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (freeSlots_.size() < maxFreeCount_) {
+                freeSlots_.push_back(slot);
+                return;
+            }
+        }
+        delete slot;
+    }
+
+private:
+    const uint32_t maxFreeCount_;
+    ResetFunc resetFunc_;
+    std::mutex mutex_;
+    std::vector<Slot *> freeSlots_ = {};
+    std::atomic<uint64_t> createdCount_ = {0};
+};
+
+// The message pools of a pipeline, one per message type, shared by its module instances through ModuleInitArgs
+class MessagePoolSet {
+public:
+    // the first call for a type creates its pool with these parameters, the next ones return the same pool
+    template<typename T> std::shared_ptr<MessagePool<T>> GetPool(uint32_t maxFreeCount = MESSAGE_POOL_MAX_FREE,
+        typename MessagePool<T>::ResetFunc resetFunc = nullptr)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::shared_ptr<void> &pool = poolMap_[std::type_index(typeid(T))];
+        if (pool == nullptr) {
+            pool = std::make_shared<MessagePool<T>>(maxFreeCount, resetFunc);
+        }
+        return std::static_pointer_cast<MessagePool<T>>(pool);
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::type_index, std::shared_ptr<void>> poolMap_ = {};
+};
+}
+
+#endif
@@ -15,14 +15,39 @@
  */
 
 #include "ModuleBase.h"
+#include "ModuleManager/CpuAffinity.h"
+#include <algorithm>
 #include <chrono>
+#include <poll.h>
 #include "Log/Log.h"
 #include "BlockingQueue/BlockingQueue.h"
 #include "ErrorCode/ErrorCode.h"
 
 namespace ascendBaseModule {
 const int INPUTQUEUE_WARN_SIZE = 32;
+const double INPUTQUEUE_WARN_INTERVAL_MS = 1000.0; // at most one queue size warning per interval
 const double TIME_COUNTS = 1000.0;
+const uint32_t MODULE_TASK_QUANTUM = 16; // max items processed by one task before the others get the worker
+const uint32_t RANDOM_SEED_FACTOR = 2654435761U;
+const uint64_t US_PER_MS = 1000;
+
+// what the senders push to a module joining several connects, so that it knows the input of the message
+struct ModuleJoinMessage {
+    uint32_t port;
+    std::shared_ptr<void> data;
+};
+
+enum ModuleTaskState {
+    MODULE_TASK_IDLE = 0,
+    MODULE_TASK_QUEUED,
+    MODULE_TASK_RUNNING
+};
+
+uint64_t GetModuleTimeUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 void ModuleBase::AssignInitArgs(const ModuleInitArgs &initArgs)
 {
@@ -33,17 +58,85 @@ void ModuleBase::AssignInitArgs(const ModuleInitArgs &initArgs)
     pipelineName_ = initArgs.pipelineName;
     moduleName_ = initArgs.moduleName;
     instanceId_ = initArgs.instanceId;
+    maxBatchSize_ = (initArgs.maxBatchSize == 0) ? 1 : initArgs.maxBatchSize;
+    batchTimeoutMs_ = initArgs.batchTimeoutMs;
+    maxFrameAgeUs_ = static_cast<uint64_t>(initArgs.maxFrameAgeMs) * US_PER_MS;
+    reorderWindow_ = initArgs.reorderWindow;
+    reorderTimeoutUs_ = static_cast<uint64_t>(initArgs.reorderTimeoutMs) * US_PER_MS;
+    // a reordering instance keeps its thread, which wakes up to give up the missing items on time
+    executor_ = (reorderWindow_ == 0) ? initArgs.executor : nullptr;
+    eventLoop_ = initArgs.eventLoop;
+    messagePools_ = initArgs.messagePools;
+    traceTrackId_ = ModuleTracer::GetInstance().RegisterTrack(moduleName_ + "[" + std::to_string(instanceId_) + "]");
+    randomState_ = static_cast<uint32_t>(instanceId_) * RANDOM_SEED_FACTOR + 1;
     isStop_ = false;
 }
 
-// run module instance in a new thread created
+// run module instance in a new thread created, or on the workers of the executor if it has an input queue, or
+// on the threads of the previous module if its input is fused
 APP_ERROR ModuleBase::Run()
 {
     LogDebug << moduleName_ << "[" << instanceId_ << "] Run";
+    if (maxFrameAgeUs_ != 0 && messageInfoGetter_ == nullptr) {
+        LogWarn << moduleName_ << "[" << instanceId_ << "] ignores maxFrameAgeMs without the message info getter.";
+    }
+    if (isFusedInput_) {
+        ApplyCpuAffinity();
+        return APP_ERR_OK;
+    }
+    if (executor_ != nullptr && !withoutInputQueue_) {
+        if (inputQueue_ == nullptr) {
+            LogFatal << "Invalid input queue of " << moduleName_ << "[" << instanceId_ << "].";
+            return APP_ERR_COMM_INVALID_POINTER;
+        }
+        ApplyCpuAffinity();
+        Schedule();
+        return APP_ERR_OK;
+    }
+    if (runInSteps_ && eventLoop_ != nullptr) {
+        {
+            std::unique_lock<std::mutex> lock(stepMutex_);
+            isStepping_ = true;
+        }
+        APP_ERROR ret = eventLoop_->Schedule(static_cast<uint32_t>(instanceId_), 0, -1, 0, [this]() { RunStep(); });
+        if (ret != APP_ERR_OK) {
+            LogFatal << "Fail to schedule the first step of " << moduleName_ << "[" << instanceId_ << "].";
+            FinishSteps();
+        }
+        return ret;
+    }
     processThr_ = std::thread(&ModuleBase::ProcessThread, this);
+    ApplyCpuAffinity();
     return APP_ERR_OK;
 }
 
+void ModuleBase::SetCpuAffinity(const std::vector<uint32_t> &cpuList)
+{
+    cpuList_ = cpuList;
+}
+
+void ModuleBase::RegisterThread(pthread_t thread)
+{
+    extraThreads_.push_back(thread);
+}
+
+// the instances running on the executor only have their extra threads, the workers follow SystemConfig.numaNode
+void ModuleBase::ApplyCpuAffinity()
+{
+    if (cpuList_.empty()) {
+        return;
+    }
+    std::vector<pthread_t> threads = extraThreads_;
+    if (processThr_.joinable()) {
+        threads.push_back(processThr_.native_handle());
+    }
+    for (auto thread : threads) {
+        if (SetThreadAffinity(thread, cpuList_) != APP_ERR_OK) {
+            LogWarn << "Fail to set the cpu affinity of " << moduleName_ << "[" << instanceId_ << "].";
+        }
+    }
+}
+
 // get the data from input queue then call Process function in the new thread
 void ModuleBase::ProcessThread()
 {
@@ -56,6 +149,10 @@ void ModuleBase::ProcessThread()
         return;
     }
 #endif
+    if (withoutInputQueue_ && runInSteps_) {
+        RunStepsInThread();
+        return;
+    }
     // if the module has no input queue, call Process function directly.
     if (withoutInputQueue_ == true) {
         ret = Process(nullptr);
@@ -71,30 +168,374 @@ void ModuleBase::ProcessThread()
     }
     LogDebug << "Input queue for " << moduleName_ << "[" << instanceId_ << "], inputQueue=" << inputQueue_;
     // repeatly pop data from input queue and call the Process funtion. Results will be pushed to output queues.
+    std::vector<std::shared_ptr<void>> frameInfoVec;
     while (!isStop_) {
-        std::shared_ptr<void> frameInfo = nullptr;
-        ret = inputQueue_->Pop(frameInfo);
+        if (reorderHeldCount_ > 0 && reorderTimeoutUs_ != 0) {
+            ret = inputQueue_->PopBatch(frameInfoVec, maxBatchSize_, GetReorderWaitMs(GetModuleTimeUs()));
+            if (ret == APP_ERR_QUEUE_EMPTY) {
+                // release what waited too long for a missing item
+                frameInfoVec.clear();
+                CallProcessItems(frameInfoVec);
+                continue;
+            }
+        } else if (maxBatchSize_ > 1) {
+            ret = inputQueue_->PopBatch(frameInfoVec, maxBatchSize_);
+            if (ret == APP_ERR_OK && batchTimeoutMs_ > 0) {
+                FillBatch(frameInfoVec);
+            }
+        } else {
+            frameInfoVec.resize(1);
+            ret = inputQueue_->Pop(frameInfoVec[0]);
+        }
         if (ret == APP_ERR_QUEUE_STOPED) {
             LogDebug << moduleName_ << "[" << instanceId_ << "] input queue Stopped";
             break;
-        } else if (ret != APP_ERR_OK || frameInfo == nullptr) {
+        } else if (ret != APP_ERR_OK || frameInfoVec.empty() || frameInfoVec[0] == nullptr) {
             LogError << "Fail to get data from input queue for " << moduleName_ << "[" << instanceId_ << "]"
                      << ", ret=" << ret << "(" << GetAppErrCodeInfo(ret) << ").";
             continue;
         }
-        CallProcess(frameInfo);
+        CallProcessItems(frameInfoVec);
+        frameInfoVec.clear();
     }
     LogInfo << moduleName_ << "[" << instanceId_ << "] process thread End";
 }
 
+APP_ERROR ModuleBase::ProcessStep(ModuleWaitInfo &waitInfo)
+{
+    waitInfo.type = MODULE_WAIT_DONE;
+    return APP_ERR_OK;
+}
+
+APP_ERROR ModuleBase::CallProcessStep(ModuleWaitInfo &waitInfo)
+{
+    uint64_t traceStartNs = ModuleTracer::IsEnabled() ? ModuleTracer::GetInstance().GetTimeNs() : 0;
+    APP_ERROR ret = ProcessStep(waitInfo);
+    if (traceStartNs != 0) {
+        ModuleTracer &tracer = ModuleTracer::GetInstance();
+        tracer.Record(MODULE_TRACE_PROCESS, traceTrackId_, traceStartNs, tracer.GetTimeNs(), false, 0, 0);
+    }
+    if (ret != APP_ERR_OK) {
+        LogError << "Fail to process step for " << moduleName_ << "[" << instanceId_ << "]"
+                 << ", ret=" << ret << "(" << GetAppErrCodeInfo(ret) << ").";
+    }
+    return ret;
+}
+
+// step mode without event loop: the thread of the instance sleeps or polls the fd between the steps
+void ModuleBase::RunStepsInThread()
+{
+    while (!isStop_) {
+        ModuleWaitInfo waitInfo;
+        if (CallProcessStep(waitInfo) != APP_ERR_OK || waitInfo.type == MODULE_WAIT_DONE) {
+            break;
+        }
+        if (waitInfo.type == MODULE_WAIT_TIMER) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitInfo.timeoutMs));
+        } else if (waitInfo.type == MODULE_WAIT_FD) {
+            struct pollfd pollFd = {};
+            pollFd.fd = waitInfo.fd;
+            pollFd.events = static_cast<short>(waitInfo.fdEvents);
+            uint32_t timeoutMs = (waitInfo.timeoutMs == 0) ? MODULE_STEP_MAX_WAIT_MS : waitInfo.timeoutMs;
+            poll(&pollFd, 1, static_cast<int>(timeoutMs));
+        }
+    }
+    LogInfo << moduleName_ << "[" << instanceId_ << "] process thread End";
+}
+
+// one step on the event loop, which then schedules the next one according to the wait
+void ModuleBase::RunStep()
+{
+    ModuleWaitInfo waitInfo;
+    if (isStop_ || CallProcessStep(waitInfo) != APP_ERR_OK || waitInfo.type == MODULE_WAIT_DONE || isStop_) {
+        FinishSteps();
+        return;
+    }
+    uint32_t delayMs = 0;
+    int fd = -1;
+    if (waitInfo.type == MODULE_WAIT_TIMER) {
+        delayMs = waitInfo.timeoutMs;
+    } else if (waitInfo.type == MODULE_WAIT_FD) {
+        delayMs = (waitInfo.timeoutMs == 0) ? MODULE_STEP_MAX_WAIT_MS : waitInfo.timeoutMs;
+        fd = waitInfo.fd;
+    }
+    if (eventLoop_->Schedule(static_cast<uint32_t>(instanceId_), delayMs, fd, waitInfo.fdEvents,
+        [this]() { RunStep(); }) != APP_ERR_OK) {
+        LogError << "Fail to schedule the next step of " << moduleName_ << "[" << instanceId_ << "].";
+        FinishSteps();
+    }
+}
+
+void ModuleBase::FinishSteps()
+{
+    {
+        std::unique_lock<std::mutex> lock(stepMutex_);
+        isStepping_ = false;
+    }
+    stepCond_.notify_all();
+    LogInfo << moduleName_ << "[" << instanceId_ << "] steps End";
+}
+
+// Waits up to batchTimeoutMs_ from the first item for more items, so that a module which processes the items of a
+// batch at one time, such as an inference on several frames, gets full batches at low input rates too. The workers
+// of the executor don't wait, they batch what is queued.
+void ModuleBase::FillBatch(std::vector<std::shared_ptr<void>> &frameInfoVec)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(batchTimeoutMs_);
+    std::vector<std::shared_ptr<void>> moreItems;
+    while (frameInfoVec.size() < maxBatchSize_ && !isStop_) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        // round up, the queue waits in milliseconds
+        auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now +
+            std::chrono::microseconds(999)).count();
+        APP_ERROR ret = inputQueue_->PopBatch(moreItems, maxBatchSize_ - frameInfoVec.size(),
+            static_cast<unsigned int>(waitMs));
+        if (ret == APP_ERR_QUEUE_STOPED) {
+            break;
+        }
+        if (ret == APP_ERR_OK) {
+            frameInfoVec.insert(frameInfoVec.end(), moreItems.begin(), moreItems.end());
+        }
+    }
+}
+
+void ModuleBase::Schedule()
+{
+    int expected = MODULE_TASK_IDLE;
+    if (executor_ != nullptr && taskState_.compare_exchange_strong(expected, MODULE_TASK_QUEUED)) {
+        executor_->Submit(this);
+    }
+}
+
+// Only one thread runs the task of an instance at a time, so the modules keep the single thread model of
+// ProcessThread. The deques may hold several entries of one instance, the entries which find it not queued
+// anymore are skipped.
+bool ModuleBase::RunTask()
+{
+    int expected = MODULE_TASK_QUEUED;
+    if (!taskState_.compare_exchange_strong(expected, MODULE_TASK_RUNNING)) {
+        return false;
+    }
+    if (!isStop_) {
+        ProcessTask();
+    }
+    taskState_ = MODULE_TASK_IDLE;
+    NotifyTaskProgress();
+    // the items pushed while running didn't queue the task
+    if (!isStop_ && !inputQueue_->IsEmpty()) {
+        Schedule();
+    }
+    return true;
+}
+
+// process what is in the input queue without waiting, up to MODULE_TASK_QUANTUM items
+void ModuleBase::ProcessTask()
+{
+    std::vector<std::shared_ptr<void>> frameInfoVec;
+    uint32_t processedCount = 0;
+    while (processedCount < MODULE_TASK_QUANTUM && !isStop_) {
+        APP_ERROR ret = inputQueue_->PopBatch(frameInfoVec, maxBatchSize_, 0);
+        if (ret != APP_ERR_OK || frameInfoVec.empty()) {
+            break;
+        }
+        NotifyTaskProgress();
+        processedCount += frameInfoVec.size();
+        CallProcessItems(frameInfoVec);
+        frameInfoVec.clear();
+    }
+}
+
+void ModuleBase::CallProcessItems(std::vector<std::shared_ptr<void>> &sendDataVec)
+{
+    // the joined messages are checked once unwrapped, see JoinInput
+    if (maxFrameAgeUs_ != 0 && messageInfoGetter_ != nullptr && joinPortCount_ <= 1) {
+        sendDataVec.erase(std::remove_if(sendDataVec.begin(), sendDataVec.end(),
+            [this](const std::shared_ptr<void> &sendData) { return DropStaleInput(sendData); }), sendDataVec.end());
+    }
+    if (reorderWindow_ != 0 && joinPortCount_ <= 1) {
+        ReorderInput(sendDataVec);
+    }
+    if (sendDataVec.empty()) {
+        return;
+    }
+    if (joinPortCount_ > 1) {
+        for (auto &sendData : sendDataVec) {
+            JoinInput(sendData);
+        }
+    } else if (maxBatchSize_ > 1) {
+        CallProcessBatch(sendDataVec);
+    } else {
+        // one item, or what the reorder buffer released
+        for (auto &sendData : sendDataVec) {
+            CallProcess(sendData);
+        }
+    }
+}
+
+void ModuleBase::ProcessFused(const std::shared_ptr<void> &inputData)
+{
+    std::lock_guard<std::mutex> lock(fusedMutex_);
+    if (isStop_) {
+        OnInputDropped(inputData);
+        return;
+    }
+    std::vector<std::shared_ptr<void>> inputDataVec(1, inputData);
+    CallProcessItems(inputDataVec);
+}
+
+bool ModuleBase::GetSequenceInfo(const std::shared_ptr<void> &message, uint32_t &channelId, uint64_t &sequenceId)
+{
+    ModuleMessageInfo info;
+    if (messageInfoGetter_ == nullptr || !messageInfoGetter_(message, info)) {
+        return false;
+    }
+    channelId = info.channelId;
+    sequenceId = info.sequenceId;
+    return true;
+}
+
+// replaces the items with the ones released in order, the held ones included
+void ModuleBase::ReorderInput(std::vector<std::shared_ptr<void>> &sendDataVec)
+{
+    uint64_t nowUs = GetModuleTimeUs();
+    std::vector<std::shared_ptr<void>> releasedVec;
+    for (auto &sendData : sendDataVec) {
+        uint32_t channelId = 0;
+        uint64_t sequenceId = 0;
+        if (!GetSequenceInfo(sendData, channelId, sequenceId)) {
+            releasedVec.push_back(sendData);
+            continue;
+        }
+        ModuleReorderChannel &channel = reorderChannelMap_[channelId];
+        if (sequenceId < channel.nextSequenceId) {
+            reorderLateCount_++;
+            releasedVec.push_back(sendData);
+            continue;
+        }
+        if (channel.pendingMap.empty()) {
+            channel.waitStartUs = nowUs;
+        }
+        if (channel.pendingMap.insert(std::make_pair(sequenceId, sendData)).second) {
+            reorderHeldCount_++;
+        }
+        ReleaseReorderChannel(channel, nowUs, releasedVec);
+    }
+    // the channels which got nothing may have waited too long
+    if (reorderTimeoutUs_ != 0 && reorderHeldCount_ > 0) {
+        for (auto &channel : reorderChannelMap_) {
+            ReleaseReorderChannel(channel.second, nowUs, releasedVec);
+        }
+    }
+    sendDataVec.swap(releasedVec);
+}
+
+void ModuleBase::ReleaseReorderChannel(ModuleReorderChannel &channel, uint64_t nowUs,
+    std::vector<std::shared_ptr<void>> &releasedVec)
+{
+    while (!channel.pendingMap.empty()) {
+        auto first = channel.pendingMap.begin();
+        if (first->first != channel.nextSequenceId) {
+            bool isGivenUp = (channel.pendingMap.size() > reorderWindow_) ||
+                (reorderTimeoutUs_ != 0 && nowUs >= channel.waitStartUs + reorderTimeoutUs_);
+            if (!isGivenUp) {
+                break;
+            }
+            reorderSkipCount_ += first->first - channel.nextSequenceId;
+        }
+        channel.nextSequenceId = first->first + 1;
+        channel.waitStartUs = nowUs;
+        releasedVec.push_back(first->second);
+        channel.pendingMap.erase(first);
+        reorderHeldCount_--;
+    }
+}
+
+// time until the first channel gives up its missing item, at least 1 ms
+unsigned int ModuleBase::GetReorderWaitMs(uint64_t nowUs) const
+{
+    uint64_t waitUs = reorderTimeoutUs_;
+    for (auto &channel : reorderChannelMap_) {
+        if (channel.second.pendingMap.empty()) {
+            continue;
+        }
+        uint64_t endUs = channel.second.waitStartUs + reorderTimeoutUs_;
+        waitUs = std::min(waitUs, (endUs > nowUs) ? (endUs - nowUs) : 0);
+    }
+    return static_cast<unsigned int>(std::max(waitUs / US_PER_MS, static_cast<uint64_t>(1)));
+}
+
+void ModuleBase::JoinInput(const std::shared_ptr<void> &message)
+{
+    auto joinMessage = std::static_pointer_cast<ModuleJoinMessage>(message);
+    ModuleMessageInfo info;
+    if (!messageInfoGetter_(joinMessage->data, info)) {
+        CallProcess(joinMessage->data);
+        return;
+    }
+    ModuleTracer &tracer = ModuleTracer::GetInstance();
+    if (ModuleTracer::IsEnabled()) {
+        uint64_t timeNs = tracer.GetTimeNs();
+        tracer.Record(MODULE_TRACE_DEQUEUE, traceTrackId_, timeNs, timeNs, true, info.channelId, info.frameId);
+    }
+    // the other inputs of the frame are stale too when they arrive, or ProcessJoin gets nullptr for this one
+    if (maxFrameAgeUs_ != 0 && DropStaleInput(joinMessage->data)) {
+        return;
+    }
+
+    auto key = std::make_pair(info.channelId, info.frameId);
+    auto &inputDataVec = joinPendingMap_[key];
+    inputDataVec.resize(joinPortCount_);
+    inputDataVec[joinMessage->port % joinPortCount_] = joinMessage->data;
+    if (std::find(inputDataVec.begin(), inputDataVec.end(), nullptr) != inputDataVec.end()) {
+        return;
+    }
+
+    // the frames of the channel before this one won't get their missing inputs anymore
+    auto iter = joinPendingMap_.lower_bound(std::make_pair(info.channelId, static_cast<uint64_t>(0)));
+    while (iter != joinPendingMap_.end()) {
+        bool isLast = (iter->first == key);
+        uint64_t traceStartNs = ModuleTracer::IsEnabled() ? tracer.GetTimeNs() : 0;
+        APP_ERROR ret = ProcessJoin(iter->second);
+        if (traceStartNs != 0) {
+            tracer.Record(MODULE_TRACE_PROCESS, traceTrackId_, traceStartNs, tracer.GetTimeNs(), true,
+                iter->first.first, iter->first.second);
+        }
+        if (ret != APP_ERR_OK) {
+            LogError << "Fail to process joined data for " << moduleName_ << "[" << instanceId_ << "]"
+                     << ", ret=" << ret << "(" << GetAppErrCodeInfo(ret) << ").";
+        }
+        iter = joinPendingMap_.erase(iter);
+        if (isLast) {
+            break;
+        }
+    }
+}
+
+APP_ERROR ModuleBase::ProcessJoin(std::vector<std::shared_ptr<void>> &inputDataVec)
+{
+    LogError << moduleName_ << " joins several connects but doesn't implement ProcessJoin";
+    return APP_ERR_COMM_UNREALIZED;
+}
+
 void ModuleBase::CallProcess(const std::shared_ptr<void> &sendData)
 {
+    ModuleMessageInfo traceInfo;
+    bool hasTraceInfo = false;
+    uint64_t traceStartNs = ModuleTracer::IsEnabled() ? TraceDequeue(sendData, traceInfo, hasTraceInfo) : 0;
     auto startTime = std::chrono::high_resolution_clock::now();
     APP_ERROR ret = Process(sendData);
     auto endTime = std::chrono::high_resolution_clock::now();
+    if (traceStartNs != 0) {
+        ModuleTracer &tracer = ModuleTracer::GetInstance();
+        tracer.Record(MODULE_TRACE_PROCESS, traceTrackId_, traceStartNs, tracer.GetTimeNs(), hasTraceInfo,
+            traceInfo.channelId, traceInfo.frameId);
+    }
     double costMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
     int queueSize = inputQueue_->GetSize();
-    if (queueSize > INPUTQUEUE_WARN_SIZE) {
+    if (queueSize > INPUTQUEUE_WARN_SIZE && IsQueueWarnDue(endTime)) {
         LogWarn << "[Statistic] [Module] [" << moduleName_ << "] [" << instanceId_ << "] [QueueSize] [" << queueSize \
                 << "] [Process] [" << costMs << " ms]";
     }
@@ -105,8 +546,86 @@ void ModuleBase::CallProcess(const std::shared_ptr<void> &sendData)
     }
 }
 
+void ModuleBase::CallProcessBatch(std::vector<std::shared_ptr<void>> &sendDataVec)
+{
+    uint64_t traceStartNs = 0;
+    if (ModuleTracer::IsEnabled()) {
+        ModuleMessageInfo traceInfo;
+        bool hasTraceInfo = false;
+        for (auto &sendData : sendDataVec) {
+            traceStartNs = TraceDequeue(sendData, traceInfo, hasTraceInfo);
+        }
+    }
+    auto startTime = std::chrono::high_resolution_clock::now();
+    APP_ERROR ret = ProcessBatch(sendDataVec);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    if (traceStartNs != 0) {
+        ModuleTracer &tracer = ModuleTracer::GetInstance();
+        tracer.Record(MODULE_TRACE_PROCESS, traceTrackId_, traceStartNs, tracer.GetTimeNs(), false, 0, 0);
+    }
+    double costMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    int queueSize = inputQueue_->GetSize();
+    if (queueSize > INPUTQUEUE_WARN_SIZE && IsQueueWarnDue(endTime)) {
+        LogWarn << "[Statistic] [Module] [" << moduleName_ << "] [" << instanceId_ << "] [QueueSize] [" << queueSize \
+                << "] [Batch] [" << sendDataVec.size() << "] [Process] [" << costMs << " ms]";
+    }
+
+    if (ret != APP_ERR_OK) {
+        LogError << "Fail to process batch data for " << moduleName_ << "[" << instanceId_ << "]"
+                 << ", ret=" << ret << "(" << GetAppErrCodeInfo(ret) << ").";
+    }
+}
+
+uint64_t ModuleBase::TraceDequeue(const std::shared_ptr<void> &data, ModuleMessageInfo &info, bool &hasInfo)
+{
+    ModuleTracer &tracer = ModuleTracer::GetInstance();
+    uint64_t timeNs = tracer.GetTimeNs();
+    hasInfo = (data != nullptr && messageInfoGetter_ != nullptr && messageInfoGetter_(data, info));
+    if (hasInfo) {
+        tracer.Record(MODULE_TRACE_DEQUEUE, traceTrackId_, timeNs, timeNs, true, info.channelId, info.frameId);
+    }
+    return timeNs;
+}
+
+// recorded before the push, so that the wait includes the time the sender is blocked by a full queue
+void ModuleBase::TraceEnqueue(const ModuleOutputInfo &outputInfo, uint32_t queueIndex,
+    const std::shared_ptr<void> &outputData)
+{
+    ModuleMessageInfo info;
+    if (queueIndex >= outputInfo.traceTrackVec.size() || messageInfoGetter_ == nullptr ||
+        !messageInfoGetter_(outputData, info)) {
+        return;
+    }
+    ModuleTracer &tracer = ModuleTracer::GetInstance();
+    uint64_t timeNs = tracer.GetTimeNs();
+    tracer.Record(MODULE_TRACE_ENQUEUE, outputInfo.traceTrackVec[queueIndex], timeNs, timeNs, true, info.channelId,
+        info.frameId);
+}
+
+bool ModuleBase::IsQueueWarnDue(const std::chrono::high_resolution_clock::time_point &now)
+{
+    if (std::chrono::duration<double, std::milli>(now - lastQueueWarnTime_).count() < INPUTQUEUE_WARN_INTERVAL_MS) {
+        return false;
+    }
+    lastQueueWarnTime_ = now;
+    return true;
+}
+
+APP_ERROR ModuleBase::ProcessBatch(std::vector<std::shared_ptr<void>> &inputDataVec)
+{
+    APP_ERROR result = APP_ERR_OK;
+    for (auto &inputData : inputDataVec) {
+        APP_ERROR ret = Process(inputData);
+        if (ret != APP_ERR_OK) {
+            result = ret;
+        }
+    }
+    return result;
+}
+
 void ModuleBase::SetOutputInfo(std::string moduleName, ModuleConnectType connectType,
-    std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> outputQueVec)
+    std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> outputQueVec,
+    ModuleOverflowPolicy overflowPolicy, uint32_t keepLatestNum)
 {
     if (outputQueVec.size() == 0) {
         LogFatal << "outputQueVec is Empty! " << moduleName;
@@ -118,9 +637,75 @@ void ModuleBase::SetOutputInfo(std::string moduleName, ModuleConnectType connect
     outputInfo.connectType = connectType;
     outputInfo.outputQueVec = outputQueVec;
     outputInfo.outputQueVecSize = outputQueVec.size();
+    outputInfo.overflowPolicy = overflowPolicy;
+    outputInfo.keepLatestNum = (keepLatestNum == 0) ? 1 : keepLatestNum;
+    for (size_t i = 0; i < outputQueVec.size(); i++) {
+        outputInfo.traceTrackVec.push_back(
+            ModuleTracer::GetInstance().RegisterTrack(moduleName + "[" + std::to_string(i) + "]"));
+    }
     outputQueMap_[moduleName] = outputInfo;
 }
 
+void ModuleBase::SetOutputModules(std::string moduleName, const std::vector<ModuleBase *> &outputModuleVec)
+{
+    auto iter = outputQueMap_.find(moduleName);
+    if (iter == outputQueMap_.end() || iter->second.outputQueVecSize != outputModuleVec.size()) {
+        LogFatal << "outputModuleVec doesn't match the output queues! " << moduleName;
+        return;
+    }
+    iter->second.outputModuleVec = outputModuleVec;
+}
+
+void ModuleBase::SetOutputJoinPort(std::string moduleName, int joinPort)
+{
+    auto iter = outputQueMap_.find(moduleName);
+    if (iter == outputQueMap_.end()) {
+        LogFatal << "No Next Module " << moduleName;
+        return;
+    }
+    iter->second.joinPort = joinPort;
+}
+
+void ModuleBase::SetOutputFused(std::string moduleName)
+{
+    auto iter = outputQueMap_.find(moduleName);
+    if (iter == outputQueMap_.end() || iter->second.outputModuleVec.size() != iter->second.outputQueVecSize) {
+        LogFatal << "No output modules to fuse with " << moduleName;
+        return;
+    }
+    iter->second.fused = true;
+}
+
+void ModuleBase::SetFusedInput()
+{
+    isFusedInput_ = true;
+}
+
+void ModuleBase::SetOutputSegment(std::string moduleName, std::shared_ptr<ShmSegment> segment)
+{
+    auto iter = outputQueMap_.find(moduleName);
+    if (iter == outputQueMap_.end()) {
+        LogFatal << "No Next Module " << moduleName;
+        return;
+    }
+    iter->second.shmSegment = segment;
+}
+
+void ModuleBase::SetExternalInput()
+{
+    executor_ = nullptr;
+}
+
+void ModuleBase::SetJoinInfo(uint32_t joinPortCount)
+{
+    joinPortCount_ = joinPortCount;
+}
+
+void ModuleBase::SetMessageInfoGetter(ModuleMessageInfoGetter messageInfoGetter)
+{
+    messageInfoGetter_ = messageInfoGetter;
+}
+
 const std::string ModuleBase::GetModuleName()
 {
     return moduleName_;
@@ -131,45 +716,283 @@ const int ModuleBase::GetInstanceId()
     return instanceId_;
 }
 
-void ModuleBase::SetInputVec(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> inputQueue)
+bool ModuleBase::IsSingleSendThread() const
+{
+    return isSingleSendThread_;
+}
+
+bool ModuleBase::IsChannelPerInstance() const
+{
+    return isChannelPerInstance_;
+}
+
+void ModuleBase::SetInputVec(std::shared_ptr<ItemQueue<std::shared_ptr<void>>> inputQueue)
 {
     inputQueue_ = inputQueue;
 }
 
-void ModuleBase::SendToNextModule(std::string moduleName, std::shared_ptr<void> outputData, int channelId)
+void ModuleBase::SendToNextModule(const std::string &moduleName, std::shared_ptr<void> outputData, int channelId)
+{
+    auto itr = outputQueMap_.find(moduleName);
+    if (itr == outputQueMap_.end()) {
+        LogFatal << "No Next Module " << moduleName;
+        return;
+    }
+    SendToNextModule(&itr->second, outputData, channelId);
+}
+
+void ModuleBase::SendToNextModule(ModuleOutputHandle outputHandle, std::shared_ptr<void> outputData, int channelId)
 {
     if (isStop_) {
         LogDebug << moduleName_ << "[" << instanceId_ << "] is Stopped, can't send to next module";
         return;
     }
 
-    if (outputQueMap_.find(moduleName) == outputQueMap_.end()) {
-        LogFatal << "No Next Module " << moduleName;
+    if (outputHandle == nullptr) {
+        LogFatal << "No Next Module!";
         return;
     }
 
+    if (outputHandle->connectType == MODULE_CONNECT_BROADCAST) {
+        for (uint32_t i = 0; i < outputHandle->outputQueVecSize; i++) {
+            if (ModuleTracer::IsEnabled()) {
+                TraceEnqueue(*outputHandle, i, outputData);
+            }
+            PushToNextModule(*outputHandle, i, outputData);
+        }
+    } else {
+        uint32_t queueIndex = SelectOutputQueue(*outputHandle, channelId);
+        if (ModuleTracer::IsEnabled()) {
+            TraceEnqueue(*outputHandle, queueIndex, outputData);
+        }
+        PushToNextModule(*outputHandle, queueIndex, outputData);
+    }
+    sendCount_++;
+}
+
+void ModuleBase::SendToAllNextModules(std::shared_ptr<void> outputData, int channelId)
+{
+    for (auto &output : outputQueMap_) {
+        SendToNextModule(&output.second, outputData, channelId);
+    }
+}
+
+ModuleOutputHandle ModuleBase::GetOutputHandle(const std::string &moduleName) const
+{
     auto itr = outputQueMap_.find(moduleName);
-    if (itr == outputQueMap_.end()) {
-        LogFatal << "No Next Module " << moduleName;
+    return (itr == outputQueMap_.end()) ? nullptr : &itr->second;
+}
+
+// the load of a receiver is the depth of its input queue
+uint32_t ModuleBase::SelectOutputQueue(const ModuleOutputInfo &outputInfo, int channelId)
+{
+    uint32_t queueCount = outputInfo.outputQueVecSize;
+    const auto &outputQueVec = outputInfo.outputQueVec;
+    if (outputInfo.connectType == MODULE_CONNECT_CHANNEL) {
+        return static_cast<uint32_t>(channelId) % queueCount;
+    } else if (outputInfo.connectType == MODULE_CONNECT_PAIR) {
+        return instanceId_;
+    } else if (outputInfo.connectType == MODULE_CONNECT_RANDOM) {
+        return sendCount_ % queueCount;
+    } else if (outputInfo.connectType == MODULE_CONNECT_LEAST_LOADED) {
+        // the scan starts at the round robin position so that the ties are spread over the receivers
+        uint32_t selected = sendCount_ % queueCount;
+        int selectedSize = outputQueVec[selected]->GetSize();
+        for (uint32_t i = 1; i < queueCount && selectedSize > 0; i++) {
+            uint32_t index = (sendCount_ + i) % queueCount;
+            int size = outputQueVec[index]->GetSize();
+            if (size < selectedSize) {
+                selected = index;
+                selectedSize = size;
+            }
+        }
+        return selected;
+    } else if (outputInfo.connectType == MODULE_CONNECT_TWO_CHOICES && queueCount > 1) {
+        uint32_t first = NextRandom() % queueCount;
+        uint32_t second = NextRandom() % (queueCount - 1);
+        second = (second >= first) ? second + 1 : second;
+        return (outputQueVec[second]->GetSize() < outputQueVec[first]->GetSize()) ? second : first;
+    }
+    return 0;
+}
+
+// xorshift32, good enough to draw the receivers
+uint32_t ModuleBase::NextRandom()
+{
+    const uint32_t shift1 = 13;
+    const uint32_t shift2 = 17;
+    const uint32_t shift3 = 5;
+    randomState_ ^= randomState_ << shift1;
+    randomState_ ^= randomState_ >> shift2;
+    randomState_ ^= randomState_ << shift3;
+    return randomState_;
+}
+
+void ModuleBase::PushToNextModule(const ModuleOutputInfo &outputInfo, uint32_t queueIndex,
+    const std::shared_ptr<void> &outputData)
+{
+    // the fused connects have no join and no overflow, see ModuleManager::ResolveQueueType
+    if (outputInfo.fused) {
+        outputInfo.outputModuleVec[queueIndex]->ProcessFused(outputData);
+        return;
+    }
+    const std::shared_ptr<ItemQueue<std::shared_ptr<void>>> &outputQueue = outputInfo.outputQueVec[queueIndex];
+    // the connects of a join always block, see ModuleManager::CheckJoin
+    if (outputInfo.joinPort >= 0) {
+        auto joinMessage = std::make_shared<ModuleJoinMessage>();
+        joinMessage->port = static_cast<uint32_t>(outputInfo.joinPort);
+        joinMessage->data = outputData;
+        PushWaiting(outputInfo, queueIndex, joinMessage);
+        return;
+    }
+    if (outputInfo.overflowPolicy == MODULE_OVERFLOW_BLOCK || !IsDroppable(outputData)) {
+        PushWaiting(outputInfo, queueIndex, outputData);
         return;
     }
-    ModuleOutputInfo outputInfo = itr->second;
 
-    if (outputInfo.connectType == MODULE_CONNECT_ONE) {
-        outputInfo.outputQueVec[0]->Push(outputData, true);
-    } else if (outputInfo.connectType == MODULE_CONNECT_CHANNEL) {
-        uint32_t ch = channelId % outputInfo.outputQueVecSize;
-        if (ch >= outputInfo.outputQueVecSize) {
-            LogFatal << "No Next Module!";
-            return;
+    if (outputInfo.overflowPolicy == MODULE_OVERFLOW_DROP_NEWEST) {
+        if (outputQueue->Push(outputData, false) == APP_ERROR_QUEUE_FULL) {
+            outputQueue->AddDropCount(1);
+            OnDropped(outputData);
+        } else if (queueIndex < outputInfo.outputModuleVec.size()) {
+            outputInfo.outputModuleVec[queueIndex]->Schedule();
         }
-        outputInfo.outputQueVec[ch]->Push(outputData, true);
-    } else if (outputInfo.connectType == MODULE_CONNECT_PAIR) {
-        outputInfo.outputQueVec[instanceId_]->Push(outputData, true);
-    } else if (outputInfo.connectType == MODULE_CONNECT_RANDOM) {
-        outputInfo.outputQueVec[sendCount_ % outputInfo.outputQueVecSize]->Push(outputData, true);
+        return;
+    }
+
+    uint32_t maxItems = (outputInfo.overflowPolicy == MODULE_OVERFLOW_KEEP_LATEST) ? outputInfo.keepLatestNum :
+        UINT32_MAX;
+    std::vector<std::shared_ptr<void>> evictedItems;
+    APP_ERROR ret = outputQueue->PushEvictOldest(outputData, maxItems, evictedItems);
+    if (ret != APP_ERR_OK && ret != APP_ERR_QUEUE_STOPED) {
+        LogError << moduleName_ << "[" << instanceId_ << "] fail to push to " << outputInfo.moduleName << ", ret = " <<
+            ret;
+    }
+    if (ret == APP_ERR_OK && queueIndex < outputInfo.outputModuleVec.size()) {
+        outputInfo.outputModuleVec[queueIndex]->Schedule();
+    }
+    for (auto &evictedItem : evictedItems) {
+        // the marks evicted with the frames are queued again behind the item just sent
+        if (!IsDroppable(evictedItem)) {
+            PushWaiting(outputInfo, queueIndex, evictedItem);
+            continue;
+        }
+        outputQueue->AddDropCount(1);
+        OnDropped(evictedItem);
     }
-    sendCount_++;
+}
+
+// With the executor, waiting on a full queue would hold a worker which may be the one needed to empty it, so
+// the producer runs the queued task of the next module itself, or parks until the thread running it pops items
+// or goes idle. The pipeline is acyclic, so this only goes downstream and always ends at a module which doesn't
+// wait.
+APP_ERROR ModuleBase::PushWaiting(const ModuleOutputInfo &outputInfo, uint32_t queueIndex,
+    const std::shared_ptr<void> &outputData)
+{
+    const std::shared_ptr<ItemQueue<std::shared_ptr<void>>> &outputQueue = outputInfo.outputQueVec[queueIndex];
+    // the receivers without the executor, such as the reordering ones, run on their own thread
+    if (queueIndex >= outputInfo.outputModuleVec.size() || outputInfo.outputModuleVec[queueIndex]->executor_ ==
+        nullptr) {
+        APP_ERROR ret = outputQueue->Push(outputData, true);
+        if (ret == APP_ERR_OK && queueIndex < outputInfo.outputModuleVec.size()) {
+            outputInfo.outputModuleVec[queueIndex]->Schedule();
+        }
+        return ret;
+    }
+
+    ModuleBase *nextModule = outputInfo.outputModuleVec[queueIndex];
+    // A worker runs the task of the next module itself rather than wait for another worker. The other threads, such
+    // as the report thread of a decoder, only wait: the task must run on the workers, with their context and cpus.
+    bool isWorker = nextModule->executor_->IsWorkerThread();
+    // read before the push, a pop between the failed push and the wait changes it
+    uint64_t progress = nextModule->taskProgress_.load(std::memory_order_seq_cst);
+    APP_ERROR ret = outputQueue->Push(outputData, false);
+    while (ret == APP_ERROR_QUEUE_FULL) {
+        nextModule->Schedule();
+        if (!isWorker || !nextModule->RunTask()) {
+            nextModule->WaitTaskProgress(progress);
+        }
+        progress = nextModule->taskProgress_.load(std::memory_order_seq_cst);
+        ret = outputQueue->Push(outputData, false);
+    }
+    if (ret == APP_ERR_OK) {
+        nextModule->Schedule();
+    }
+    return ret;
+}
+
+// only locks when a thread waits in WaitTaskProgress
+void ModuleBase::NotifyTaskProgress()
+{
+    taskProgress_.fetch_add(1, std::memory_order_seq_cst);
+    if (taskWaiters_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        taskCond_.notify_all();
+    }
+}
+
+// waits until the task pops items or stops running, progress is taskProgress_ read before checking the task
+void ModuleBase::WaitTaskProgress(uint64_t progress)
+{
+    taskWaiters_.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(taskMutex_);
+        taskCond_.wait(lock, [this, progress]() {
+            return taskProgress_.load(std::memory_order_seq_cst) != progress ||
+                taskState_.load(std::memory_order_seq_cst) != MODULE_TASK_RUNNING;
+        });
+    }
+    taskWaiters_.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+bool ModuleBase::IsDroppable(const std::shared_ptr<void> &outputData)
+{
+    return true;
+}
+
+void ModuleBase::OnInputDropped(const std::shared_ptr<void> &inputData)
+{
+    return;
+}
+
+bool ModuleBase::DropStaleInput(const std::shared_ptr<void> &inputData)
+{
+    ModuleMessageInfo info;
+    if (!messageInfoGetter_(inputData, info) || info.timestampUs == 0) {
+        return false;
+    }
+    uint64_t nowUs = GetModuleTimeUs();
+    if (nowUs <= info.timestampUs + maxFrameAgeUs_) {
+        return false;
+    }
+    std::map<uint32_t, uint64_t> droppedCountMap;
+    bool isDropped = DropStaleFrames(inputData, info, nowUs - maxFrameAgeUs_, droppedCountMap);
+    if (isDropped) {
+        OnInputDropped(inputData);
+    }
+    std::unique_lock<std::mutex> lock(staleDropMutex_);
+    for (auto &droppedCount : droppedCountMap) {
+        staleDropCountMap_[droppedCount.first] += droppedCount.second;
+    }
+    return isDropped;
+}
+
+bool ModuleBase::DropStaleFrames(const std::shared_ptr<void> &inputData, const ModuleMessageInfo &info,
+    uint64_t staleBeforeUs, std::map<uint32_t, uint64_t> &droppedCountMap)
+{
+    droppedCountMap[info.channelId]++;
+    return true;
+}
+
+std::map<uint32_t, uint64_t> ModuleBase::GetStaleDropCounts() const
+{
+    std::unique_lock<std::mutex> lock(staleDropMutex_);
+    return staleDropCountMap_;
+}
+
+void ModuleBase::OnDropped(const std::shared_ptr<void> &outputData)
+{
+    return;
 }
 
 // clear input queue and stop the thread of the instance, called before destroy the instance
@@ -185,6 +1008,7 @@ APP_ERROR ModuleBase::Stop()
 
     // stop input queue
     isStop_ = true;
+    NotifyTaskProgress();
 
     if (inputQueue_ != nullptr) {
         inputQueue_->Stop();
@@ -194,6 +1018,45 @@ APP_ERROR ModuleBase::Stop()
         processThr_.join();
     }
 
+    // the next step of the event loop sees isStop_ once its wait ends
+    {
+        std::unique_lock<std::mutex> lock(stepMutex_);
+        stepCond_.wait(lock, [this]() { return !isStepping_; });
+    }
+
+    // the task may be running on a worker of the executor
+    while (taskState_ == MODULE_TASK_RUNNING) {
+        WaitTaskProgress(taskProgress_.load(std::memory_order_seq_cst));
+    }
+    // or the previous module may be calling ProcessFused, the later calls see isStop_
+    {
+        std::lock_guard<std::mutex> lock(fusedMutex_);
+    }
+    joinPendingMap_.clear();
+    if (reorderSkipCount_ > 0 || reorderLateCount_ > 0 || reorderHeldCount_ > 0) {
+        LogWarn << moduleName_ << "[" << instanceId_ << "] gave up " << reorderSkipCount_ << " missing input items, "
+                << reorderLateCount_ << " came later out of order and " << reorderHeldCount_ << " were still held";
+    }
+    for (auto &channel : reorderChannelMap_) {
+        for (auto &pending : channel.second.pendingMap) {
+            OnInputDropped(pending.second);
+        }
+    }
+    reorderChannelMap_.clear();
+
+    if (inputQueue_ != nullptr && inputQueue_->GetDropCount() > 0) {
+        LogWarn << moduleName_ << "[" << instanceId_ << "] dropped " << inputQueue_->GetDropCount() <<
+            " items of the input queue because of overflow";
+    }
+    uint64_t staleDropCount = 0;
+    for (auto &staleDrop : GetStaleDropCounts()) {
+        staleDropCount += staleDrop.second;
+    }
+    if (staleDropCount > 0) {
+        LogWarn << moduleName_ << "[" << instanceId_ << "] dropped " << staleDropCount << " input items older than " <<
+            (maxFrameAgeUs_ / US_PER_MS) << " ms";
+    }
+
     return DeInit();
 }
 }
@@ -17,12 +17,22 @@
 #ifndef INC_MODULE_BASE_H
 #define INC_MODULE_BASE_H
 
+#include <functional>
+#include <pthread.h>
 #include <thread>
 #include <vector>
 #include <map>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include "ConfigParser/ConfigParser.h"
 #include "BlockingQueue/BlockingQueue.h"
+#include "BlockingQueue/ShmBlockingQueue.h"
+#include "ModuleManager/ModuleExecutor.h"
+#include "ModuleManager/ModuleEventLoop.h"
+#include "ModuleManager/MessagePool.h"
+#include "ModuleManager/ModuleTracer.h"
 #ifdef ASCEND_MODULE_USE_ACL
 #include "acl/acl.h"
 #endif
@@ -32,9 +42,67 @@ enum ModuleConnectType {
     MODULE_CONNECT_ONE = 0,
     MODULE_CONNECT_CHANNEL, //
     MODULE_CONNECT_PAIR,    //
-    MODULE_CONNECT_RANDOM   //
+    MODULE_CONNECT_RANDOM,  // round robin
+    MODULE_CONNECT_LEAST_LOADED, // the receiver with the shortest input queue
+    MODULE_CONNECT_TWO_CHOICES,  // the shorter input queue of two receivers drawn at random
+    MODULE_CONNECT_BROADCAST     // every receiver gets the same message, which they must not modify nor release
 };
 
+enum ModuleQueueType {
+    MODULE_QUEUE_AUTO = 0, // MODULE_QUEUE_SPSC when ModuleManager proves one producer per queue, else BLOCKING
+    MODULE_QUEUE_BLOCKING, // list based queue guarded by one mutex
+    MODULE_QUEUE_RING,     // preallocated lock-free ring queue, see RingBlockingQueue
+    MODULE_QUEUE_SPSC,     // wait-free ring for one producer and one consumer, see SpscBlockingQueue
+    MODULE_QUEUE_DEADLINE, // earliest deadline first queue, needs the message info getter of the ModuleManager
+    MODULE_QUEUE_FUSED,    // no queue, the sender calls Process of the receiver on its own thread, see ProcessFused
+    MODULE_QUEUE_SHM,      // descriptors in shared memory, for the connects between processes, see ShmBlockingQueue
+    MODULE_QUEUE_SPILL     // items past the capacity appended to files instead of waiting, see SpillBlockingQueue
+};
+
+// what SendToNextModule does when the input queue of the next module is full
+enum ModuleOverflowPolicy {
+    MODULE_OVERFLOW_BLOCK = 0,   // wait until the next module takes an item, nothing is lost
+    MODULE_OVERFLOW_DROP_NEWEST, // drop the item being sent
+    MODULE_OVERFLOW_DROP_OLDEST, // drop the oldest item of the queue to make room for the item being sent
+    MODULE_OVERFLOW_KEEP_LATEST  // drop the oldest items so that only the keepLatestNum newest items are queued
+};
+
+// fields the framework reads from the messages sent between the modules, the messages are opaque to the
+// framework so the application registers a getter filling this structure, see ModuleManager::SetMessageInfoGetter
+struct ModuleMessageInformation {
+    uint32_t channelId = 0;
+    uint64_t frameId = 0;
+    uint64_t timestampUs = 0; // capture or receive time of the frame, in GetModuleTimeUs time
+    uint64_t deadlineUs = 0;  // time after which the result of the frame is useless, 0 if the frame has no deadline
+    uint64_t bytes = 0;       // memory held by the message (device buffers included), counted by the byte budgets
+    uint64_t sequenceId = 0;  // position of the message in its channel, consecutive from 0, for the reorder buffer
+};
+
+using ModuleMessageInfo = ModuleMessageInformation;
+// returns false if the message carries no such information, the end of stream marks for example
+using ModuleMessageInfoGetter = std::function<bool(const std::shared_ptr<void> &message, ModuleMessageInfo &info)>;
+
+// what a module running in steps waits for before its next ProcessStep call
+enum ModuleWaitType {
+    MODULE_WAIT_DONE = 0, // the module has nothing more to do, ProcessStep isn't called anymore
+    MODULE_WAIT_NONE,     // call again as soon as possible, after the steps of the other modules which are due
+    MODULE_WAIT_TIMER,    // call again after timeoutMs
+    MODULE_WAIT_FD        // call again once fd is ready for fdEvents, or after timeoutMs
+};
+
+struct ModuleWaitInformation {
+    ModuleWaitType type = MODULE_WAIT_DONE;
+    uint32_t timeoutMs = 0; // 0 with MODULE_WAIT_FD waits at most MODULE_STEP_MAX_WAIT_MS, so that Stop is seen
+    int fd = -1;
+    uint32_t fdEvents = 0; // POLLIN, POLLOUT
+};
+
+using ModuleWaitInfo = ModuleWaitInformation;
+const uint32_t MODULE_STEP_MAX_WAIT_MS = 100;
+
+// monotonic time in microseconds used for the timestamps and deadlines of the messages
+uint64_t GetModuleTimeUs();
+
 struct ModuleInitArguments {
 #ifdef ASCEND_MODULE_USE_ACL
     aclrtRunMode runMode;
@@ -43,18 +111,45 @@ struct ModuleInitArguments {
     std::string pipelineName = {};
     std::string moduleName = {};
     int instanceId = -1;
+    uint32_t maxBatchSize = 1; // max number of items taken from the input queue for one ProcessBatch call
+    uint32_t batchTimeoutMs = 0; // max wait for a batch to fill up from its first item, thread per instance only
+    uint32_t maxFrameAgeMs = 0; // input items older than this from their timestampUs are dropped, 0 for no limit
+    uint32_t reorderWindow = 0; // max input items held by channel for a missing one, 0 for no reordering
+    uint32_t reorderTimeoutMs = 0; // max wait for a missing input item, 0 for no limit
+    std::shared_ptr<ModuleExecutor> executor = nullptr; // runs Process as tasks, nullptr for a thread per instance
+    std::shared_ptr<MessagePoolSet> messagePools = nullptr; // message pools of the pipeline
+    // runs ProcessStep of the modules running in steps, nullptr for a thread per instance
+    std::shared_ptr<ModuleEventLoop> eventLoop = nullptr;
     void *userData = nullptr;
 };
 
 struct ModuleOutputInformation {
     std::string moduleName = "";
     ModuleConnectType connectType = MODULE_CONNECT_RANDOM;
-    std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> outputQueVec = {};
+    std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> outputQueVec = {};
     uint32_t outputQueVecSize = 0;
+    ModuleOverflowPolicy overflowPolicy = MODULE_OVERFLOW_BLOCK;
+    uint32_t keepLatestNum = 1;
+    // owner of each output queue, only used with the executor and by the fused connects
+    std::vector<ModuleBase *> outputModuleVec = {};
+    bool fused = false; // the data is given to ProcessFused of the receiver instead of its input queue
+    // segment of the shm connects, the sender allocates the payloads from it so that they aren't copied
+    std::shared_ptr<ShmSegment> shmSegment = nullptr;
+    int joinPort = -1; // input of the receiver when it joins several connects, -1 otherwise
+    std::vector<uint32_t> traceTrackVec = {}; // ModuleTracer track of the owner of each output queue
+};
+
+// input items of a channel held by the reorder buffer until the missing ones before them arrive
+struct ModuleReorderChannel {
+    uint64_t nextSequenceId = 0;
+    uint64_t waitStartUs = 0; // since when the buffer waits for nextSequenceId
+    std::map<uint64_t, std::shared_ptr<void>> pendingMap = {};
 };
 
 using ModuleInitArgs = ModuleInitArguments;
 using ModuleOutputInfo = ModuleOutputInformation;
+// resolved once by GetOutputHandle, valid as long as the module instance
+using ModuleOutputHandle = const ModuleOutputInfo *;
 
 class ModuleBase {
 public:
@@ -64,12 +159,44 @@ public:
     virtual APP_ERROR DeInit(void) = 0;
     APP_ERROR Run(void); // create and run process thread
     APP_ERROR Stop(void);
-    void SetInputVec(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> inputQueue);
+    void SetInputVec(std::shared_ptr<ItemQueue<std::shared_ptr<void>>> inputQueue);
     void SetOutputInfo(std::string moduleName, ModuleConnectType connectType,
-        std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> outputQueVec);
-    void SendToNextModule(std::string moduleNext, std::shared_ptr<void> outputData, int channelId = 0);
+        std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> outputQueVec,
+        ModuleOverflowPolicy overflowPolicy = MODULE_OVERFLOW_BLOCK, uint32_t keepLatestNum = 1);
+    void SetOutputModules(std::string moduleName, const std::vector<ModuleBase *> &outputModuleVec);
+    void SendToNextModule(const std::string &moduleNext, std::shared_ptr<void> outputData, int channelId = 0);
+    // same as above without looking up the next module by name, for the modules which send a lot
+    void SendToNextModule(ModuleOutputHandle outputHandle, std::shared_ptr<void> outputData, int channelId = 0);
+    // nullptr if the module isn't connected to moduleNext, call once the pipeline is connected
+    ModuleOutputHandle GetOutputHandle(const std::string &moduleNext) const;
+    // fan out to every connected module, each with the routing of its connect, without copying the message
+    void SendToAllNextModules(std::shared_ptr<void> outputData, int channelId = 0);
+    void SetOutputJoinPort(std::string moduleName, int joinPort);
+    // the connect to moduleName is fused, its output modules must be set, see MODULE_QUEUE_FUSED
+    void SetOutputFused(std::string moduleName);
+    // the instance has no thread nor task, its input comes through ProcessFused
+    void SetFusedInput();
+    void SetOutputSegment(std::string moduleName, std::shared_ptr<ShmSegment> segment);
+    // the input queue is fed by another process, which can't schedule the task of the instance, so the instance
+    // keeps its own thread with the executor
+    void SetExternalInput();
+    // the module joins the messages of joinPortCount connects by (channelId, frameId), see ProcessJoin
+    void SetJoinInfo(uint32_t joinPortCount);
+    // used by the joins and by the tracing to identify the frames
+    void SetMessageInfoGetter(ModuleMessageInfoGetter messageInfoGetter);
+    // executor mode: Schedule queues the task of the instance unless it is already queued or running, RunTask
+    // runs it if it is queued and returns false otherwise
+    void Schedule();
+    bool RunTask();
+    // cpus the threads of the instance run on, applied by Run, empty for no affinity
+    void SetCpuAffinity(const std::vector<uint32_t> &cpuList);
+    // number of input items dropped by maxFrameAgeMs, by channel, can be called while the pipeline is running
+    std::map<uint32_t, uint64_t> GetStaleDropCounts() const;
     const std::string GetModuleName();
     const int GetInstanceId();
+    // what ModuleManager knows of the senders when it looks for the queues with a single producer
+    bool IsSingleSendThread() const;
+    bool IsChannelPerInstance() const;
 
 public:
 #ifdef ASCEND_MODULE_USE_ACL
@@ -79,23 +206,149 @@ public:
 
 protected:
     void ProcessThread();
+    void ProcessTask();
     virtual APP_ERROR Process(std::shared_ptr<void> inputData) = 0;
+    // called with up to maxBatchSize_ items popped at one time, process the items one by one by default
+    virtual APP_ERROR ProcessBatch(std::vector<std::shared_ptr<void>> &inputDataVec);
+    // Join mode: called once every input sent its message of a frame, inputDataVec[i] is the message of input i
+    // (connect order), or nullptr if input i skipped the frame, which shows when a later frame of the channel is
+    // complete first. The inputs must keep the frames of a channel in order. The messages without information
+    // (see ModuleMessageInfoGetter), such as the end of stream marks, are given to Process as they arrive.
+    virtual APP_ERROR ProcessJoin(std::vector<std::shared_ptr<void>> &inputDataVec);
+    // Step mode, for the modules without input queue which set runInSteps_: instead of one Process call which
+    // loops until the end, ProcessStep does a short piece of work without blocking and fills waitInfo with what
+    // to wait for before the next piece. The steps of an instance never run concurrently, they run on the event
+    // loop shared by the instances (SystemConfig.eventLoopThreadNum), or else on the thread of the instance.
+    // ProcessStep must tolerate being called before the fd is ready, when the wait timed out.
+    virtual APP_ERROR ProcessStep(ModuleWaitInfo &waitInfo);
+    APP_ERROR CallProcessStep(ModuleWaitInfo &waitInfo);
+    void RunStepsInThread();
+    void RunStep();
+    void FinishSteps();
+    // Reorder mode (reorderWindow_ > 0): the input items of each channel are processed in the order of their
+    // sequenceId, so that the frames of a channel may be spread over several instances of the previous module. A
+    // missing item is given up once reorderWindow_ later items are held or after reorderTimeoutMs, as it was
+    // probably dropped on the way, and processed as it comes if it comes afterwards. The sequence comes from the
+    // message info getter and the items without information pass through, modules override GetSequenceInfo to
+    // order the end of stream marks too. The instance runs on its own thread, which waits for the timeout.
+    virtual bool GetSequenceInfo(const std::shared_ptr<void> &message, uint32_t &channelId, uint64_t &sequenceId);
+    void ReorderInput(std::vector<std::shared_ptr<void>> &sendDataVec);
+    void ReleaseReorderChannel(ModuleReorderChannel &channel, uint64_t nowUs,
+        std::vector<std::shared_ptr<void>> &releasedVec);
+    unsigned int GetReorderWaitMs(uint64_t nowUs) const;
+    void FillBatch(std::vector<std::shared_ptr<void>> &frameInfoVec);
+    void CallProcessItems(std::vector<std::shared_ptr<void>> &sendDataVec);
+    // Fused mode: the previous module calls this instead of pushing to the input queue, so the item is processed
+    // at once on the thread of the sender, without the queue hop. The calls are serialized by fusedMutex_, as a
+    // sender may send from several threads. There is nothing to batch, and the reorder buffer only gives up the
+    // missing items when later ones come, since no thread waits for reorderTimeoutMs.
+    void ProcessFused(const std::shared_ptr<void> &inputData);
     void CallProcess(const std::shared_ptr<void> &sendData);
+    void CallProcessBatch(std::vector<std::shared_ptr<void>> &sendDataVec);
+    void JoinInput(const std::shared_ptr<void> &joinMessage);
+    void TraceEnqueue(const ModuleOutputInfo &outputInfo, uint32_t queueIndex, const std::shared_ptr<void> &outputData);
+    // records that the data is taken from the input queue and returns the time, the start of its processing
+    uint64_t TraceDequeue(const std::shared_ptr<void> &data, ModuleMessageInfo &info, bool &hasInfo);
+    bool IsQueueWarnDue(const std::chrono::high_resolution_clock::time_point &now);
+    uint32_t SelectOutputQueue(const ModuleOutputInfo &outputInfo, int channelId);
+    uint32_t NextRandom();
     void AssignInitArgs(const ModuleInitArgs &initArgs);
+    // threads the instance creates itself, such as the report thread of a decoder, which get its cpu affinity too
+    void RegisterThread(pthread_t thread);
+    void ApplyCpuAffinity();
+    // pool of the messages of type T shared by the modules of the pipeline, see MessagePoolSet::GetPool
+    template<typename T> std::shared_ptr<MessagePool<T>> GetMessagePool(uint32_t maxFreeCount = MESSAGE_POOL_MAX_FREE,
+        typename MessagePool<T>::ResetFunc resetFunc = nullptr)
+    {
+        if (messagePools_ == nullptr) {
+            messagePools_ = std::make_shared<MessagePoolSet>();
+        }
+        return messagePools_->GetPool<T>(maxFreeCount, resetFunc);
+    }
+    // items for which this returns false, such as end of stream marks, are never dropped by the overflow policy
+    virtual bool IsDroppable(const std::shared_ptr<void> &outputData);
+    // called for every item of this module dropped by the overflow policy, to release what it holds
+    virtual void OnDropped(const std::shared_ptr<void> &outputData);
+    // called for every input item dropped because it is older than maxFrameAgeMs, to release what it holds
+    virtual void OnInputDropped(const std::shared_ptr<void> &inputData);
+    // drops the input item if it is older than maxFrameAgeMs, the items without information are never stale
+    bool DropStaleInput(const std::shared_ptr<void> &inputData);
+    // called for an input item whose information is older than maxFrameAgeMs, that is taken before staleBeforeUs:
+    // counts the dropped frames in droppedCountMap by channel and returns true to drop the whole item, as the default
+    // does. An item holding the frames of several channels, such as a batch, only drops its stale frames and returns
+    // false while some are left, its information must then be the one of its oldest frame.
+    virtual bool DropStaleFrames(const std::shared_ptr<void> &inputData, const ModuleMessageInfo &info,
+        uint64_t staleBeforeUs, std::map<uint32_t, uint64_t> &droppedCountMap);
+    void PushToNextModule(const ModuleOutputInfo &outputInfo, uint32_t queueIndex,
+        const std::shared_ptr<void> &outputData);
+    APP_ERROR PushWaiting(const ModuleOutputInfo &outputInfo, uint32_t queueIndex,
+        const std::shared_ptr<void> &outputData);
+    void NotifyTaskProgress();
+    void WaitTaskProgress(uint64_t progress);
 
 protected:
     int instanceId_ = -1;
+    uint32_t maxBatchSize_ = 1;
+    uint32_t batchTimeoutMs_ = 0;
+    uint64_t maxFrameAgeUs_ = 0;
+    uint32_t reorderWindow_ = 0;
+    uint64_t reorderTimeoutUs_ = 0;
     std::string pipelineName_ = {};
     std::string moduleName_ = {};
     int32_t deviceId_ = -1;
     std::thread processThr_ = {};
     std::atomic_bool isStop_ = {};
     bool withoutInputQueue_ = false;
-    std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> inputQueue_ = nullptr;
+    bool runInSteps_ = false; // the module implements ProcessStep rather than Process, needs withoutInputQueue_
+    // the module only sends from Process, or ProcessStep, which run one at a time, and from no callback thread
+    bool isSingleSendThread_ = false;
+    // the module has no input and instance i sends the frames of channel i only, as the stream sources do
+    bool isChannelPerInstance_ = false;
+    bool isFusedInput_ = false; // the input comes through ProcessFused, see SetFusedInput
+    std::shared_ptr<ItemQueue<std::shared_ptr<void>>> inputQueue_ = nullptr;
     std::map<std::string, ModuleOutputInfo> outputQueMap_ = {};
     int outputQueVecSize_ = 0;
     ModuleConnectType connectType_ = MODULE_CONNECT_RANDOM;
     int sendCount_ = 0;
+    uint32_t randomState_ = 1;
+    uint32_t joinPortCount_ = 0;
+    ModuleMessageInfoGetter messageInfoGetter_ = nullptr;
+    uint32_t traceTrackId_ = 0;
+    // messages of the frames waiting for some of their inputs, by (channelId, frameId)
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<std::shared_ptr<void>>> joinPendingMap_ = {};
+    std::chrono::high_resolution_clock::time_point lastQueueWarnTime_ = {};
+    std::shared_ptr<ModuleExecutor> executor_ = nullptr;
+    std::shared_ptr<MessagePoolSet> messagePools_ = nullptr;
+    std::vector<uint32_t> cpuList_ = {};
+    std::vector<pthread_t> extraThreads_ = {};
+    std::atomic<int> taskState_ = {0};
+    // counts the pops of the task and its ends, PushWaiting and Stop park on it instead of polling taskState_
+    std::atomic<uint64_t> taskProgress_ = {0};
+    std::atomic<int> taskWaiters_ = {0};
+    std::mutex taskMutex_;
+    std::condition_variable taskCond_;
+    std::shared_ptr<ModuleEventLoop> eventLoop_ = nullptr;
+    bool isStepping_ = false; // a step of the instance is running or scheduled on the event loop
+    mutable std::mutex staleDropMutex_;
+    std::map<uint32_t, uint64_t> staleDropCountMap_ = {}; // input items dropped by maxFrameAgeMs, by channel
+    std::map<uint32_t, ModuleReorderChannel> reorderChannelMap_ = {};
+    uint64_t reorderHeldCount_ = 0;
+    uint64_t reorderSkipCount_ = 0; // missing input items given up
+    uint64_t reorderLateCount_ = 0; // input items which came after being given up
+    std::mutex stepMutex_;
+    std::mutex fusedMutex_; // held by ProcessFused, so that Stop waits for the running call
+    std::condition_variable stepCond_;
+};
+
+// module whose input messages are all of type T, ProcessMessage gets them without casting from shared_ptr<void>
+template<typename T> class TypedModuleBase : public ModuleBase {
+protected:
+    virtual APP_ERROR ProcessMessage(std::shared_ptr<T> inputMessage) = 0;
+
+    APP_ERROR Process(std::shared_ptr<void> inputData)
+    {
+        return ProcessMessage(std::static_pointer_cast<T>(inputData));
+    }
 };
 }
 
@@ -0,0 +1,238 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ModuleManager/ModuleEventLoop.h"
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "ModuleManager/CpuAffinity.h"
+#include "Log/Log.h"
+
+namespace ascendBaseModule {
+namespace {
+const int LOOP_MAX_EVENTS = 64;
+const uint64_t LOOP_WAKE_ID = 0; // epoll data of the eventfd, the wait ids start at 1
+using LoopDeadline = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+
+uint32_t ToEpollEvents(uint32_t events)
+{
+    uint32_t epollEvents = 0;
+    if ((events & POLLIN) != 0) {
+        epollEvents |= EPOLLIN;
+    }
+    if ((events & POLLOUT) != 0) {
+        epollEvents |= EPOLLOUT;
+    }
+    return epollEvents;
+}
+}
+
+ModuleEventLoop::~ModuleEventLoop()
+{
+    Stop();
+}
+
+#ifdef ASCEND_MODULE_USE_ACL
+void ModuleEventLoop::SetContext(aclrtContext context)
+{
+    aclContext_ = context;
+}
+#endif
+
+APP_ERROR ModuleEventLoop::Start(uint32_t threadNum)
+{
+    if (threadNum == 0 || !loopThreads_.empty()) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    isStop_ = false;
+    for (uint32_t i = 0; i < threadNum; i++) {
+        std::unique_ptr<LoopThread> loopThread(new LoopThread());
+        loopThread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loopThread->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loopThreads_.push_back(std::move(loopThread));
+        LoopThread &added = *loopThreads_.back();
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = LOOP_WAKE_ID;
+        if (added.epollFd < 0 || added.wakeFd < 0 ||
+            epoll_ctl(added.epollFd, EPOLL_CTL_ADD, added.wakeFd, &event) != 0) {
+            LogError << "ModuleEventLoop: fail to create the epoll instance of thread " << i << ".";
+            Stop();
+            return APP_ERR_COMM_FAILURE;
+        }
+    }
+    for (uint32_t i = 0; i < threadNum; i++) {
+        loopThreads_[i]->thread = std::thread(&ModuleEventLoop::LoopThreadFunc, this, i);
+    }
+    LogInfo << "ModuleEventLoop: start " << threadNum << " threads.";
+    return APP_ERR_OK;
+}
+
+void ModuleEventLoop::Stop()
+{
+    isStop_ = true;
+    const uint64_t wakeValue = 1;
+    for (auto &loopThread : loopThreads_) {
+        if (loopThread->wakeFd >= 0 && write(loopThread->wakeFd, &wakeValue, sizeof(wakeValue)) < 0) {
+            LogWarn << "ModuleEventLoop: fail to wake a thread up.";
+        }
+    }
+    for (auto &loopThread : loopThreads_) {
+        if (loopThread->thread.joinable()) {
+            loopThread->thread.join();
+        }
+        if (loopThread->epollFd >= 0) {
+            close(loopThread->epollFd);
+        }
+        if (loopThread->wakeFd >= 0) {
+            close(loopThread->wakeFd);
+        }
+    }
+    loopThreads_.clear();
+}
+
+uint32_t ModuleEventLoop::GetThreadNum() const
+{
+    return loopThreads_.size();
+}
+
+void ModuleEventLoop::SetCpuAffinity(const std::vector<uint32_t> &cpuList)
+{
+    for (auto &loopThread : loopThreads_) {
+        if (SetThreadAffinity(loopThread->thread.native_handle(), cpuList) != APP_ERR_OK) {
+            LogWarn << "ModuleEventLoop: fail to set the cpu affinity of the threads.";
+            return;
+        }
+    }
+}
+
+APP_ERROR ModuleEventLoop::Schedule(uint32_t threadIndex, uint32_t delayMs, int fd, uint32_t events,
+    std::function<void()> callback)
+{
+    if (loopThreads_.empty() || callback == nullptr) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    LoopThread &loopThread = *loopThreads_[threadIndex % loopThreads_.size()];
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+    {
+        std::unique_lock<std::mutex> lock(loopThread.mutex);
+        uint64_t waitId = loopThread.nextWaitId++;
+        if (fd >= 0) {
+            // one shot, so that the fd doesn't fire again before FireWait removes it
+            struct epoll_event event = {};
+            event.events = ToEpollEvents(events) | EPOLLONESHOT;
+            event.data.u64 = waitId;
+            if (epoll_ctl(loopThread.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                LogError << "ModuleEventLoop: fail to watch fd " << fd << ", errno=" << errno << ".";
+                return APP_ERR_COMM_FAILURE;
+            }
+        }
+        LoopWait &wait = loopThread.waitMap[waitId];
+        wait.fd = fd;
+        wait.callback = std::move(callback);
+        loopThread.deadlineHeap.push_back(LoopDeadline(deadline, waitId));
+        std::push_heap(loopThread.deadlineHeap.begin(), loopThread.deadlineHeap.end(),
+            std::greater<LoopDeadline>());
+    }
+    const uint64_t wakeValue = 1;
+    if (write(loopThread.wakeFd, &wakeValue, sizeof(wakeValue)) < 0) {
+        LogWarn << "ModuleEventLoop: fail to wake a thread up.";
+    }
+    return APP_ERR_OK;
+}
+
+// milliseconds until the earliest deadline rounded up, so that it has passed on wake up, -1 without deadline
+int ModuleEventLoop::GetEpollTimeoutMs(LoopThread &loopThread)
+{
+    std::unique_lock<std::mutex> lock(loopThread.mutex);
+    if (loopThread.deadlineHeap.empty()) {
+        return -1;
+    }
+    auto leftUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        loopThread.deadlineHeap.front().first - std::chrono::steady_clock::now()).count();
+    const int64_t usPerMs = 1000;
+    return (leftUs <= 0) ? 0 : static_cast<int>((leftUs + usPerMs - 1) / usPerMs);
+}
+
+// the callback runs without the lock, so it can schedule the next wait
+void ModuleEventLoop::FireWait(LoopThread &loopThread, uint64_t waitId)
+{
+    std::function<void()> callback = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(loopThread.mutex);
+        auto iter = loopThread.waitMap.find(waitId);
+        if (iter == loopThread.waitMap.end()) {
+            return;
+        }
+        if (iter->second.fd >= 0) {
+            epoll_ctl(loopThread.epollFd, EPOLL_CTL_DEL, iter->second.fd, nullptr);
+        }
+        callback = std::move(iter->second.callback);
+        loopThread.waitMap.erase(iter);
+    }
+    callback();
+}
+
+void ModuleEventLoop::FireExpiredWaits(LoopThread &loopThread)
+{
+    std::vector<uint64_t> expiredIds;
+    {
+        std::unique_lock<std::mutex> lock(loopThread.mutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (!loopThread.deadlineHeap.empty() && loopThread.deadlineHeap.front().first <= now) {
+            expiredIds.push_back(loopThread.deadlineHeap.front().second);
+            std::pop_heap(loopThread.deadlineHeap.begin(), loopThread.deadlineHeap.end(),
+                std::greater<LoopDeadline>());
+            loopThread.deadlineHeap.pop_back();
+        }
+    }
+    for (auto waitId : expiredIds) {
+        FireWait(loopThread, waitId);
+    }
+}
+
+void ModuleEventLoop::LoopThreadFunc(uint32_t threadIndex)
+{
+#ifdef ASCEND_MODULE_USE_ACL
+    APP_ERROR ret = aclrtSetCurrentContext(aclContext_);
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleEventLoop: fail to set context for thread " << threadIndex << ", ret=" << ret << ".";
+        return;
+    }
+#endif
+    LoopThread &loopThread = *loopThreads_[threadIndex];
+    struct epoll_event events[LOOP_MAX_EVENTS];
+    while (!isStop_) {
+        int eventNum = epoll_wait(loopThread.epollFd, events, LOOP_MAX_EVENTS, GetEpollTimeoutMs(loopThread));
+        for (int i = 0; i < eventNum && !isStop_; i++) {
+            if (events[i].data.u64 == LOOP_WAKE_ID) {
+                uint64_t wakeValue = 0;
+                while (read(loopThread.wakeFd, &wakeValue, sizeof(wakeValue)) > 0) {}
+                continue;
+            }
+            FireWait(loopThread, events[i].data.u64);
+        }
+        if (!isStop_) {
+            FireExpiredWaits(loopThread);
+        }
+    }
+    LogDebug << "ModuleEventLoop: thread " << threadIndex << " end.";
+}
+}
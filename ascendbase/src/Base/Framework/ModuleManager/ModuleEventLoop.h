@@ -0,0 +1,88 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_MODULE_EVENT_LOOP_H
+#define INC_MODULE_EVENT_LOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+#ifdef ASCEND_MODULE_USE_ACL
+#include "acl/acl.h"
+#endif
+
+namespace ascendBaseModule {
+// Few threads running the callbacks of many waits on timers and file descriptors, so that the modules which
+// mostly wait, such as the stream pullers of low frame rate channels, don't need a thread each. Every thread owns
+// an epoll instance and a heap of deadlines, a wait belongs to the thread it is scheduled on.
+class ModuleEventLoop {
+public:
+    ModuleEventLoop() {};
+    ~ModuleEventLoop();
+#ifdef ASCEND_MODULE_USE_ACL
+    // the context every thread sets once when it starts, call before Start
+    void SetContext(aclrtContext context);
+#endif
+    APP_ERROR Start(uint32_t threadNum);
+    // the waits not fired yet are dropped
+    void Stop();
+    // Runs the callback once on thread threadIndex % GetThreadNum(), as soon as fd is ready for events (POLLIN,
+    // POLLOUT) or delayMs elapsed, whichever comes first. fd = -1 only waits for the delay. A fd is watched by one
+    // wait at a time.
+    APP_ERROR Schedule(uint32_t threadIndex, uint32_t delayMs, int fd, uint32_t events,
+        std::function<void()> callback);
+    uint32_t GetThreadNum() const;
+    // cpus the threads run on, call after Start
+    void SetCpuAffinity(const std::vector<uint32_t> &cpuList);
+
+private:
+    struct LoopWait {
+        int fd;
+        std::function<void()> callback;
+    };
+
+    struct LoopThread {
+        std::mutex mutex;
+        int epollFd = -1;
+        int wakeFd = -1; // eventfd written to recompute the epoll timeout after a schedule
+        uint64_t nextWaitId = 1;
+        std::map<uint64_t, LoopWait> waitMap;
+        // (deadline, wait id) min heap, the entries of the waits fired by their fd are skipped when popped
+        std::vector<std::pair<std::chrono::steady_clock::time_point, uint64_t>> deadlineHeap;
+        std::thread thread;
+    };
+
+    void LoopThreadFunc(uint32_t threadIndex);
+    int GetEpollTimeoutMs(LoopThread &loopThread);
+    void FireWait(LoopThread &loopThread, uint64_t waitId);
+    void FireExpiredWaits(LoopThread &loopThread);
+
+private:
+#ifdef ASCEND_MODULE_USE_ACL
+    aclrtContext aclContext_ = nullptr;
+#endif
+    std::vector<std::unique_ptr<LoopThread>> loopThreads_ = {};
+    std::atomic_bool isStop_ = {false};
+};
+}
+
+#endif
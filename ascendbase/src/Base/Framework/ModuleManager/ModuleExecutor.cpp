@@ -0,0 +1,161 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ModuleManager/ModuleExecutor.h"
+#include "ModuleManager/ModuleBase.h"
+#include "ModuleManager/CpuAffinity.h"
+#include "Log/Log.h"
+
+namespace ascendBaseModule {
+namespace {
+// worker of the calling thread, nullptr for the threads which are not workers
+thread_local ModuleExecutor *g_currentExecutor = nullptr;
+thread_local uint32_t g_currentWorkerId = 0;
+}
+
+ModuleExecutor::~ModuleExecutor()
+{
+    Stop();
+}
+
+#ifdef ASCEND_MODULE_USE_ACL
+void ModuleExecutor::SetContext(aclrtContext context)
+{
+    aclContext_ = context;
+}
+#endif
+
+APP_ERROR ModuleExecutor::Start(uint32_t threadNum)
+{
+    if (threadNum == 0 || !workers_.empty()) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    isStop_ = false;
+    for (uint32_t i = 0; i < threadNum; i++) {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    // the workers steal from each other, so they are only started once all the deques exist
+    for (uint32_t i = 0; i < threadNum; i++) {
+        workers_[i]->thread = std::thread(&ModuleExecutor::WorkerThread, this, i);
+    }
+    LogInfo << "ModuleExecutor: start " << threadNum << " workers.";
+    return APP_ERR_OK;
+}
+
+void ModuleExecutor::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        isStop_ = true;
+    }
+    idleCond_.notify_all();
+    for (auto &worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    workers_.clear();
+}
+
+uint32_t ModuleExecutor::GetThreadNum() const
+{
+    return workers_.size();
+}
+
+bool ModuleExecutor::IsWorkerThread() const
+{
+    return g_currentExecutor == this;
+}
+
+void ModuleExecutor::SetCpuAffinity(const std::vector<uint32_t> &cpuList)
+{
+    for (auto &worker : workers_) {
+        if (SetThreadAffinity(worker->thread.native_handle(), cpuList) != APP_ERR_OK) {
+            LogWarn << "ModuleExecutor: fail to set the cpu affinity of the workers.";
+            return;
+        }
+    }
+}
+
+void ModuleExecutor::Submit(ModuleBase *moduleInstance)
+{
+    if (workers_.empty()) {
+        return;
+    }
+    uint32_t workerId = (g_currentExecutor == this) ? g_currentWorkerId :
+        (nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size());
+    {
+        std::unique_lock<std::mutex> lock(workers_[workerId]->mutex);
+        workers_[workerId]->tasks.push_back(moduleInstance);
+    }
+    pendingCount_.fetch_add(1);
+    // pendingCount_ is increased before idleCount_ is read and the workers do the opposite, so either the
+    // worker sees the task or the notification happens after the worker started waiting
+    if (idleCount_.load() > 0) {
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idleCond_.notify_one();
+    }
+}
+
+// the own deque is used as a stack, the others as queues
+ModuleBase *ModuleExecutor::TakeTask(uint32_t workerId)
+{
+    ModuleBase *moduleInstance = nullptr;
+    for (uint32_t i = 0; i < workers_.size() && moduleInstance == nullptr; i++) {
+        Worker &worker = *workers_[(workerId + i) % workers_.size()];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            moduleInstance = worker.tasks.back();
+            worker.tasks.pop_back();
+        } else {
+            moduleInstance = worker.tasks.front();
+            worker.tasks.pop_front();
+        }
+    }
+    if (moduleInstance != nullptr) {
+        pendingCount_.fetch_sub(1);
+    }
+    return moduleInstance;
+}
+
+void ModuleExecutor::WorkerThread(uint32_t workerId)
+{
+#ifdef ASCEND_MODULE_USE_ACL
+    APP_ERROR ret = aclrtSetCurrentContext(aclContext_);
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleExecutor: fail to set context for worker " << workerId << ", ret=" << ret << ".";
+        return;
+    }
+#endif
+    g_currentExecutor = this;
+    g_currentWorkerId = workerId;
+    while (!isStop_) {
+        ModuleBase *moduleInstance = TakeTask(workerId);
+        if (moduleInstance != nullptr) {
+            moduleInstance->RunTask();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idleCount_.fetch_add(1);
+        idleCond_.wait(lock, [this]() { return pendingCount_.load() > 0 || isStop_; });
+        idleCount_.fetch_sub(1);
+    }
+    LogDebug << "ModuleExecutor: worker " << workerId << " end.";
+}
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_MODULE_EXECUTOR_H
+#define INC_MODULE_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+#ifdef ASCEND_MODULE_USE_ACL
+#include "acl/acl.h"
+#endif
+
+namespace ascendBaseModule {
+class ModuleBase;
+
+// Fixed pool of worker threads running the module instances as tasks, instead of one thread per instance.
+// A task processes the items queued for one instance, see ModuleBase::RunTask. Each worker owns a deque: the
+// tasks it submits are pushed to and taken from the back, so the next module usually runs on the same worker
+// right after the data was produced, still in the cache. Idle workers steal from the front of the other deques.
+class ModuleExecutor {
+public:
+    ModuleExecutor() {};
+    ~ModuleExecutor();
+#ifdef ASCEND_MODULE_USE_ACL
+    // the context every worker sets once when it starts, call before Start
+    void SetContext(aclrtContext context);
+#endif
+    APP_ERROR Start(uint32_t threadNum);
+    void Stop();
+    // queues the task of the instance, to the deque of the calling worker or to the next deque in turn
+    void Submit(ModuleBase *moduleInstance);
+    uint32_t GetThreadNum() const;
+    // true on the workers of this executor, false on the other threads such as the callback threads of the devices
+    bool IsWorkerThread() const;
+    // cpus the workers run on, call after Start
+    void SetCpuAffinity(const std::vector<uint32_t> &cpuList);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<ModuleBase *> tasks;
+        std::thread thread;
+    };
+
+    void WorkerThread(uint32_t workerId);
+    ModuleBase *TakeTask(uint32_t workerId);
+
+private:
+#ifdef ASCEND_MODULE_USE_ACL
+    aclrtContext aclContext_ = nullptr;
+#endif
+    std::vector<std::unique_ptr<Worker>> workers_ = {};
+    std::atomic<uint64_t> pendingCount_ = {0}; // tasks in the deques
+    std::atomic<uint32_t> idleCount_ = {0};    // workers waiting for a task
+    std::atomic<uint32_t> nextWorker_ = {0};
+    std::atomic_bool isStop_ = {false};
+    std::mutex idleMutex_;
+    std::condition_variable idleCond_;
+};
+}
+
+#endif
@@ -15,13 +15,23 @@
  */
 
 #include "ModuleManager/ModuleManager.h"
+#include <unistd.h>
+#include "ModuleManager/CpuAffinity.h"
 #include "Log/Log.h"
+#include "BlockingQueue/DeadlineBlockingQueue.h"
+#include "BlockingQueue/RingBlockingQueue.h"
 #ifdef ASCEND_MODULE_USE_ACL
 #include "ResourceManager/ResourceManager.h"
 #endif
 
 namespace ascendBaseModule {
 const int MODULE_QUEUE_SIZE = 200;
+const uint64_t MB_TO_BYTES = 1024 * 1024;
+const uint32_t TRACE_MAX_EVENTS = 262144; // per thread, about 10 MB
+const uint32_t REORDER_TIMEOUT_MS = 1000; // max wait of a reorder buffer for a missing item if omitted
+const uint32_t SHM_DESCRIPTOR_BYTES = 256; // max size of the descriptor of a message of a shm connect if omitted
+const uint32_t SPILL_SEGMENT_MB = 64; // size of the spill files if omitted
+const std::string SPILL_DIR = "/tmp"; // directory of the spill files if omitted
 
 ModuleManager::ModuleManager() {}
 
@@ -47,6 +57,18 @@ APP_ERROR ModuleManager::Init(std::string &configPath, std::string &aclConfigPat
     }
 #endif
 
+    ret = InitExecutor();
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: fail to init executor.";
+        return ret;
+    }
+
+    ret = InitEventLoop();
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: fail to init event loop.";
+        return ret;
+    }
+
     // Init pipeline module
     ret = InitPipelineModule();
     if (ret != APP_ERR_OK) {
@@ -90,6 +112,56 @@ APP_ERROR ModuleManager::InitAcl(std::string &aclConfigPath)
 }
 #endif
 
+// SystemConfig.executorThreadNum = 0 or omitted: one thread per module instance
+//                                 > 0: the instances with an input queue run on a pool of this many workers
+//                                 < 0: the same with one worker per core
+APP_ERROR ModuleManager::InitExecutor()
+{
+    int threadNum = 0;
+    std::string itemCfgStr = "SystemConfig.executorThreadNum";
+    APP_ERROR ret = configParser_.GetIntValue(itemCfgStr, threadNum);
+    if (ret == APP_ERR_COMM_NO_EXIST || (ret == APP_ERR_OK && threadNum == 0)) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (threadNum < 0) {
+        threadNum = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    executor_ = std::make_shared<ModuleExecutor>();
+#ifdef ASCEND_MODULE_USE_ACL
+    executor_->SetContext(ResourceManager::GetInstance()->GetContext(deviceId_));
+#endif
+    return executor_->Start(threadNum);
+}
+
+// SystemConfig.eventLoopThreadNum = 0 or omitted: the modules running in steps have a thread per instance
+//                                  > 0: their steps run on an event loop of this many threads
+//                                  < 0: the same with one thread per core
+APP_ERROR ModuleManager::InitEventLoop()
+{
+    int threadNum = 0;
+    std::string itemCfgStr = "SystemConfig.eventLoopThreadNum";
+    APP_ERROR ret = configParser_.GetIntValue(itemCfgStr, threadNum);
+    if (ret == APP_ERR_COMM_NO_EXIST || (ret == APP_ERR_OK && threadNum == 0)) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (threadNum < 0) {
+        threadNum = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    eventLoop_ = std::make_shared<ModuleEventLoop>();
+#ifdef ASCEND_MODULE_USE_ACL
+    eventLoop_->SetContext(ResourceManager::GetInstance()->GetContext(deviceId_));
+#endif
+    return eventLoop_->Start(threadNum);
+}
+
 APP_ERROR ModuleManager::InitModuleInstance(std::shared_ptr<ModuleBase> moduleInstance, int instanceId,
     std::string pipelineName, std::string moduleName)
 {
@@ -102,9 +174,52 @@ APP_ERROR ModuleManager::InitModuleInstance(std::shared_ptr<ModuleBase> moduleIn
     initArgs.pipelineName = pipelineName;
     initArgs.moduleName = moduleName;
     initArgs.instanceId = instanceId;
+    initArgs.executor = executor_;
+    initArgs.eventLoop = eventLoop_;
+    initArgs.messagePools = GetMessagePools(pipelineName);
+
+    std::string itemCfgStr = moduleName + std::string(".maxBatchSize");
+    APP_ERROR ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.maxBatchSize);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = moduleName + std::string(".batchTimeoutMs");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.batchTimeoutMs);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = moduleName + std::string(".reorderWindow");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.reorderWindow);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    initArgs.reorderTimeoutMs = REORDER_TIMEOUT_MS;
+    itemCfgStr = moduleName + std::string(".reorderTimeoutMs");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.reorderTimeoutMs);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    // <moduleName>.maxFrameAgeMs overrides <pipelineName>.maxFrameAgeMs, no age limit if both are omitted
+    itemCfgStr = moduleName + std::string(".maxFrameAgeMs");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.maxFrameAgeMs);
+    if (ret == APP_ERR_COMM_NO_EXIST) {
+        itemCfgStr = pipelineName + std::string(".maxFrameAgeMs");
+        ret = configParser_.GetUnsignedIntValue(itemCfgStr, initArgs.maxFrameAgeMs);
+    }
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
 
     // Initialize the Init function of each module
-    APP_ERROR ret = moduleInstance->Init(configParser_, initArgs);
+    ret = moduleInstance->Init(configParser_, initArgs);
     if (ret != APP_ERR_OK) {
         LogFatal << "ModuleManager: fail to init module, name = " << moduleName.c_str() << ", instance id = " <<
             instanceId << ".";
@@ -130,10 +245,26 @@ APP_ERROR ModuleManager::RegisterModules(std::string pipelineName, ModuleDesc *m
     for (int i = 0; i < moduleTypeCount; i++) {
         ModuleDesc moduleDesc = modulesDesc[i];
         int moduleCount = (moduleDesc.moduleCount == -1) ? defaultCount : moduleDesc.moduleCount;
+        APP_ERROR ret = ReadModuleCount(moduleDesc.moduleName, moduleCount);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        std::string processName;
+        ret = ReadModuleProcess(moduleDesc.moduleName, processName);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        if (!processName_.empty() && !processName.empty() && processName != processName_) {
+            LogInfo << "ModuleManager: " << moduleDesc.moduleName << " has " << moduleCount << " instances in the "
+                    << "process " << processName << ".";
+            remoteModuleMap_[pipelineName][moduleDesc.moduleName] = moduleCount;
+            continue;
+        }
+        LogInfo << "ModuleManager: " << moduleDesc.moduleName << " has " << moduleCount << " instances.";
         ModulesInfo modulesInfo;
         for (int j = 0; j < moduleCount; j++) {
             moduleInstance.reset(static_cast<ModuleBase *>(ModuleFactory::MakeModule(moduleDesc.moduleName)));
-            APP_ERROR ret = InitModuleInstance(moduleInstance, j, pipelineName, moduleDesc.moduleName);
+            ret = InitModuleInstance(moduleInstance, j, pipelineName, moduleDesc.moduleName);
             if (ret != APP_ERR_OK) {
                 return ret;
             }
@@ -157,39 +288,713 @@ APP_ERROR ModuleManager::RegisterModuleConnects(std::string pipelineName, Module
     }
     modulesInfoMap = iter->second;
 
-    std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> dataQueue = nullptr;
+    std::map<std::string, int> &remoteModuleMap = remoteModuleMap_[pipelineName];
+    APP_ERROR ret = CheckTopology(modulesInfoMap, remoteModuleMap, connnectDesc, moduleConnectCount);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
+    std::shared_ptr<ItemQueue<std::shared_ptr<void>>> dataQueue = nullptr;
+
+    std::shared_ptr<QueueMemoryBudget> memoryBudget = nullptr;
+    ret = GetPipelineMemoryBudget(pipelineName, memoryBudget);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
+    // a module receiving from several connects joins them, input i of the join being its i-th connect
+    std::map<std::string, uint32_t> joinPortCountMap;
+    for (int i = 0; i < moduleConnectCount; i++) {
+        joinPortCountMap[connnectDesc[i].moduleRecv]++;
+    }
+    std::map<std::string, uint32_t> joinPortMap;
+
+    // the connects as configured, the single producer proofs look at the connects upstream
+    std::vector<ModuleConnectDesc> connectVec(connnectDesc, connnectDesc + moduleConnectCount);
+    for (auto &connectDesc : connectVec) {
+        ret = ReadConnectConfig(connectDesc);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
 
     // add connect
     for (int i = 0; i < moduleConnectCount; i++) {
-        ModuleConnectDesc connectDesc = connnectDesc[i];
+        ModuleConnectDesc connectDesc = connectVec[i];
         LogDebug << "Add Connect " << connectDesc.moduleSend << " " << connectDesc.moduleRecv << " type " <<
             connectDesc.connectType;
+        // the modules of other processes have no instance here, CheckTopology made sure they are registered
         auto iterSend = modulesInfoMap.find(connectDesc.moduleSend);
         auto iterRecv = modulesInfoMap.find(connectDesc.moduleRecv);
-        if (iterSend == modulesInfoMap.end() || iterRecv == modulesInfoMap.end()) {
-            LogFatal << "Cann't find Module";
-            return APP_ERR_COMM_INVALID_PARAM;
+        bool isSendRemote = (iterSend == modulesInfoMap.end());
+        bool isRecvRemote = (iterRecv == modulesInfoMap.end());
+        uint32_t joinPort = joinPortMap[connectDesc.moduleRecv]++;
+        if (isSendRemote && isRecvRemote) {
+            continue;
         }
 
-        ModulesInfo moduleInfoSend = iterSend->second;
-        ModulesInfo moduleInfoRecv = iterRecv->second;
+        ModulesInfo moduleInfoSend = isSendRemote ? ModulesInfo() : iterSend->second;
+        ModulesInfo moduleInfoRecv = isRecvRemote ? ModulesInfo() : iterRecv->second;
+        size_t sendCount = isSendRemote ? remoteModuleMap[connectDesc.moduleSend] : moduleInfoSend.moduleVec.size();
+        size_t recvCount = isRecvRemote ? remoteModuleMap[connectDesc.moduleRecv] : moduleInfoRecv.moduleVec.size();
+
+        ret = CheckConnect(connectDesc, sendCount, recvCount);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
 
-        // create input queue for recv module
-        for (unsigned int j = 0; j < moduleInfoRecv.moduleVec.size(); j++) {
-            dataQueue = std::make_shared<BlockingQueue<std::shared_ptr<void>>>(MODULE_QUEUE_SIZE);
+        bool byteBudgeted = (connectDesc.queueMaxMB != 0 || memoryBudget != nullptr);
+        bool isJoin = (joinPortCountMap[connectDesc.moduleRecv] > 1);
+        if (isJoin) {
+            ret = CheckJoin(connectDesc, recvCount, byteBudgeted);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+            // the queues have a producer per connect
+            if (connectDesc.queueType == MODULE_QUEUE_AUTO) {
+                connectDesc.queueType = MODULE_QUEUE_BLOCKING;
+            }
+        }
+        ModuleQueueType queueType = MODULE_QUEUE_AUTO;
+        bool singleProducer = !isJoin && IsSingleProducer(modulesInfoMap, connectVec, connectDesc, recvCount);
+        ret = ResolveQueueType(connectDesc, sendCount, singleProducer, byteBudgeted, queueType);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        if ((isSendRemote || isRecvRemote) && queueType != MODULE_QUEUE_SHM) {
+            LogFatal << "ModuleManager: " << (isSendRemote ? connectDesc.moduleSend : connectDesc.moduleRecv) <<
+                " runs in another process, the connect " << connectDesc.moduleSend << " " << connectDesc.moduleRecv <<
+                " must use the shm queue type.";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        if (isJoin && queueType == MODULE_QUEUE_SHM) {
+            LogFatal << "Queue of " << connectDesc.moduleRecv << " joins several connects, it can't be in shared memory";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+
+        // create input queue for recv module, the connects of a join share the queues created for the first one
+        moduleInfoRecv.inputQueueVec.clear();
+        std::shared_ptr<ShmSegment> shmSegment = nullptr;
+        if (queueType == MODULE_QUEUE_SHM) {
+            ret = CreateShmQueues(pipelineName, connectDesc, recvCount, shmSegment, moduleInfoRecv.inputQueueVec);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+        }
+        if (joinPort > 0) {
+            moduleInfoRecv.inputQueueVec = pipelineMap_[pipelineName][connectDesc.moduleRecv].inputQueueVec;
+        }
+        for (unsigned int j = moduleInfoRecv.inputQueueVec.size(); j < moduleInfoRecv.moduleVec.size(); j++) {
+            if (queueType == MODULE_QUEUE_SPILL) {
+                ret = CreateSpillQueue(pipelineName, connectDesc, j, memoryBudget, dataQueue);
+                if (ret != APP_ERR_OK) {
+                    return ret;
+                }
+            } else {
+                dataQueue = CreateModuleQueue(queueType, connectDesc, memoryBudget);
+            }
+            if (dataQueue == nullptr) {
+                LogFatal << "Invalid queue type " << queueType << " of " << connectDesc.moduleRecv;
+                return APP_ERR_COMM_INVALID_PARAM;
+            }
+            dataQueue->SetWaitStrategy(connectDesc.waitStrategy);
             moduleInfoRecv.inputQueueVec.push_back(dataQueue);
         }
-        RegisterInputVec(pipelineName, connectDesc.moduleRecv, moduleInfoRecv.inputQueueVec);
+        if (joinPort == 0 && !isRecvRemote) {
+            RegisterInputVec(pipelineName, connectDesc.moduleRecv, moduleInfoRecv.inputQueueVec);
+            pipelineMap_[pipelineName][connectDesc.moduleRecv].inputQueueVec = moduleInfoRecv.inputQueueVec;
+        }
 
         //
         RegisterOutputModule(pipelineName, connectDesc.moduleSend, connectDesc.moduleRecv, connectDesc.connectType,
-            moduleInfoRecv.inputQueueVec);
+            moduleInfoRecv.inputQueueVec, connectDesc.overflowPolicy, connectDesc.keepLatestNum);
+        if (isJoin) {
+            for (auto &moduleInstance : moduleInfoSend.moduleVec) {
+                moduleInstance->SetOutputJoinPort(connectDesc.moduleRecv, static_cast<int>(joinPort));
+            }
+        }
+
+        // the senders schedule the tasks of the receivers they push to, or call them if the connect is fused
+        if ((executor_ != nullptr && queueType != MODULE_QUEUE_SHM) || queueType == MODULE_QUEUE_FUSED) {
+            std::vector<ModuleBase *> outputModuleVec;
+            for (auto &moduleInstance : moduleInfoRecv.moduleVec) {
+                outputModuleVec.push_back(moduleInstance.get());
+            }
+            for (auto &moduleInstance : moduleInfoSend.moduleVec) {
+                moduleInstance->SetOutputModules(connectDesc.moduleRecv, outputModuleVec);
+            }
+        }
+        if (queueType == MODULE_QUEUE_FUSED) {
+            for (auto &moduleInstance : moduleInfoSend.moduleVec) {
+                moduleInstance->SetOutputFused(connectDesc.moduleRecv);
+            }
+            for (auto &moduleInstance : moduleInfoRecv.moduleVec) {
+                moduleInstance->SetFusedInput();
+            }
+        }
+        if (queueType == MODULE_QUEUE_SHM) {
+            for (auto &moduleInstance : moduleInfoSend.moduleVec) {
+                moduleInstance->SetOutputSegment(connectDesc.moduleRecv, shmSegment);
+            }
+            for (auto &moduleInstance : moduleInfoRecv.moduleVec) {
+                moduleInstance->SetExternalInput();
+            }
+        }
+    }
+
+    for (auto &modulesInfo : modulesInfoMap) {
+        for (auto &moduleInstance : modulesInfo.second.moduleVec) {
+            moduleInstance->SetMessageInfoGetter(messageInfoGetter_);
+        }
+    }
+    for (auto &joinPortCount : joinPortCountMap) {
+        if (joinPortCount.second <= 1) {
+            continue;
+        }
+        for (auto &moduleInstance : modulesInfoMap[joinPortCount.first].moduleVec) {
+            moduleInstance->SetJoinInfo(joinPortCount.second);
+        }
+    }
+    return APP_ERR_OK;
+}
+
+// <moduleName>.process = name of the process the module runs in, the process of the ModuleManager if omitted
+APP_ERROR ModuleManager::ReadModuleProcess(const std::string &moduleName, std::string &processName) const
+{
+    std::string itemCfgStr = moduleName + std::string(".process");
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, processName);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+// <moduleName>.instanceCount = number of instances of the module
+APP_ERROR ModuleManager::ReadModuleCount(const std::string &moduleName, int &moduleCount) const
+{
+    std::string itemCfgStr = moduleName + std::string(".instanceCount");
+    APP_ERROR ret = configParser_.GetIntValue(itemCfgStr, moduleCount);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (moduleCount <= 0) {
+        LogFatal << "ModuleManager: invalid instance count of " << moduleName << ", count = " << moduleCount << ".";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+// The connects must not form a cycle, which the overflow policies and the executor rely on
+APP_ERROR ModuleManager::CheckTopology(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+    const std::map<std::string, int> &remoteModuleMap, const ModuleConnectDesc *connnectDesc,
+    int moduleConnectCount) const
+{
+    auto isRegistered = [&modulesInfoMap, &remoteModuleMap](const std::string &moduleName) {
+        return modulesInfoMap.find(moduleName) != modulesInfoMap.end() ||
+            remoteModuleMap.find(moduleName) != remoteModuleMap.end();
+    };
+    std::map<std::string, std::vector<std::string>> receiverMap; // moduleSend -> moduleRecv of its connects
+    std::map<std::string, uint32_t> senderCountMap; // module -> number of connects it receives from
+    for (int i = 0; i < moduleConnectCount; i++) {
+        const ModuleConnectDesc &connectDesc = connnectDesc[i];
+        if (!isRegistered(connectDesc.moduleSend) || !isRegistered(connectDesc.moduleRecv)) {
+            LogFatal << "ModuleManager: connect " << connectDesc.moduleSend << " " << connectDesc.moduleRecv <<
+                " uses a module which isn't registered.";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        receiverMap[connectDesc.moduleSend].push_back(connectDesc.moduleRecv);
+        senderCountMap.insert(std::make_pair(connectDesc.moduleSend, 0));
+        senderCountMap[connectDesc.moduleRecv]++;
+    }
+
+    // removing the modules without sender one after the other must remove them all
+    std::vector<std::string> readyModules;
+    for (auto &senderCount : senderCountMap) {
+        if (senderCount.second == 0) {
+            readyModules.push_back(senderCount.first);
+        }
+    }
+    size_t removedCount = 0;
+    while (!readyModules.empty()) {
+        std::string moduleName = readyModules.back();
+        readyModules.pop_back();
+        removedCount++;
+        for (auto &moduleRecv : receiverMap[moduleName]) {
+            if (--senderCountMap[moduleRecv] == 0) {
+                readyModules.push_back(moduleRecv);
+            }
+        }
+    }
+    if (removedCount != senderCountMap.size()) {
+        for (auto &senderCount : senderCountMap) {
+            if (senderCount.second != 0) {
+                LogFatal << "ModuleManager: the connects of " << senderCount.first << " form a cycle.";
+                break;
+            }
+        }
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+// PAIR: sender instance i pushes to queue i, ONE only uses the first receiver, the others spread over the receivers
+APP_ERROR ModuleManager::CheckConnect(const ModuleConnectDesc &connectDesc, size_t sendCount, size_t recvCount) const
+{
+    if (connectDesc.connectType == MODULE_CONNECT_PAIR && sendCount > recvCount) {
+        LogFatal << "ModuleManager: " << connectDesc.moduleSend << " has " << sendCount << " instances but " <<
+            connectDesc.moduleRecv << " only " << recvCount << ", they can't be connected by pair.";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (connectDesc.connectType == MODULE_CONNECT_ONE && recvCount > 1) {
+        LogWarn << "ModuleManager: only the first of the " << recvCount << " instances of " <<
+            connectDesc.moduleRecv << " receives from " << connectDesc.moduleSend << ".";
+    }
+    // the receivers share the message, dropping it calls OnDropped which would release it under the others
+    if (connectDesc.connectType == MODULE_CONNECT_BROADCAST && connectDesc.overflowPolicy != MODULE_OVERFLOW_BLOCK) {
+        LogFatal << "ModuleManager: " << connectDesc.moduleRecv << " is connected by broadcast, it must use the "
+                 << "block overflow policy.";
+        return APP_ERR_COMM_INVALID_PARAM;
     }
     return APP_ERR_OK;
 }
 
+// The messages of a join are wrapped with their input in the shared queues, which only the blocking queues
+// without byte budget handle as opaque items. The messages of a frame must reach the same instance.
+APP_ERROR ModuleManager::CheckJoin(const ModuleConnectDesc &connectDesc, size_t recvCount, bool byteBudgeted) const
+{
+    if (messageInfoGetter_ == nullptr) {
+        LogFatal << "ModuleManager: " << connectDesc.moduleRecv << " joins several connects, it needs the message "
+                 << "info getter, call SetMessageInfoGetter first";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (connectDesc.overflowPolicy != MODULE_OVERFLOW_BLOCK || byteBudgeted ||
+        (connectDesc.queueType != MODULE_QUEUE_AUTO && connectDesc.queueType != MODULE_QUEUE_BLOCKING &&
+        connectDesc.queueType != MODULE_QUEUE_RING)) {
+        LogFatal << "ModuleManager: " << connectDesc.moduleRecv << " joins several connects, it must use the "
+                 << "block overflow policy and a blocking or ring queue without byte budget.";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (recvCount > 1 && connectDesc.connectType != MODULE_CONNECT_CHANNEL &&
+        connectDesc.connectType != MODULE_CONNECT_ONE) {
+        LogFatal << "ModuleManager: " << connectDesc.moduleRecv << " joins several connects with " << recvCount
+                 << " instances, it must be connected by channel or one.";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+// the value of the config variable is one of the keys of valueMap, value is kept if the variable doesn't exist
+template<typename E> APP_ERROR ModuleManager::ReadEnumConfig(const std::string &itemCfgStr,
+    const std::map<std::string, E> &valueMap, E &value) const
+{
+    std::string valueStr;
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, valueStr);
+    if (ret == APP_ERR_COMM_NO_EXIST) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    auto iter = valueMap.find(valueStr);
+    if (iter == valueMap.end()) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ", value = " << valueStr;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    value = iter->second;
+    return APP_ERR_OK;
+}
+
+// <moduleRecv>.connectType = one, channel, pair, random, least_loaded, two_choices or broadcast
+// <moduleRecv>.queueSize = capacity of each input queue
+// <moduleRecv>.queueType = auto, blocking, ring, spsc, deadline, fused, shm or spill
+// <moduleRecv>.overflowPolicy = block, drop_newest, drop_oldest or keep_latest
+// <moduleRecv>.keepLatestNum = number of frames kept by keep_latest
+// <moduleRecv>.waitStrategy = park or adaptive_spin
+// <moduleRecv>.maxSpinUs = max spin time of adaptive_spin
+// <moduleRecv>.queueMaxMB = max memory held by the items of each input queue
+APP_ERROR ModuleManager::ReadConnectConfig(ModuleConnectDesc &connectDesc) const
+{
+    const std::map<std::string, ModuleConnectType> connectTypeMap = {
+        {"one", MODULE_CONNECT_ONE},
+        {"channel", MODULE_CONNECT_CHANNEL},
+        {"pair", MODULE_CONNECT_PAIR},
+        {"random", MODULE_CONNECT_RANDOM},
+        {"least_loaded", MODULE_CONNECT_LEAST_LOADED},
+        {"two_choices", MODULE_CONNECT_TWO_CHOICES},
+        {"broadcast", MODULE_CONNECT_BROADCAST}
+    };
+    const std::map<std::string, ModuleQueueType> queueTypeMap = {
+        {"auto", MODULE_QUEUE_AUTO},
+        {"blocking", MODULE_QUEUE_BLOCKING},
+        {"ring", MODULE_QUEUE_RING},
+        {"spsc", MODULE_QUEUE_SPSC},
+        {"deadline", MODULE_QUEUE_DEADLINE},
+        {"fused", MODULE_QUEUE_FUSED},
+        {"shm", MODULE_QUEUE_SHM},
+        {"spill", MODULE_QUEUE_SPILL}
+    };
+    const std::map<std::string, QueueWaitMode> waitModeMap = {
+        {"park", QUEUE_WAIT_PARK},
+        {"adaptive_spin", QUEUE_WAIT_ADAPTIVE_SPIN}
+    };
+    const std::map<std::string, ModuleOverflowPolicy> policyMap = {
+        {"block", MODULE_OVERFLOW_BLOCK},
+        {"drop_newest", MODULE_OVERFLOW_DROP_NEWEST},
+        {"drop_oldest", MODULE_OVERFLOW_DROP_OLDEST},
+        {"keep_latest", MODULE_OVERFLOW_KEEP_LATEST}
+    };
+    APP_ERROR ret = ReadEnumConfig(connectDesc.moduleRecv + std::string(".connectType"), connectTypeMap,
+        connectDesc.connectType);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    ret = ReadEnumConfig(connectDesc.moduleRecv + std::string(".queueType"), queueTypeMap,
+        connectDesc.queueType);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    ret = ReadEnumConfig(connectDesc.moduleRecv + std::string(".overflowPolicy"), policyMap,
+        connectDesc.overflowPolicy);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
+    ret = ReadEnumConfig(connectDesc.moduleRecv + std::string(".waitStrategy"), waitModeMap,
+        connectDesc.waitStrategy.mode);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
+    std::string itemCfgStr = connectDesc.moduleRecv + std::string(".queueSize");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, connectDesc.queueSize);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (connectDesc.queueSize == 0) {
+        connectDesc.queueSize = MODULE_QUEUE_SIZE;
+    }
+
+    itemCfgStr = connectDesc.moduleRecv + std::string(".maxSpinUs");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, connectDesc.waitStrategy.maxSpinUs);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = connectDesc.moduleRecv + std::string(".queueMaxMB");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, connectDesc.queueMaxMB);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = connectDesc.moduleRecv + std::string(".keepLatestNum");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, connectDesc.keepLatestNum);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (connectDesc.keepLatestNum == 0) {
+        connectDesc.keepLatestNum = 1;
+    }
+    return APP_ERR_OK;
+}
+
+// Instance i of moduleName only gets the frames of the channels c with c % instanceCount == i when every connect
+// into it routes by channel, or pairs it with the instances of such a module, or it has one instance. A module
+// without input must say so, see ModuleBase::IsChannelPerInstance. depth stops the loops of a bad topology.
+bool ModuleManager::IsChannelPartitioned(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+    const std::vector<ModuleConnectDesc> &connectVec, const std::string &moduleName, uint32_t depth) const
+{
+    auto iter = modulesInfoMap.find(moduleName);
+    if (iter == modulesInfoMap.end() || iter->second.moduleVec.empty() || depth > connectVec.size()) {
+        return false;
+    }
+    size_t instanceCount = iter->second.moduleVec.size();
+    bool hasInput = false;
+    for (const auto &connectDesc : connectVec) {
+        if (connectDesc.moduleRecv != moduleName) {
+            continue;
+        }
+        hasInput = true;
+        if (instanceCount == 1 || connectDesc.connectType == MODULE_CONNECT_CHANNEL) {
+            continue;
+        }
+        auto iterSend = modulesInfoMap.find(connectDesc.moduleSend);
+        if (connectDesc.connectType != MODULE_CONNECT_PAIR || iterSend == modulesInfoMap.end() ||
+            iterSend->second.moduleVec.size() != instanceCount ||
+            !IsChannelPartitioned(modulesInfoMap, connectVec, connectDesc.moduleSend, depth + 1)) {
+            return false;
+        }
+    }
+    return hasInput || instanceCount == 1 || iter->second.moduleVec[0]->IsChannelPerInstance();
+}
+
+// Every input queue of moduleRecv has a single producer when the sender pushes from one thread at a time, see
+// ModuleBase::IsSingleSendThread, and
+// PAIR: sender instance i only pushes to queue i, so no more senders than receivers
+// CHANNEL: the channels of a receiver all come from one sender, as the senders split the channels the same way
+// ONE or BROADCAST: a single sender
+// The other routings, such as least_loaded, send any channel to any instance, and so does the next CHANNEL connect.
+bool ModuleManager::IsSingleProducer(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+    const std::vector<ModuleConnectDesc> &connectVec, const ModuleConnectDesc &connectDesc, size_t recvCount) const
+{
+    auto iterSend = modulesInfoMap.find(connectDesc.moduleSend);
+    if (iterSend == modulesInfoMap.end() || iterSend->second.moduleVec.empty() ||
+        !iterSend->second.moduleVec[0]->IsSingleSendThread()) {
+        return false;
+    }
+    size_t sendCount = iterSend->second.moduleVec.size();
+    if (connectDesc.connectType == MODULE_CONNECT_PAIR) {
+        return sendCount <= recvCount;
+    } else if (connectDesc.connectType == MODULE_CONNECT_CHANNEL) {
+        return sendCount == 1 || (recvCount % sendCount == 0 &&
+            IsChannelPartitioned(modulesInfoMap, connectVec, connectDesc.moduleSend, 0));
+    }
+    return sendCount == 1;
+}
+
+// The byte budgets are only implemented by MODULE_QUEUE_BLOCKING, and by MODULE_QUEUE_SPILL for its memory
+// MODULE_QUEUE_SPSC needs a single producer, see IsSingleProducer
+// MODULE_QUEUE_FUSED needs a single producer too, or a single sender instance, and nothing to drop
+// MODULE_QUEUE_SHM is written by the sender process only, which serializes its instances
+// MODULE_QUEUE_SPILL never drops, and needs the codec of the spilled messages
+// QUEUE_WAIT_ADAPTIVE_SPIN is implemented by MODULE_QUEUE_BLOCKING, MODULE_QUEUE_RING and MODULE_QUEUE_SPSC
+APP_ERROR ModuleManager::ResolveQueueType(const ModuleConnectDesc &connectDesc, size_t sendCount, bool singleProducer,
+    bool byteBudgeted, ModuleQueueType &queueType) const
+{
+    // dropping the oldest items makes the producer a consumer of the queue too
+    bool producerPops = (connectDesc.overflowPolicy == MODULE_OVERFLOW_DROP_OLDEST ||
+        connectDesc.overflowPolicy == MODULE_OVERFLOW_KEEP_LATEST);
+    queueType = connectDesc.queueType;
+    if (byteBudgeted && messageInfoGetter_ == nullptr) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " can't be byte budgeted without the message info "
+                 << "getter, call SetMessageInfoGetter first";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (byteBudgeted && queueType != MODULE_QUEUE_AUTO && queueType != MODULE_QUEUE_BLOCKING &&
+        queueType != MODULE_QUEUE_SPILL) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " is byte budgeted, it must use MODULE_QUEUE_BLOCKING "
+                 << "or MODULE_QUEUE_SPILL";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_AUTO) {
+        queueType = (singleProducer && !producerPops && !byteBudgeted) ? MODULE_QUEUE_SPSC : MODULE_QUEUE_BLOCKING;
+    } else if (queueType == MODULE_QUEUE_SPSC && (!singleProducer || producerPops)) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " has more than one producer or consumer, " <<
+            connectDesc.moduleSend << " can't use MODULE_QUEUE_SPSC";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_FUSED && ((!singleProducer && sendCount != 1) ||
+        connectDesc.overflowPolicy != MODULE_OVERFLOW_BLOCK)) {
+        LogFatal << "Connect " << connectDesc.moduleSend << " " << connectDesc.moduleRecv << " isn't one to one or "
+                 << "drops items, it can't use MODULE_QUEUE_FUSED";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_SHM && producerPops) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " is in shared memory, " << connectDesc.moduleSend <<
+            " can't take the oldest items out of it";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_SPILL && connectDesc.overflowPolicy != MODULE_OVERFLOW_BLOCK) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " spills the items instead of dropping them, "
+                 << connectDesc.moduleSend << " must use the block overflow policy";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_SPILL && (spillCodec_.encode == nullptr || spillCodec_.decode == nullptr)) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " can't use MODULE_QUEUE_SPILL without the message "
+                 << "codec, call SetSpillMessageCodec first";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (queueType == MODULE_QUEUE_DEADLINE && messageInfoGetter_ == nullptr) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " can't use MODULE_QUEUE_DEADLINE without the message "
+                 << "info getter, call SetMessageInfoGetter first";
+        return APP_ERR_COMM_INVALID_PARAM;
+    } else if (connectDesc.waitStrategy.mode == QUEUE_WAIT_ADAPTIVE_SPIN && queueType != MODULE_QUEUE_BLOCKING &&
+        queueType != MODULE_QUEUE_RING && queueType != MODULE_QUEUE_SPSC) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " is of type " << queueType << ", which can't spin, "
+                 << "the adaptive_spin wait strategy needs the blocking, ring or spsc queue type";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    LogDebug << "Connect " << connectDesc.moduleSend << " " << connectDesc.moduleRecv << " use queue type " <<
+        queueType;
+    return APP_ERR_OK;
+}
+
+// ResolveQueueType only lets the blocking and spill queues be byte budgeted
+std::shared_ptr<ItemQueue<std::shared_ptr<void>>> ModuleManager::CreateModuleQueue(ModuleQueueType queueType,
+    const ModuleConnectDesc &connectDesc, const std::shared_ptr<QueueMemoryBudget> &memoryBudget) const
+{
+    uint32_t queueSize = connectDesc.queueSize;
+    // the fused receivers keep an input queue which stays empty, so that they look like the others
+    if (queueType == MODULE_QUEUE_FUSED) {
+        return std::make_shared<BlockingQueue<std::shared_ptr<void>>>(queueSize);
+    } else if (queueType == MODULE_QUEUE_BLOCKING) {
+        auto dataQueue = std::make_shared<BlockingQueue<std::shared_ptr<void>>>(queueSize);
+        if ((connectDesc.queueMaxMB != 0 || memoryBudget != nullptr) &&
+            dataQueue->SetByteBudget(GetItemSizeGetter(), connectDesc.queueMaxMB * MB_TO_BYTES, memoryBudget) !=
+            APP_ERR_OK) {
+            LogFatal << "ModuleManager: fail to set the byte budget of the queue of " << connectDesc.moduleRecv << ".";
+            return nullptr;
+        }
+        return dataQueue;
+    } else if (queueType == MODULE_QUEUE_RING) {
+        return std::make_shared<RingBlockingQueue<std::shared_ptr<void>>>(queueSize);
+    } else if (queueType == MODULE_QUEUE_SPSC) {
+        return std::make_shared<SpscBlockingQueue<std::shared_ptr<void>>>(queueSize);
+    } else if (queueType == MODULE_QUEUE_DEADLINE && messageInfoGetter_ != nullptr) {
+        ModuleMessageInfoGetter messageInfoGetter = messageInfoGetter_;
+        auto deadlineGetter = [messageInfoGetter](const std::shared_ptr<void> &message) {
+            ModuleMessageInfo info;
+            return messageInfoGetter(message, info) ? info.deadlineUs : 0;
+        };
+        return std::make_shared<DeadlineBlockingQueue<std::shared_ptr<void>>>(queueSize, deadlineGetter);
+    }
+    return nullptr;
+}
+
+// The items past queueSize, or queueMaxMB and the memory budget of the pipeline, are spilled to files
+// <moduleRecv>.spillDir = directory of the spill files, SPILL_DIR if omitted
+// <moduleRecv>.spillSegmentMB = size of each spill file, SPILL_SEGMENT_MB if omitted
+// <moduleRecv>.spillMaxMB = max size of the spill files of a queue, past which the sender waits, no limit if omitted
+APP_ERROR ModuleManager::CreateSpillQueue(const std::string &pipelineName, const ModuleConnectDesc &connectDesc,
+    uint32_t instanceId, const std::shared_ptr<QueueMemoryBudget> &memoryBudget,
+    std::shared_ptr<ItemQueue<std::shared_ptr<void>>> &dataQueue)
+{
+    std::string spillDir = SPILL_DIR;
+    std::string itemCfgStr = connectDesc.moduleRecv + std::string(".spillDir");
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, spillDir);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    uint32_t segmentMB = SPILL_SEGMENT_MB;
+    itemCfgStr = connectDesc.moduleRecv + std::string(".spillSegmentMB");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, segmentMB);
+    if ((ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) || segmentMB == 0) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    uint32_t maxMB = 0;
+    itemCfgStr = connectDesc.moduleRecv + std::string(".spillMaxMB");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, maxMB);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    // the process id keeps apart the files of the pipelines running at the same time
+    SpillQueueConfig config;
+    config.filePrefix = spillDir + "/" + pipelineName + "_" + connectDesc.moduleRecv + "_" +
+        std::to_string(getpid()) + "_" + std::to_string(instanceId);
+    config.maxItems = connectDesc.queueSize;
+    config.segmentBytes = segmentMB * MB_TO_BYTES;
+    config.maxDiskBytes = maxMB * MB_TO_BYTES;
+    std::shared_ptr<SpillBlockingQueue> spillQueue = std::make_shared<SpillBlockingQueue>(config, spillCodec_);
+    if (connectDesc.queueMaxMB != 0 || memoryBudget != nullptr) {
+        ret = spillQueue->SetByteBudget(GetItemSizeGetter(), connectDesc.queueMaxMB * MB_TO_BYTES, memoryBudget);
+        if (ret != APP_ERR_OK) {
+            LogFatal << "ModuleManager: fail to set the byte budget of the queue of " << connectDesc.moduleRecv << ".";
+            return ret;
+        }
+    }
+    dataQueue = spillQueue;
+    return APP_ERR_OK;
+}
+
+// The sender and receiver processes open the same segment, with a ring for each receiver instance
+// <moduleRecv>.shmName = name of the segment, /<pipelineName>_<moduleSend>_<moduleRecv> if omitted
+// <moduleRecv>.shmDescriptorBytes = max size of the descriptor of a message, SHM_DESCRIPTOR_BYTES if omitted
+// <moduleRecv>.shmBufferBytes = size of the payload buffers of the segment, no buffer if omitted
+// <moduleRecv>.shmBufferCount = number of payload buffers, queueSize for each receiver instance and for the sender if
+// omitted
+APP_ERROR ModuleManager::CreateShmQueues(const std::string &pipelineName, const ModuleConnectDesc &connectDesc,
+    size_t recvCount, std::shared_ptr<ShmSegment> &segment,
+    std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> &queueVec)
+{
+    if (shmCodec_.encode == nullptr || shmCodec_.decode == nullptr) {
+        LogFatal << "Queue of " << connectDesc.moduleRecv << " can't use MODULE_QUEUE_SHM without the message codec, "
+                 << "call SetShmMessageCodec first";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    std::string shmName = "/" + pipelineName + "_" + connectDesc.moduleSend + "_" + connectDesc.moduleRecv;
+    std::string itemCfgStr = connectDesc.moduleRecv + std::string(".shmName");
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, shmName);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    ShmSegmentConfig config;
+    config.queueCount = static_cast<uint32_t>(recvCount);
+    config.queueSize = connectDesc.queueSize;
+    config.descriptorBytes = SHM_DESCRIPTOR_BYTES;
+    itemCfgStr = connectDesc.moduleRecv + std::string(".shmDescriptorBytes");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, config.descriptorBytes);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    itemCfgStr = connectDesc.moduleRecv + std::string(".shmBufferBytes");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, config.bufferBytes);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    config.bufferCount = (config.bufferBytes == 0) ? 0 : (config.queueCount + 1) * config.queueSize;
+    itemCfgStr = connectDesc.moduleRecv + std::string(".shmBufferCount");
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, config.bufferCount);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+
+    ret = ShmSegment::Open(shmName, config, segment);
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: fail to open the shared memory of " << connectDesc.moduleSend << " " <<
+            connectDesc.moduleRecv << ", ret = " << ret << ".";
+        return ret;
+    }
+    for (uint32_t i = 0; i < config.queueCount; i++) {
+        queueVec.push_back(std::make_shared<ShmBlockingQueue>(segment, i, shmCodec_));
+    }
+    return APP_ERR_OK;
+}
+
+// <pipelineName>.memoryBudgetMB = max memory held by the items of all the queues of the pipeline, no budget if
+// omitted or 0
+APP_ERROR ModuleManager::GetPipelineMemoryBudget(const std::string &pipelineName,
+    std::shared_ptr<QueueMemoryBudget> &memoryBudget)
+{
+    auto iter = memoryBudgetMap_.find(pipelineName);
+    if (iter != memoryBudgetMap_.end()) {
+        memoryBudget = iter->second;
+        return APP_ERR_OK;
+    }
+
+    unsigned int memoryBudgetMB = 0;
+    std::string itemCfgStr = pipelineName + std::string(".memoryBudgetMB");
+    APP_ERROR ret = configParser_.GetUnsignedIntValue(itemCfgStr, memoryBudgetMB);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    if (memoryBudgetMB != 0) {
+        memoryBudget = std::make_shared<QueueMemoryBudget>(memoryBudgetMB * MB_TO_BYTES);
+        LogInfo << "ModuleManager: queues of " << pipelineName << " share a memory budget of " << memoryBudgetMB <<
+            " MB";
+    }
+    memoryBudgetMap_[pipelineName] = memoryBudget;
+    return APP_ERR_OK;
+}
+
+ItemQueue<std::shared_ptr<void>>::ItemSizeGetter ModuleManager::GetItemSizeGetter() const
+{
+    ModuleMessageInfoGetter messageInfoGetter = messageInfoGetter_;
+    return [messageInfoGetter](const std::shared_ptr<void> &message) {
+        ModuleMessageInfo info;
+        return messageInfoGetter(message, info) ? info.bytes : 0;
+    };
+}
+
 APP_ERROR ModuleManager::RegisterInputVec(std::string pipelineName, std::string moduleName,
-    std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> inputQueVec)
+    std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> inputQueVec)
 {
     auto pipelineIter = pipelineMap_.find(pipelineName);
     std::map<std::string, ModulesInfo> modulesInfoMap;
@@ -205,7 +1010,7 @@ APP_ERROR ModuleManager::RegisterInputVec(std::string pipelineName, std::string
         if (moduleInfo.moduleVec.size() != inputQueVec.size()) {
             return APP_ERR_COMM_FAILURE;
         }
-        std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> inputQueue = nullptr;
+        std::shared_ptr<ItemQueue<std::shared_ptr<void>>> inputQueue = nullptr;
         for (unsigned int j = 0; j < moduleInfo.moduleVec.size(); j++) {
             std::shared_ptr<ModuleBase> moduleInstance = moduleInfo.moduleVec[j];
             inputQueue = inputQueVec[j];
@@ -216,7 +1021,8 @@ APP_ERROR ModuleManager::RegisterInputVec(std::string pipelineName, std::string
 }
 
 APP_ERROR ModuleManager::RegisterOutputModule(std::string pipelineName, std::string moduleSend, std::string moduleRecv,
-    ModuleConnectType connectType, std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> outputQueVec)
+    ModuleConnectType connectType, std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> outputQueVec,
+    ModuleOverflowPolicy overflowPolicy, uint32_t keepLatestNum)
 {
     auto pipelineIter = pipelineMap_.find(pipelineName);
     std::map<std::string, ModulesInfo> modulesInfoMap;
@@ -231,7 +1037,7 @@ APP_ERROR ModuleManager::RegisterOutputModule(std::string pipelineName, std::str
         ModulesInfo moduleInfo = iter->second;
         for (unsigned int j = 0; j < moduleInfo.moduleVec.size(); j++) {
             std::shared_ptr<ModuleBase> moduleInstance = moduleInfo.moduleVec[j];
-            moduleInstance->SetOutputInfo(moduleRecv, connectType, outputQueVec);
+            moduleInstance->SetOutputInfo(moduleRecv, connectType, outputQueVec, overflowPolicy, keepLatestNum);
         }
     }
     return APP_ERR_OK;
@@ -242,10 +1048,128 @@ APP_ERROR ModuleManager::InitPipelineModule()
     return APP_ERR_OK;
 }
 
+int ModuleManager::GetModuleCount(const std::string &pipelineName, const std::string &moduleName) const
+{
+    auto remoteIter = remoteModuleMap_.find(pipelineName);
+    if (remoteIter != remoteModuleMap_.end() && remoteIter->second.find(moduleName) != remoteIter->second.end()) {
+        return remoteIter->second.at(moduleName);
+    }
+    auto pipelineIter = pipelineMap_.find(pipelineName);
+    if (pipelineIter == pipelineMap_.end()) {
+        return 0;
+    }
+    auto iter = pipelineIter->second.find(moduleName);
+    return (iter == pipelineIter->second.end()) ? 0 : static_cast<int>(iter->second.moduleVec.size());
+}
+
+std::shared_ptr<MessagePoolSet> ModuleManager::GetMessagePools(const std::string &pipelineName)
+{
+    std::shared_ptr<MessagePoolSet> &messagePools = messagePoolsMap_[pipelineName];
+    if (messagePools == nullptr) {
+        messagePools = std::make_shared<MessagePoolSet>();
+    }
+    return messagePools;
+}
+
+std::vector<ModuleQueueStatistic> ModuleManager::GetQueueStatistics() const
+{
+    std::vector<ModuleQueueStatistic> statistics;
+    for (auto &pipeline : pipelineMap_) {
+        for (auto &modulesInfo : pipeline.second) {
+            auto &inputQueueVec = modulesInfo.second.inputQueueVec;
+            auto &moduleVec = modulesInfo.second.moduleVec;
+            for (size_t i = 0; i < inputQueueVec.size(); i++) {
+                ModuleQueueStatistic queueStatistic;
+                queueStatistic.pipelineName = pipeline.first;
+                queueStatistic.moduleName = modulesInfo.first;
+                queueStatistic.instanceId = static_cast<int>(i);
+                queueStatistic.statistic = inputQueueVec[i]->GetStatistic();
+                if (i < moduleVec.size()) {
+                    queueStatistic.staleDropCounts = moduleVec[i]->GetStaleDropCounts();
+                }
+                statistics.push_back(queueStatistic);
+            }
+        }
+    }
+    return statistics;
+}
+
+// the histograms are printed as <lower bound in us>:<count> for the non empty buckets
+void ModuleManager::LogQueueStatistics() const
+{
+    auto histogramToString = [](const uint64_t (&buckets)[QUEUE_WAIT_BUCKET_COUNT]) {
+        std::string result;
+        for (size_t i = 0; i < QUEUE_WAIT_BUCKET_COUNT; i++) {
+            if (buckets[i] == 0) {
+                continue;
+            }
+            uint64_t lowerBoundUs = (i == 0) ? 0 : (1ULL << i);
+            result += (result.empty() ? "" : " ") + std::to_string(lowerBoundUs) + ":" + std::to_string(buckets[i]);
+        }
+        return result;
+    };
+    for (auto &queueStatistic : GetQueueStatistics()) {
+        const QueueStatisticInfo &info = queueStatistic.statistic;
+        LogInfo << "[Statistic] [Queue] [" << queueStatistic.moduleName << "] [" << queueStatistic.instanceId <<
+            "] [Depth] [" << info.depth << "] [MaxDepth] [" << info.maxDepth << "] [Push] [" << info.pushCount <<
+            "] [Pop] [" << info.popCount << "] [Drop] [" << info.dropCount << "] [ProducerWait] [" <<
+            info.producerWaitUs << " us] [" << histogramToString(info.producerWaitBuckets) << "] [ConsumerWait] [" <<
+            info.consumerWaitUs << " us] [" << histogramToString(info.consumerWaitBuckets) << "]";
+        if (queueStatistic.staleDropCounts.empty()) {
+            continue;
+        }
+        std::string staleDrops;
+        for (auto &staleDrop : queueStatistic.staleDropCounts) {
+            staleDrops += (staleDrops.empty() ? "" : " ") + std::string("ch") + std::to_string(staleDrop.first) + ":" +
+                std::to_string(staleDrop.second);
+        }
+        LogInfo << "[Statistic] [StaleDrop] [" << queueStatistic.moduleName << "] [" << queueStatistic.instanceId <<
+            "] [" << staleDrops << "]";
+    }
+    for (auto &memoryBudget : memoryBudgetMap_) {
+        if (memoryBudget.second == nullptr) {
+            continue;
+        }
+        LogInfo << "[Statistic] [MemoryBudget] [" << memoryBudget.first << "] [Used] [" <<
+            memoryBudget.second->GetUsedBytes() << " bytes] [Max] [" << memoryBudget.second->GetMaxBytes() <<
+            " bytes]";
+    }
+}
+
+void ModuleManager::SetMessageInfoGetter(ModuleMessageInfoGetter messageInfoGetter)
+{
+    messageInfoGetter_ = messageInfoGetter;
+}
+
+void ModuleManager::SetShmMessageCodec(const ShmMessageCodec &shmCodec)
+{
+    shmCodec_ = shmCodec;
+}
+
+void ModuleManager::SetSpillMessageCodec(const SpillMessageCodec &spillCodec)
+{
+    spillCodec_ = spillCodec;
+}
+
+void ModuleManager::SetProcessName(const std::string &processName)
+{
+    processName_ = processName;
+}
+
 APP_ERROR ModuleManager::RunPipeline()
 {
     LogInfo << "ModuleManager: begin to run pipeline.";
 
+    std::vector<uint32_t> numaCpuList;
+    APP_ERROR ret = ApplyNumaNode(numaCpuList);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    ret = StartTrace();
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+
     // start the thread of the corresponding module
     std::map<std::string, ModulesInfo> modulesInfoMap;
     std::shared_ptr<ModuleBase> moduleInstance;
@@ -254,9 +1178,15 @@ APP_ERROR ModuleManager::RunPipeline()
 
         for (auto iter = modulesInfoMap.begin(); iter != modulesInfoMap.end(); iter++) {
             ModulesInfo modulesInfo = iter->second;
+            std::vector<uint32_t> cpuList = numaCpuList;
+            ret = ReadModuleCpuSet(iter->first, cpuList);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
             for (uint32_t i = 0; i < modulesInfo.moduleVec.size(); i++) {
                 moduleInstance = modulesInfo.moduleVec[i];
-                APP_ERROR ret = moduleInstance->Run();
+                moduleInstance->SetCpuAffinity(cpuList);
+                ret = moduleInstance->Run();
                 if (ret != APP_ERR_OK) {
                     LogFatal << "ModuleManager: fail to run module ";
                     return ret;
@@ -269,11 +1199,96 @@ APP_ERROR ModuleManager::RunPipeline()
     return APP_ERR_OK;
 }
 
+// SystemConfig.numaNode = numa node whose cpus run the threads of the pipeline and whose memory they allocate
+APP_ERROR ModuleManager::ApplyNumaNode(std::vector<uint32_t> &cpuList)
+{
+    int numaNode = -1;
+    std::string itemCfgStr = "SystemConfig.numaNode";
+    APP_ERROR ret = configParser_.GetIntValue(itemCfgStr, numaNode);
+    if (ret == APP_ERR_COMM_NO_EXIST) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    ret = GetNumaNodeCpus(numaNode, cpuList);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    // the module threads created by Run inherit the policy, the threads already running, such as the workers,
+    // allocate on the node of the cpus they are pinned to
+    ret = SetPreferredNumaNode(numaNode);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    if (executor_ != nullptr) {
+        executor_->SetCpuAffinity(cpuList);
+    }
+    if (eventLoop_ != nullptr) {
+        eventLoop_->SetCpuAffinity(cpuList);
+    }
+    LogInfo << "ModuleManager: the pipeline runs on the " << cpuList.size() << " cpus of numa node " << numaNode;
+    return APP_ERR_OK;
+}
+
+// <moduleName>.cpuSet = cpus the threads of the module instances run on, such as 0-3,8, cpuList is kept if omitted
+APP_ERROR ModuleManager::ReadModuleCpuSet(const std::string &moduleName, std::vector<uint32_t> &cpuList) const
+{
+    std::string cpuListStr;
+    std::string itemCfgStr = moduleName + std::string(".cpuSet");
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, cpuListStr);
+    if (ret == APP_ERR_COMM_NO_EXIST) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    ret = ParseCpuList(cpuListStr, cpuList);
+    if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+    }
+    return ret;
+}
+
+// SystemConfig.traceFile = file the Chrome trace of the pipeline is written to by DeInit, omitted: no tracing
+// SystemConfig.traceMaxEvents = max number of events recorded by each thread
+// SystemConfig.traceDurationSec = time the events are recorded from RunPipeline, omitted: until DeInit
+APP_ERROR ModuleManager::StartTrace()
+{
+    std::string itemCfgStr = "SystemConfig.traceFile";
+    APP_ERROR ret = configParser_.GetStringValue(itemCfgStr, traceFile_);
+    if (ret == APP_ERR_COMM_NO_EXIST) {
+        return APP_ERR_OK;
+    } else if (ret != APP_ERR_OK) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    uint32_t maxEvents = TRACE_MAX_EVENTS;
+    itemCfgStr = "SystemConfig.traceMaxEvents";
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, maxEvents);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    uint32_t durationSec = 0;
+    itemCfgStr = "SystemConfig.traceDurationSec";
+    ret = configParser_.GetUnsignedIntValue(itemCfgStr, durationSec);
+    if (ret != APP_ERR_OK && ret != APP_ERR_COMM_NO_EXIST) {
+        LogFatal << "ModuleManager: invalid config variable named " << itemCfgStr << ".";
+        return ret;
+    }
+    ModuleTracer::GetInstance().Start(maxEvents, durationSec);
+    LogInfo << "ModuleManager: trace the pipeline to " << traceFile_ << ".";
+    return APP_ERR_OK;
+}
+
 APP_ERROR ModuleManager::DeInit(void)
 {
     LogInfo << "begin to deinit module manager.";
     APP_ERROR ret = APP_ERR_OK;
 
+    LogQueueStatistics();
+
     // DeInit pipeline module
     ret = DeInitPipelineModule();
     if (ret != APP_ERR_OK) {
@@ -281,6 +1296,19 @@ APP_ERROR ModuleManager::DeInit(void)
         return ret;
     }
 
+    // the modules are stopped, so the workers only find stale tasks and the event loop no step
+    if (executor_ != nullptr) {
+        executor_->Stop();
+    }
+    if (eventLoop_ != nullptr) {
+        eventLoop_->Stop();
+    }
+
+    if (!traceFile_.empty()) {
+        ModuleTracer::GetInstance().Stop();
+        ModuleTracer::GetInstance().Dump(traceFile_);
+    }
+
 #ifdef ASCEND_MODULE_USE_ACL
     ResourceManager::GetInstance()->Release();
 #endif
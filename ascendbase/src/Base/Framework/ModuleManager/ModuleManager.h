@@ -17,8 +17,11 @@
 #ifndef INC_MODULE_MANAGER_H
 #define INC_MODULE_MANAGER_H
 
+#ifdef ASCEND_MODULE_USE_ACL
 #include "acl/acl.h"
+#endif
 #include "Log/Log.h"
+#include "BlockingQueue/SpillBlockingQueue.h"
 #include "ModuleManager/ModuleBase.h"
 #include "ModuleManager/ModuleFactory.h"
 
@@ -27,23 +30,40 @@ const std::string PIPELINE_DEFAULT = "DefaultPipeline";
 
 struct ModuleDesc {
     std::string moduleName;
-    int moduleCount; // -1 using the defaultCount
+    int moduleCount; // -1 using the defaultCount, <moduleName>.instanceCount overrides it
 };
 
 struct ModuleConnectDesc {
     std::string moduleSend;
     std::string moduleRecv;
-    ModuleConnectType connectType;
+    ModuleConnectType connectType; // <moduleRecv>.connectType overrides it
+    ModuleQueueType queueType; // MODULE_QUEUE_AUTO if omitted, <moduleRecv>.queueType overrides it
+    ModuleOverflowPolicy overflowPolicy; // MODULE_OVERFLOW_BLOCK if omitted, <moduleRecv>.overflowPolicy overrides it
+    uint32_t keepLatestNum; // for MODULE_OVERFLOW_KEEP_LATEST, 1 if omitted, <moduleRecv>.keepLatestNum overrides it
+    // used by the blocking, ring and spsc queues, park if omitted, <moduleRecv>.waitStrategy and .maxSpinUs
+    // override it
+    QueueWaitStrategy waitStrategy;
+    uint32_t queueMaxMB; // byte budget of each input queue, no limit if omitted, <moduleRecv>.queueMaxMB overrides it
+    uint32_t queueSize; // capacity of each input queue, MODULE_QUEUE_SIZE if omitted, <moduleRecv>.queueSize overrides it
 };
 
 // information for one type of module
 struct ModulesInformation {
     std::vector<std::shared_ptr<ModuleBase>> moduleVec;
-    std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> inputQueueVec;
+    std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> inputQueueVec;
 };
 
 using ModulesInfo = ModulesInformation;
 
+// statistic of the input queue of one module instance
+struct ModuleQueueStatistic {
+    std::string pipelineName;
+    std::string moduleName;
+    int instanceId;
+    QueueStatisticInfo statistic;
+    std::map<uint32_t, uint64_t> staleDropCounts; // input items dropped by maxFrameAgeMs, by channel
+};
+
 class ModuleManager {
 public:
     ModuleManager();
@@ -55,19 +75,75 @@ public:
     APP_ERROR RegisterModuleConnects(std::string pipelineName, ModuleConnectDesc *connnectDesc, int moduleConnectCount);
 
     APP_ERROR RegisterInputVec(std::string pipelineName, std::string moduleName,
-        std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> inputQueVec);
+        std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> inputQueVec);
     APP_ERROR RegisterOutputModule(std::string pipelineName, std::string moduleSend, std::string moduleRecv,
-        ModuleConnectType connectType, std::vector<std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>> outputQueVec);
+        ModuleConnectType connectType, std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> outputQueVec,
+        ModuleOverflowPolicy overflowPolicy = MODULE_OVERFLOW_BLOCK, uint32_t keepLatestNum = 1);
 
     APP_ERROR RunPipeline();
 
+    // number of instances of the module once registered, in this process or another one, 0 if the module isn't
+    // registered
+    int GetModuleCount(const std::string &pipelineName, const std::string &moduleName) const;
+    // message pools shared by the modules of the pipeline, for the messages created outside of them such as the ones
+    // decoded by the codecs of the shm and spill queues
+    std::shared_ptr<MessagePoolSet> GetMessagePools(const std::string &pipelineName);
+
+    // snapshot of the input queues of all the module instances, can be called while the pipeline is running
+    std::vector<ModuleQueueStatistic> GetQueueStatistics() const;
+    void LogQueueStatistics() const;
+
+    // the getter is used by the queues created afterwards by RegisterModuleConnects, so set it before
+    void SetMessageInfoGetter(ModuleMessageInfoGetter messageInfoGetter);
+    // encodes the messages of the shm connects, set it before RegisterModuleConnects
+    void SetShmMessageCodec(const ShmMessageCodec &shmCodec);
+    // encodes the messages spilled to disk by the spill queues, set it before RegisterModuleConnects
+    void SetSpillMessageCodec(const SpillMessageCodec &spillCodec);
+    // The modules whose <moduleName>.process names another process are only registered by count, their connects
+    // to the modules of this process must use the shm queue type. Set it before RegisterModules, all the modules
+    // run in this process if it is empty.
+    void SetProcessName(const std::string &processName);
+
 private:
 #ifdef ASCEND_MODULE_USE_ACL
     APP_ERROR InitAcl(std::string &aclConfigPath);
 #endif
     APP_ERROR InitModuleInstance(std::shared_ptr<ModuleBase> moduleInstance, int instanceId, std::string pipelineName,
         std::string moduleName);
+    APP_ERROR ReadModuleCount(const std::string &moduleName, int &moduleCount) const;
+    APP_ERROR ReadModuleCpuSet(const std::string &moduleName, std::vector<uint32_t> &cpuList) const;
+    APP_ERROR ApplyNumaNode(std::vector<uint32_t> &cpuList);
+    APP_ERROR StartTrace();
+    APP_ERROR ReadConnectConfig(ModuleConnectDesc &connectDesc) const;
+    APP_ERROR ReadModuleProcess(const std::string &moduleName, std::string &processName) const;
+    APP_ERROR CheckTopology(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+        const std::map<std::string, int> &remoteModuleMap, const ModuleConnectDesc *connnectDesc,
+        int moduleConnectCount) const;
+    APP_ERROR CheckConnect(const ModuleConnectDesc &connectDesc, size_t sendCount, size_t recvCount) const;
+    APP_ERROR CheckJoin(const ModuleConnectDesc &connectDesc, size_t recvCount, bool byteBudgeted) const;
+    template<typename E> APP_ERROR ReadEnumConfig(const std::string &itemCfgStr,
+        const std::map<std::string, E> &valueMap, E &value) const;
+    bool IsChannelPartitioned(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+        const std::vector<ModuleConnectDesc> &connectVec, const std::string &moduleName, uint32_t depth) const;
+    bool IsSingleProducer(const std::map<std::string, ModulesInfo> &modulesInfoMap,
+        const std::vector<ModuleConnectDesc> &connectVec, const ModuleConnectDesc &connectDesc, size_t recvCount) const;
+    APP_ERROR ResolveQueueType(const ModuleConnectDesc &connectDesc, size_t sendCount, bool singleProducer,
+        bool byteBudgeted, ModuleQueueType &queueType) const;
+    std::shared_ptr<ItemQueue<std::shared_ptr<void>>> CreateModuleQueue(ModuleQueueType queueType,
+        const ModuleConnectDesc &connectDesc, const std::shared_ptr<QueueMemoryBudget> &memoryBudget) const;
+    APP_ERROR CreateSpillQueue(const std::string &pipelineName, const ModuleConnectDesc &connectDesc,
+        uint32_t instanceId, const std::shared_ptr<QueueMemoryBudget> &memoryBudget,
+        std::shared_ptr<ItemQueue<std::shared_ptr<void>>> &dataQueue);
+    APP_ERROR CreateShmQueues(const std::string &pipelineName, const ModuleConnectDesc &connectDesc, size_t recvCount,
+        std::shared_ptr<ShmSegment> &segment,
+        std::vector<std::shared_ptr<ItemQueue<std::shared_ptr<void>>>> &queueVec);
+    APP_ERROR GetPipelineMemoryBudget(const std::string &pipelineName,
+        std::shared_ptr<QueueMemoryBudget> &memoryBudget);
+    // bytes of a message for the byte budgeted queues, from the message info getter
+    ItemQueue<std::shared_ptr<void>>::ItemSizeGetter GetItemSizeGetter() const;
     APP_ERROR InitPipelineModule();
+    APP_ERROR InitExecutor();
+    APP_ERROR InitEventLoop();
     APP_ERROR DeInitPipelineModule();
     static void StopModule(std::shared_ptr<ModuleBase> moduleInstance);
 
@@ -78,7 +154,19 @@ private:
     aclrtRunMode runMode_ = ACL_DEVICE;
 #endif
     std::map<std::string, std::map<std::string, ModulesInfo>> pipelineMap_ = {};
+    // instance count of the modules running in other processes, by pipeline
+    std::map<std::string, std::map<std::string, int>> remoteModuleMap_ = {};
+    std::string processName_ = {};
+    ShmMessageCodec shmCodec_ = {};
+    SpillMessageCodec spillCodec_ = {};
+    // memory budget shared by all the queues of a pipeline, from <pipelineName>.memoryBudgetMB
+    std::map<std::string, std::shared_ptr<QueueMemoryBudget>> memoryBudgetMap_ = {};
+    std::map<std::string, std::shared_ptr<MessagePoolSet>> messagePoolsMap_ = {}; // pipeline -> its message pools
     ConfigParser configParser_ = {};
+    std::shared_ptr<ModuleExecutor> executor_ = nullptr; // from SystemConfig.executorThreadNum
+    std::shared_ptr<ModuleEventLoop> eventLoop_ = nullptr; // from SystemConfig.eventLoopThreadNum
+    ModuleMessageInfoGetter messageInfoGetter_ = nullptr;
+    std::string traceFile_ = {}; // from SystemConfig.traceFile, empty if the tracing is disabled
     int moduleTypeCount_ = 0;
     int moduleConnectCount_ = 0;
     ModuleConnectDesc *connnectDesc_ = nullptr;
@@ -0,0 +1,198 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ModuleManager/ModuleTracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include "Log/Log.h"
+
+namespace ascendBaseModule {
+namespace {
+const uint64_t SEC_TO_NS = 1000000000;
+const double NS_TO_US = 1000.0;
+// the instances are the threads of process 0, the waits of the frames of channel c are in process c + 1
+const uint32_t MODULE_PID = 0;
+thread_local void *g_traceBuffer = nullptr;
+
+// the async events of the wait of a frame for an instance, the same at enqueue and dequeue
+uint64_t GetWaitId(const ModuleTraceEvent &event)
+{
+    const uint32_t channelShift = 48;
+    const uint32_t trackShift = 32;
+    return (static_cast<uint64_t>(event.channelId) << channelShift) ^
+        (static_cast<uint64_t>(event.trackId) << trackShift) ^ event.frameId;
+}
+}
+
+std::atomic<bool> ModuleTracer::isEnabled_ = {false};
+
+ModuleTracer &ModuleTracer::GetInstance()
+{
+    static ModuleTracer tracer;
+    return tracer;
+}
+
+void ModuleTracer::Start(uint32_t maxEvents, uint32_t durationSec)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    maxEvents_ = maxEvents;
+    endNs_ = (durationSec == 0) ? 0 : GetTimeNs() + durationSec * SEC_TO_NS;
+    generation_++;
+    isEnabled_ = true;
+}
+
+void ModuleTracer::Stop()
+{
+    isEnabled_ = false;
+}
+
+uint32_t ModuleTracer::RegisterTrack(const std::string &name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = trackMap_.find(name);
+    if (iter != trackMap_.end()) {
+        return iter->second;
+    }
+    uint32_t trackId = trackNames_.size();
+    trackNames_.push_back(name);
+    trackMap_[name] = trackId;
+    return trackId;
+}
+
+uint64_t ModuleTracer::GetTimeNs() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ModuleTracer::TraceBuffer *ModuleTracer::GetThreadBuffer()
+{
+    TraceBuffer *buffer = static_cast<TraceBuffer *>(g_traceBuffer);
+    if (buffer == nullptr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        buffers_.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer()));
+        buffer = buffers_.back().get();
+        g_traceBuffer = buffer;
+    }
+    if (buffer->generation != generation_.load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        buffer->events.resize(maxEvents_);
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->droppedCount = 0;
+        buffer->generation = generation_;
+    }
+    return buffer;
+}
+
+void ModuleTracer::Record(ModuleTraceEventType type, uint32_t trackId, uint64_t startNs, uint64_t endNs,
+    bool hasFrame, uint32_t channelId, uint64_t frameId)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    if (endNs_ != 0 && endNs > endNs_) {
+        Stop();
+        return;
+    }
+    TraceBuffer *buffer = GetThreadBuffer();
+    uint32_t count = buffer->count.load(std::memory_order_relaxed);
+    if (count >= buffer->events.size()) {
+        buffer->droppedCount++;
+        return;
+    }
+    ModuleTraceEvent &event = buffer->events[count];
+    event.startNs = startNs;
+    event.endNs = endNs;
+    event.frameId = frameId;
+    event.channelId = channelId;
+    event.trackId = trackId;
+    event.type = static_cast<uint8_t>(type);
+    event.hasFrame = hasFrame;
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+APP_ERROR ModuleTracer::Dump(const std::string &filePath)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    FILE *file = fopen(filePath.c_str(), "w");
+    if (file == nullptr) {
+        LogError << "ModuleTracer: fail to open " << filePath;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    uint64_t baseNs = UINT64_MAX;
+    uint64_t eventCount = 0;
+    uint64_t droppedCount = 0;
+    for (auto &buffer : buffers_) {
+        uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++) {
+            baseNs = std::min(baseNs, buffer->events[i].startNs);
+        }
+        eventCount += count;
+        droppedCount += buffer->droppedCount;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    const char *separator = "";
+    std::set<uint32_t> channels;
+    for (uint32_t i = 0; i < trackNames_.size(); i++) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            separator, MODULE_PID, i, trackNames_[i].c_str());
+        separator = ",\n";
+    }
+    for (auto &buffer : buffers_) {
+        uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++) {
+            const ModuleTraceEvent &event = buffer->events[i];
+            const std::string &trackName = (event.trackId < trackNames_.size()) ? trackNames_[event.trackId] : "";
+            double tsUs = (event.startNs - baseNs) / NS_TO_US;
+            if (event.type == MODULE_TRACE_PROCESS) {
+                fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"process\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f", separator, trackName.c_str(), MODULE_PID, event.trackId, tsUs,
+                    (event.endNs - event.startNs) / NS_TO_US);
+            } else if (event.hasFrame) {
+                channels.insert(event.channelId);
+                fprintf(file, "%s{\"name\":\"wait %s\",\"cat\":\"queue\",\"ph\":\"%s\",\"id\":\"0x%llx\","
+                    "\"pid\":%u,\"tid\":0,\"ts\":%.3f", separator, trackName.c_str(),
+                    (event.type == MODULE_TRACE_ENQUEUE) ? "b" : "e", (unsigned long long)GetWaitId(event),
+                    event.channelId + 1, tsUs);
+            } else {
+                continue;
+            }
+            if (event.hasFrame) {
+                fprintf(file, ",\"args\":{\"channelId\":%u,\"frameId\":%llu}}", event.channelId,
+                    (unsigned long long)event.frameId);
+            } else {
+                fprintf(file, "}");
+            }
+            separator = ",\n";
+        }
+    }
+    for (auto channelId : channels) {
+        fprintf(file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"channel %u\"}}",
+            separator, channelId + 1, channelId);
+        separator = ",\n";
+    }
+    fprintf(file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"modules\"}}\n]}\n",
+        separator, MODULE_PID);
+    fclose(file);
+    LogInfo << "ModuleTracer: " << eventCount << " events dumped to " << filePath << ", " << droppedCount
+            << " dropped because the buffers were full.";
+    return APP_ERR_OK;
+}
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_MODULE_TRACER_H
+#define INC_MODULE_TRACER_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ErrorCode/ErrorCode.h"
+
+namespace ascendBaseModule {
+enum ModuleTraceEventType {
+    MODULE_TRACE_PROCESS = 0, // Process, ProcessBatch or ProcessJoin call of an instance
+    MODULE_TRACE_ENQUEUE,     // a frame pushed to the input queue of an instance
+    MODULE_TRACE_DEQUEUE      // the frame taken from the queue by the instance
+};
+
+struct ModuleTraceEvent {
+    uint64_t startNs;
+    uint64_t endNs;
+    uint64_t frameId;
+    uint32_t channelId;
+    uint32_t trackId; // the module instance, see RegisterTrack
+    uint8_t type;
+    bool hasFrame;
+};
+
+// Records the processing of the module instances and the time the frames wait in their input queues, and dumps
+// them as Chrome trace event JSON, which chrome://tracing and Perfetto open. Every thread records to its own buffer
+// without lock, a buffer being only registered once by its first event. Until Start is called, recording costs the
+// relaxed load of IsEnabled.
+class ModuleTracer {
+public:
+    static ModuleTracer &GetInstance();
+
+    static bool IsEnabled()
+    {
+        return isEnabled_.load(std::memory_order_relaxed);
+    }
+
+    // records up to maxEvents per thread during durationSec, 0 for no time limit
+    void Start(uint32_t maxEvents, uint32_t durationSec);
+    void Stop();
+    // id of the track of name, the same for the same name
+    uint32_t RegisterTrack(const std::string &name);
+    uint64_t GetTimeNs() const;
+    void Record(ModuleTraceEventType type, uint32_t trackId, uint64_t startNs, uint64_t endNs, bool hasFrame,
+        uint32_t channelId, uint64_t frameId);
+    // call once the recording threads are stopped
+    APP_ERROR Dump(const std::string &filePath);
+
+private:
+    struct TraceBuffer {
+        std::vector<ModuleTraceEvent> events;
+        std::atomic<uint32_t> count = {0}; // written by the owner thread only
+        uint64_t droppedCount = 0;
+        uint64_t generation = 0;
+    };
+
+    ModuleTracer() {};
+    TraceBuffer *GetThreadBuffer();
+
+private:
+    static std::atomic<bool> isEnabled_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_ = {};
+    std::map<std::string, uint32_t> trackMap_ = {};
+    std::vector<std::string> trackNames_ = {};
+    uint32_t maxEvents_ = 0;
+    uint64_t endNs_ = 0;
+    std::atomic<uint64_t> generation_ = {0}; // the buffers of a former Start are reset by their thread
+};
+}
+
+#endif
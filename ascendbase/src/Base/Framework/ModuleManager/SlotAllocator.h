@@ -0,0 +1,75 @@
+/*
+ * Copyright(C) 2020. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_SLOT_ALLOCATOR_H
+#define INC_SLOT_ALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace ascendBaseModule {
+// large enough for the control block of libstdc++ and libc++, a larger one is allocated apart
+const size_t SLOT_CONTROL_BLOCK_SIZE = 96;
+using SlotControlBlock = std::aligned_storage<SLOT_CONTROL_BLOCK_SIZE, alignof(std::max_align_t)>::type;
+
+// Allocator of the control block of a shared_ptr in the slot of a pooled object, Slot having a SlotControlBlock
+// member named controlBlock, so that the shared_ptr costs no heap allocation. The control block is deallocated after
+// the deleter ran and after the last weak reference, it is the last use of the slot, so this is when the slot goes
+// back to its owner, through Owner::Recycle(Slot *), which the owner makes a friend of the allocator.
+template<typename U, typename Owner, typename Slot> struct SlotAllocator {
+    using value_type = U;
+    template<typename V> struct rebind {
+        using other = SlotAllocator<V, Owner, Slot>;
+    };
+
+    Slot *slot;
+    std::shared_ptr<Owner> owner;
+
+    SlotAllocator(Slot *slotIn, std::shared_ptr<Owner> ownerIn) : slot(slotIn), owner(ownerIn) {}
+    template<typename V> SlotAllocator(const SlotAllocator<V, Owner, Slot> &other)
+        : slot(other.slot), owner(other.owner) {}
+
+    U *allocate(size_t n)
+    {
+        if (n * sizeof(U) <= sizeof(slot->controlBlock)) {
+            return reinterpret_cast<U *>(&slot->controlBlock);
+        }
+        return static_cast<U *>(::operator new(n * sizeof(U)));
+    }
+
+    void deallocate(U *p, size_t)
+    {
+        if (static_cast<void *>(p) != static_cast<void *>(&slot->controlBlock)) {
+            ::operator delete(p);
+        }
+        owner->Recycle(slot);
+    }
+
+    template<typename V> bool operator==(const SlotAllocator<V, Owner, Slot> &other) const
+    {
+        return slot == other.slot;
+    }
+
+    template<typename V> bool operator!=(const SlotAllocator<V, Owner, Slot> &other) const
+    {
+        return slot != other.slot;
+    }
+};
+}
+
+#endif